@@ -0,0 +1,646 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+
+/*
+  Бенчмарки загрузки, поиска, чтения, обхода, сохранения и освобождения
+
+  inibench [-t seconds] [-r repeats] file.ini
+
+  Каждый результат печатается отдельной строкой "имя<TAB>значение<TAB>
+единицы", строки с описанием начинаются с '#'. Время операций поиска и
+чтения - в наносекундах на операцию: операция повторяется, пока не наберётся
+-t секунд (по умолчанию 0.2). Загрузка измеряется -r раз (по умолчанию 3) и
+берётся лучшее время, отдельно без проверки секций и с проверкой
+(IniSetCheckForSections)
+*/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <ini.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <time.h>
+
+#define BENCH_LOOKUPS           4096
+
+#define BENCH_READ_1IV          0
+#define BENCH_READ_4IV          1
+#define BENCH_READ_4FV          2
+#define BENCH_READ_BOOL         3
+#define BENCH_READ_STRING       4
+#define BENCH_READ_COUNT        5
+
+typedef struct {
+    ini_t           ini;        // Loaded tree
+    const char*     filename;   // Loaded file
+    double          minTime;    // Minimal time of a measurement
+    int             repeats;    // Number of the loads
+    ptrdiff_t       numSects;   // Number of sections
+    ptrdiff_t       numParams;  // Number of parameters
+    const char*     sectNames[BENCH_LOOKUPS];// Existing section names
+    char*           missNames[BENCH_LOOKUPS];// Missing section names
+    inisect_t*      sects[BENCH_LOOKUPS];// Sections of the lookups
+    const char*     ownKeys[BENCH_LOOKUPS];// Keys defined in the section
+    inisect_t*      inhSects[BENCH_LOOKUPS];// Sections of the inherited
+                                //     lookups
+    const char*     inhKeys[BENCH_LOOKUPS];// Keys defined in the ancestors
+    inikey_t        sectHandles[BENCH_LOOKUPS];// Handles of sectNames
+    inikey_t        keyHandles[BENCH_LOOKUPS];// Handles of ownKeys
+    ptrdiff_t       numInherited;// Number of the inherited lookups
+    iniparam_t*     reads[BENCH_READ_COUNT][BENCH_LOOKUPS];// Parameters by
+                                //     type of the value
+    ptrdiff_t       numReads[BENCH_READ_COUNT];// Number of the parameters
+    char*           string;     // Buffer for IniReadString
+    volatile ptrdiff_t sink;    // Keeps the results alive
+} bench_t;
+
+typedef void (*fnBench)( bench_t* b, ptrdiff_t n );
+
+static const char* benchTags[INI_MTAG_COUNT] = {
+    "none", "string", "descr", "inherit", "heir", "param", "sect", "parser",
+    "atoms", "arena", "effective", "index", "keyindex", "closure", "bloom",
+    "mph", "keys", "diag"
+};
+
+static const char* benchReads[BENCH_READ_COUNT] = {
+    "read.1iv", "read.4iv", "read.4fv", "read.bool", "read.string"
+};
+
+static unsigned long benchState = 1;
+
+
+
+/*
+================
+BenchNow
+================
+*/
+static double BenchNow( void ) {
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/*
+================
+BenchRand
+================
+*/
+static ptrdiff_t BenchRand( ptrdiff_t n ) {
+    benchState ^= (benchState << 13) & 0xffffffffUL;
+    benchState ^= benchState >> 17;
+    benchState ^= (benchState << 5) & 0xffffffffUL;
+    return (ptrdiff_t)((benchState & 0xffffffffUL) % (unsigned long)n);
+}
+
+/*
+================
+BenchResult
+================
+*/
+static void BenchResult( const char* name, double value, const char* unit ) {
+    printf( "%s\t%.3f\t%s\n", name, value, unit );
+    fflush( stdout );
+}
+
+/*
+================
+BenchRun
+
+  Повторять fn, удваивая число операций, пока время не превысит
+b->minTime. Возвращает наносекунды на операцию
+================
+*/
+static double BenchRun( bench_t* b, fnBench fn ) {
+    ptrdiff_t n;
+    double start;
+    double t;
+
+    for( n = 64; ; n *= 2 ) {
+        start = BenchNow();
+        fn( b, n );
+        t = BenchNow() - start;
+        if( t >= b->minTime || n >= ((ptrdiff_t)1 << 30) ) {
+            break;
+        }
+    }
+    return t * 1e9 / (double)n;
+}
+
+/*
+================
+BenchLoad
+
+  Загрузить файл в b->ini, возвращает время загрузки
+================
+*/
+static double BenchLoad( bench_t* b, int checked ) {
+    double start;
+
+    IniInit( &b->ini, malloc, free, NULL, NULL, 0 );
+    IniSetCheckForSections( &b->ini, (unsigned char)checked );
+    start = BenchNow();
+    if( IniLoad( &b->ini, b->filename ) ) {
+        fprintf( stderr, "inibench: %d errors loading '%s'\n",
+            b->ini.numOfErrors, b->filename );
+    }
+    return BenchNow() - start;
+}
+
+/*
+================
+BenchLoadBest
+
+  Загрузить файл b->repeats раз, в b->ini остаётся последнее дерево
+================
+*/
+static void BenchLoadBest( bench_t* b, int checked, const char* name ) {
+    double best;
+    double bestFree;
+    double start;
+    double t;
+    int i;
+
+    best = 0;
+    bestFree = 0;
+    for( i = 0; i < b->repeats; i++ ) {
+        t = BenchLoad( b, checked );
+        if( i == 0 || t < best ) {
+            best = t;
+        }
+        if( i + 1 == b->repeats ) {
+            break;
+        }
+        start = BenchNow();
+        IniFree( &b->ini );
+        t = BenchNow() - start;
+        if( i == 0 || t < bestFree ) {
+            bestFree = t;
+        }
+    }
+    BenchResult( name, best * 1e3, "ms" );
+    if( b->repeats > 1 && !checked ) {
+        BenchResult( "free", bestFree * 1e3, "ms" );
+    }
+}
+
+/*
+================
+BenchValidate
+
+  Проверить файл b->repeats раз (IniValidate), лучшее время
+================
+*/
+static void BenchValidate( bench_t* b ) {
+    double best;
+    double start;
+    double t;
+    int i;
+
+    best = 0;
+    for( i = 0; i < b->repeats; i++ ) {
+        start = BenchNow();
+        IniValidate( b->filename, NULL );
+        t = BenchNow() - start;
+        if( i == 0 || t < best ) {
+            best = t;
+        }
+    }
+    BenchResult( "validate", best * 1e3, "ms" );
+}
+
+/*
+================
+BenchReadKind
+
+  Тип значения параметра (BENCH_READ_*) или -1
+================
+*/
+static int BenchReadKind( iniparam_t* p ) {
+    unsigned char bv;
+    float fv[4];
+    int iv[4];
+    const char* v;
+
+    if( !p->key || !p->value || !p->value->length ) {
+        return -1;
+    }
+    v = p->value->string;
+    if( (v[0] == 't' || v[0] == 'f') && !IniReadBool( p, &bv ) ) {
+        return BENCH_READ_BOOL;
+    }
+    if( strchr( v, ',' ) ) {
+        if( strchr( v, '.' ) ) {
+            return IniRead4fv( p, fv ) ? -1 : BENCH_READ_4FV;
+        }
+        return IniRead4iv( p, iv ) ? -1 : BENCH_READ_4IV;
+    }
+    if( v[0] >= '0' && v[0] <= '9' && !strchr( v, '.' ) ) {
+        return IniRead1iv( p, iv ) ? -1 : BENCH_READ_1IV;
+    }
+    // Quoted strings are not measured
+    if( v[0] == '"' || v[0] == '\'' ) {
+        return -1;
+    }
+    return BENCH_READ_STRING;
+}
+
+/*
+================
+BenchPrepare
+
+  Выбрать секции, ключи и параметры для поиска и чтения
+================
+*/
+static void BenchPrepare( bench_t* b ) {
+    inisect_t** all;
+    inisect_t* s;
+    inisect_t* root;
+    iniparam_t* p;
+    ptrdiff_t maxValue;
+    ptrdiff_t i;
+    ptrdiff_t n;
+    int kind;
+    char name[64];
+
+    // The same lookups for every tree of the file
+    benchState = 1;
+    b->numSects = 0;
+    b->numParams = 0;
+    maxValue = 0;
+    for( kind = 0; kind < BENCH_READ_COUNT; kind++ ) {
+        b->numReads[kind] = 0;
+    }
+    for( s = b->ini.firstSect; s; s = s->next ) {
+        b->numSects++;
+    }
+    all = (inisect_t**)malloc( (b->numSects + 1) * sizeof(inisect_t*) );
+    for( s = b->ini.firstSect, n = 0; s; s = s->next ) {
+        all[n++] = s;
+        for( p = s->firstParam; p; p = p->next ) {
+            b->numParams++;
+            if( p->value && p->value->length > maxValue ) {
+                maxValue = p->value->length;
+            }
+            kind = BenchReadKind( p );
+            if( kind >= 0 && b->numReads[kind] < BENCH_LOOKUPS ) {
+                b->reads[kind][b->numReads[kind]++] = p;
+            }
+        }
+    }
+    b->string = (char*)malloc( maxValue + 1 );
+
+    b->numInherited = 0;
+    for( i = 0; i < BENCH_LOOKUPS && b->numSects; i++ ) {
+        s = all[BenchRand( b->numSects )];
+        b->sects[i] = s;
+        b->sectNames[i] = s->key->string;
+        b->sectHandles[i] = IniKeyMake( s->key->string );
+        b->ownKeys[i] = s->firstParam && s->firstParam->key ?
+            s->firstParam->key->string : "k0_0";
+        b->keyHandles[i] = IniKeyMake( b->ownKeys[i] );
+        sprintf( name, "missing_%ld", (long)BenchRand( 1000000 ) );
+        b->missNames[i] = (char*)malloc( strlen( name ) + 1 );
+        strcpy( b->missNames[i], name );
+
+        // A key of the most distant ancestor
+        for( root = s; root->inherit; root = root->inherit->inhSect );
+        if( root != s && root->firstParam && root->firstParam->key ) {
+            b->inhSects[b->numInherited] = s;
+            b->inhKeys[b->numInherited++] = root->firstParam->key->string;
+        }
+    }
+    free( all );
+}
+
+/*
+================
+BenchRefresh
+
+  Обновить указатели на секции и параметры после IniCompact
+================
+*/
+static void BenchRefresh( bench_t* b ) {
+    ptrdiff_t i;
+
+    free( b->string );
+    for( i = 0; i < BENCH_LOOKUPS; i++ ) {
+        free( b->missNames[i] );
+    }
+    BenchPrepare( b );
+}
+
+/*
+================
+Benchmarks
+================
+*/
+static void BenchFindSectHit( bench_t* b, ptrdiff_t n ) {
+    ptrdiff_t i;
+    for( i = 0; i < n; i++ ) {
+        b->sink += (ptrdiff_t)IniFindSect( &b->ini,
+            b->sectNames[i & (BENCH_LOOKUPS - 1)] );
+    }
+}
+
+static void BenchFindSectMiss( bench_t* b, ptrdiff_t n ) {
+    ptrdiff_t i;
+    for( i = 0; i < n; i++ ) {
+        b->sink += (ptrdiff_t)IniFindSect( &b->ini,
+            b->missNames[i & (BENCH_LOOKUPS - 1)] );
+    }
+}
+
+static void BenchFindSectK( bench_t* b, ptrdiff_t n ) {
+    ptrdiff_t i;
+    for( i = 0; i < n; i++ ) {
+        b->sink += (ptrdiff_t)IniFindSectK( &b->ini,
+            b->sectHandles + (i & (BENCH_LOOKUPS - 1)) );
+    }
+}
+
+static void BenchFindParamHit( bench_t* b, ptrdiff_t n ) {
+    ptrdiff_t i;
+    ptrdiff_t j;
+    for( i = 0; i < n; i++ ) {
+        j = i & (BENCH_LOOKUPS - 1);
+        b->sink += (ptrdiff_t)IniFindParam( b->sects[j], b->ownKeys[j] );
+    }
+}
+
+static void BenchFindParamK( bench_t* b, ptrdiff_t n ) {
+    ptrdiff_t i;
+    ptrdiff_t j;
+    for( i = 0; i < n; i++ ) {
+        j = i & (BENCH_LOOKUPS - 1);
+        b->sink += (ptrdiff_t)IniFindParamK( b->sects[j], b->keyHandles + j );
+    }
+}
+
+static void BenchFindParamInherited( bench_t* b, ptrdiff_t n ) {
+    ptrdiff_t i;
+    ptrdiff_t j;
+    for( i = 0; i < n; i++ ) {
+        j = i % b->numInherited;
+        b->sink += (ptrdiff_t)IniFindParam( b->inhSects[j], b->inhKeys[j] );
+    }
+}
+
+static void BenchFindParamMiss( bench_t* b, ptrdiff_t n ) {
+    ptrdiff_t i;
+    ptrdiff_t j;
+    for( i = 0; i < n; i++ ) {
+        j = i & (BENCH_LOOKUPS - 1);
+        b->sink += (ptrdiff_t)IniFindParam( b->sects[j], b->missNames[j] );
+    }
+}
+
+static void BenchFind( bench_t* b, ptrdiff_t n ) {
+    ptrdiff_t i;
+    ptrdiff_t j;
+    for( i = 0; i < n; i++ ) {
+        j = i & (BENCH_LOOKUPS - 1);
+        b->sink += (ptrdiff_t)IniFind( &b->ini, b->sectNames[j],
+            b->ownKeys[j] );
+    }
+}
+
+static void BenchRead1iv( bench_t* b, ptrdiff_t n ) {
+    ptrdiff_t i;
+    int iv[1];
+    for( i = 0; i < n; i++ ) {
+        IniRead1iv( b->reads[BENCH_READ_1IV][i % b->numReads[BENCH_READ_1IV]], iv );
+        b->sink += iv[0];
+    }
+}
+
+static void BenchRead4iv( bench_t* b, ptrdiff_t n ) {
+    ptrdiff_t i;
+    int iv[4];
+    for( i = 0; i < n; i++ ) {
+        IniRead4iv( b->reads[BENCH_READ_4IV][i % b->numReads[BENCH_READ_4IV]], iv );
+        b->sink += iv[3];
+    }
+}
+
+static void BenchRead4fv( bench_t* b, ptrdiff_t n ) {
+    ptrdiff_t i;
+    float fv[4];
+    for( i = 0; i < n; i++ ) {
+        IniRead4fv( b->reads[BENCH_READ_4FV][i % b->numReads[BENCH_READ_4FV]], fv );
+        b->sink += (ptrdiff_t)fv[3];
+    }
+}
+
+static void BenchReadBool( bench_t* b, ptrdiff_t n ) {
+    ptrdiff_t i;
+    unsigned char bv;
+    for( i = 0; i < n; i++ ) {
+        IniReadBool( b->reads[BENCH_READ_BOOL][i % b->numReads[BENCH_READ_BOOL]], &bv );
+        b->sink += bv;
+    }
+}
+
+static void BenchReadString( bench_t* b, ptrdiff_t n ) {
+    ptrdiff_t i;
+    for( i = 0; i < n; i++ ) {
+        IniReadString( b->reads[BENCH_READ_STRING][i % b->numReads[BENCH_READ_STRING]],
+            b->string );
+        b->sink += b->string[0];
+    }
+}
+
+static fnBench benchReadFns[BENCH_READ_COUNT] = {
+    BenchRead1iv, BenchRead4iv, BenchRead4fv, BenchReadBool, BenchReadString
+};
+
+/*
+================
+BenchIterate
+
+  Обойти все параметры всех секций, возвращает наносекунды на параметр
+================
+*/
+static double BenchIterate( bench_t* b ) {
+    inihandler_t hs;
+    inihandler_t hp;
+    ptrdiff_t count;
+    double best;
+    double start;
+    double t;
+    int i;
+
+    best = 0;
+    count = 0;
+    for( i = 0; i < b->repeats; i++ ) {
+        count = 0;
+        start = BenchNow();
+        if( IniFirstSect( &hs, &b->ini, NULL, NULL ) ) {
+            do {
+                if( IniFirstParam( &hp, hs.sect, NULL, NULL ) ) {
+                    do {
+                        count += hp.param->value ? hp.param->value->length : 0;
+                    } while( IniNextParam( &hp ) );
+                }
+            } while( IniNextSect( &hs ) );
+        }
+        t = BenchNow() - start;
+        if( i == 0 || t < best ) {
+            best = t;
+        }
+    }
+    b->sink += count;
+    return b->numParams ? best * 1e9 / (double)b->numParams : 0;
+}
+
+/*
+================
+BenchLookups
+
+  Все бенчмарки поиска, suffix добавляется к именам результатов
+================
+*/
+static void BenchLookups( bench_t* b, const char* suffix ) {
+    char name[64];
+
+    sprintf( name, "find_sect.hit%s", suffix );
+    BenchResult( name, BenchRun( b, BenchFindSectHit ), "ns/op" );
+    sprintf( name, "find_sect.miss%s", suffix );
+    BenchResult( name, BenchRun( b, BenchFindSectMiss ), "ns/op" );
+    sprintf( name, "find_sect_k.hit%s", suffix );
+    BenchResult( name, BenchRun( b, BenchFindSectK ), "ns/op" );
+    sprintf( name, "find_param.hit%s", suffix );
+    BenchResult( name, BenchRun( b, BenchFindParamHit ), "ns/op" );
+    sprintf( name, "find_param_k.hit%s", suffix );
+    BenchResult( name, BenchRun( b, BenchFindParamK ), "ns/op" );
+    if( b->numInherited ) {
+        sprintf( name, "find_param.inherited%s", suffix );
+        BenchResult( name, BenchRun( b, BenchFindParamInherited ), "ns/op" );
+    }
+    sprintf( name, "find_param.miss%s", suffix );
+    BenchResult( name, BenchRun( b, BenchFindParamMiss ), "ns/op" );
+    sprintf( name, "find.hit%s", suffix );
+    BenchResult( name, BenchRun( b, BenchFind ), "ns/op" );
+}
+
+/*
+================
+BenchMemory
+================
+*/
+static void BenchMemory( bench_t* b, const char* suffix ) {
+    inimemstats_t stats;
+    char name[64];
+    int i;
+
+    IniGetMemStats( &b->ini, NULL, &stats );
+    sprintf( name, "mem.total%s", suffix );
+    BenchResult( name, (double)stats.total.curBytes, "bytes" );
+    sprintf( name, "mem.per_param%s", suffix );
+    BenchResult( name, b->numParams ?
+        (double)stats.total.curBytes / (double)b->numParams : 0, "bytes" );
+    for( i = 1; i < INI_MTAG_COUNT; i++ ) {
+        if( stats.tags[i].curBytes ) {
+            sprintf( name, "mem.%s%s", benchTags[i], suffix );
+            BenchResult( name, (double)stats.tags[i].curBytes, "bytes" );
+        }
+    }
+}
+
+/*
+================
+main
+================
+*/
+int main( int argc, char** argv ) {
+    static bench_t b;
+    char path[1100];
+    double start;
+    double t;
+    int i;
+
+    b.minTime = 0.2;
+    b.repeats = 3;
+    b.filename = NULL;
+    for( i = 1; i < argc; i++ ) {
+        if( !strcmp( argv[i], "-t" ) && i + 1 < argc ) {
+            b.minTime = atof( argv[++i] );
+        } else if( !strcmp( argv[i], "-r" ) && i + 1 < argc ) {
+            b.repeats = atoi( argv[++i] );
+        } else if( argv[i][0] != '-' && !b.filename ) {
+            b.filename = argv[i];
+        } else {
+            b.filename = NULL;
+            break;
+        }
+    }
+    if( !b.filename || b.repeats < 1 ) {
+        fprintf( stderr, "usage: inibench [-t seconds] [-r repeats] "
+            "file.ini\n" );
+        return 1;
+    }
+
+    // Loading without the section check first, the checked tree is the one
+    // measured by the rest of the benchmark
+    printf( "# file=%s\n", b.filename );
+    BenchLoadBest( &b, 0, "load.bulk" );
+    BenchValidate( &b );
+    BenchPrepare( &b );
+    printf( "# sections=%ld params=%ld\n", (long)b.numSects,
+        (long)b.numParams );
+    IniFree( &b.ini );
+    BenchLoadBest( &b, 1, "load.checked" );
+    BenchRefresh( &b );
+    BenchMemory( &b, "" );
+
+    BenchLookups( &b, "" );
+    for( i = 0; i < BENCH_READ_COUNT; i++ ) {
+        if( b.numReads[i] ) {
+            BenchResult( benchReads[i], BenchRun( &b, benchReadFns[i] ),
+                "ns/op" );
+        }
+    }
+    BenchResult( "iterate", BenchIterate( &b ), "ns/param" );
+
+    sprintf( path, "%.1000s.bench_save", b.filename );
+    start = BenchNow();
+    if( IniSaveToFile( &b.ini, path ) ) {
+        fprintf( stderr, "inibench: can not save '%s'\n", path );
+    }
+    BenchResult( "save", (BenchNow() - start) * 1e3, "ms" );
+    remove( path );
+
+    // Compacted tree
+    start = BenchNow();
+    IniCompact( &b.ini );
+    BenchResult( "compact", (BenchNow() - start) * 1e3, "ms" );
+    BenchRefresh( &b );
+    BenchResult( "iterate.compact", BenchIterate( &b ), "ns/param" );
+    BenchMemory( &b, ".compact" );
+
+    // Frozen tree
+    start = BenchNow();
+    if( IniFreeze( &b.ini ) ) {
+        fprintf( stderr, "inibench: some tables are not built\n" );
+    }
+    t = BenchNow() - start;
+    BenchResult( "freeze", t * 1e3, "ms" );
+    BenchResult( "freeze.per_key", t * 1e9 / (double)(b.numSects + b.numParams),
+        "ns/key" );
+    BenchLookups( &b, ".frozen" );
+    BenchMemory( &b, ".frozen" );
+
+    start = BenchNow();
+    IniFree( &b.ini );
+    BenchResult( "free.compact", (BenchNow() - start) * 1e3, "ms" );
+
+    free( b.string );
+    for( i = 0; i < BENCH_LOOKUPS; i++ ) {
+        free( b.missNames[i] );
+    }
+    return (int)(b.sink & 0);
+}
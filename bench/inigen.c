@@ -0,0 +1,249 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+
+/*
+  Генератор синтетических ini-файлов для бенчмарков
+
+  inigen [-s sections] [-p params] [-v valueSize] [-d depth] [-f fanout]
+         [-i includes] [-r seed] dir
+
+  Секции делятся на depth + 1 полос, каждая секция полосы L > 0 наследует
+fanout секций полосы L - 1, так что поиск унаследованного ключа в последней
+полосе проходит depth уровней. Ключи секций полосы L называются kL_N, поэтому
+одни и те же ключи повторяются во многих секциях. Секции разносятся по
+includes + 1 файлам: main.ini включает inc1.ini, тот inc2.ini и т.д., каждый
+файл подключает следующий в своём начале. При одинаковых параметрах файлы
+получаются одинаковыми на любой платформе
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+typedef struct {
+    long            sections;   // Number of sections
+    long            params;     // Parameters per section
+    long            valueSize;  // Length of the string values
+    long            depth;      // Inheritance depth
+    long            fanout;     // Parents of each inheriting section
+    long            includes;   // Include nesting
+    unsigned long   seed;       // Random seed
+} inigencfg_t;
+
+static unsigned long genState;
+
+
+
+/*
+================
+GenRand
+
+  Простой генератор (xorshift), чтобы результат не зависел от rand()
+================
+*/
+static unsigned long GenRand( void ) {
+    genState ^= (genState << 13) & 0xffffffffUL;
+    genState ^= genState >> 17;
+    genState ^= (genState << 5) & 0xffffffffUL;
+    return genState & 0xffffffffUL;
+}
+
+/*
+================
+GenBand
+
+  Полоса секции с номером n
+================
+*/
+static long GenBand( const inigencfg_t* cfg, long n ) {
+    return n * (cfg->depth + 1) / cfg->sections;
+}
+
+/*
+================
+GenBandStart
+
+  Номер первой секции полосы band
+================
+*/
+static long GenBandStart( const inigencfg_t* cfg, long band ) {
+    long n;
+
+    // Inverse of GenBand
+    n = (band * cfg->sections + cfg->depth) / (cfg->depth + 1);
+    while( n > 0 && GenBand( cfg, n - 1 ) >= band ) {
+        n--;
+    }
+    while( n < cfg->sections && GenBand( cfg, n ) < band ) {
+        n++;
+    }
+    return n;
+}
+
+/*
+================
+GenValue
+================
+*/
+static void GenValue( FILE* f, const inigencfg_t* cfg, long i ) {
+    long k;
+
+    // Values for every IniRead* function
+    switch( i % 5 ) {
+        case 0:
+            fprintf( f, "%lu", GenRand() % 100000 );
+            break;
+        case 1:
+            fprintf( f, "%lu, %lu, %lu, %lu", GenRand() % 1000,
+                GenRand() % 1000, GenRand() % 1000, GenRand() % 1000 );
+            break;
+        case 2:
+            fprintf( f, "%lu.%02lu, %lu.%02lu, %lu.%02lu, %lu.%02lu",
+                GenRand() % 100, GenRand() % 100, GenRand() % 100,
+                GenRand() % 100, GenRand() % 100, GenRand() % 100,
+                GenRand() % 100, GenRand() % 100 );
+            break;
+        case 3:
+            fputs( GenRand() & 1 ? "true" : "false", f );
+            break;
+        default:
+            for( k = 0; k < cfg->valueSize; k++ ) {
+                fputc( 'a' + (int)(GenRand() % 26), f );
+            }
+            break;
+    }
+}
+
+/*
+================
+GenSect
+================
+*/
+static void GenSect( FILE* f, const inigencfg_t* cfg, long n ) {
+    long band;
+    long start;
+    long count;
+    long first;
+    long i;
+
+    band = GenBand( cfg, n );
+    fprintf( f, "[sect_%ld]", n );
+
+    // Parents are taken from the previous band, which is already parsed
+    if( band > 0 ) {
+        start = GenBandStart( cfg, band - 1 );
+        count = GenBandStart( cfg, band ) - start;
+        first = (long)(GenRand() % count);
+        for( i = 0; i < cfg->fanout && i < count; i++ ) {
+            fprintf( f, "%c sect_%ld", i ? ',' : ':',
+                start + (first + i) % count );
+        }
+    }
+    fputc( '\n', f );
+
+    for( i = 0; i < cfg->params; i++ ) {
+        fprintf( f, "k%ld_%ld = ", band, i );
+        GenValue( f, cfg, i );
+        fputc( '\n', f );
+    }
+    fputc( '\n', f );
+}
+
+/*
+================
+GenFiles
+================
+*/
+static int GenFiles( const inigencfg_t* cfg, const char* dir ) {
+    char path[1100];
+    FILE* f;
+    long files;
+    long file;
+    long first;
+    long last;
+    long n;
+
+    // The deepest file is parsed first, so it gets the first sections
+    files = cfg->includes + 1;
+    for( file = 0; file < files; file++ ) {
+        if( file == 0 ) {
+            sprintf( path, "%.1000s/main.ini", dir );
+        } else {
+            sprintf( path, "%.1000s/inc%ld.ini", dir, file );
+        }
+        if( (f = fopen( path, "w" )) == NULL ) {
+            fprintf( stderr, "inigen: can not open file '%s'\n", path );
+            return -1;
+        }
+        if( file + 1 < files ) {
+            fprintf( f, "#include \"inc%ld.ini\"\n\n", file + 1 );
+        }
+
+        first = cfg->sections * (files - 1 - file) / files;
+        last = cfg->sections * (files - file) / files;
+        genState = (cfg->seed * 2654435761UL + (unsigned long)file) & 
+            0xffffffffUL;
+        if( genState == 0 ) {
+            genState = 1;
+        }
+        for( n = first; n < last; n++ ) {
+            GenSect( f, cfg, n );
+        }
+        fclose( f );
+    }
+    return 0;
+}
+
+/*
+================
+main
+================
+*/
+int main( int argc, char** argv ) {
+    inigencfg_t cfg;
+    const char* dir;
+    int i;
+
+    cfg.sections = 1000;
+    cfg.params = 10;
+    cfg.valueSize = 16;
+    cfg.depth = 3;
+    cfg.fanout = 1;
+    cfg.includes = 0;
+    cfg.seed = 1;
+    dir = NULL;
+
+    for( i = 1; i < argc; i++ ) {
+        if( argv[i][0] == '-' && argv[i][1] && !argv[i][2] && i + 1 < argc ) {
+            switch( argv[i][1] ) {
+                case 's': cfg.sections = atol( argv[++i] ); continue;
+                case 'p': cfg.params = atol( argv[++i] ); continue;
+                case 'v': cfg.valueSize = atol( argv[++i] ); continue;
+                case 'd': cfg.depth = atol( argv[++i] ); continue;
+                case 'f': cfg.fanout = atol( argv[++i] ); continue;
+                case 'i': cfg.includes = atol( argv[++i] ); continue;
+                case 'r': cfg.seed = strtoul( argv[++i], NULL, 10 ); continue;
+            }
+        }
+        if( dir || argv[i][0] == '-' ) {
+            dir = NULL;
+            break;
+        }
+        dir = argv[i];
+    }
+
+    if( !dir || cfg.sections < 1 || cfg.params < 0 || cfg.valueSize < 1 ||
+        cfg.depth < 0 || cfg.fanout < 1 || cfg.includes < 0 )
+    {
+        fprintf( stderr, "usage: inigen [-s sections] [-p params] "
+            "[-v valueSize] [-d depth] [-f fanout] [-i includes] [-r seed] "
+            "dir\n" );
+        return 1;
+    }
+    if( cfg.depth >= cfg.sections ) {
+        cfg.depth = cfg.sections - 1;
+    }
+
+    return GenFiles( &cfg, dir ) ? 1 : 0;
+}
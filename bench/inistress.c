@@ -0,0 +1,538 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+
+/*
+  Стресс-тест перестройки графа наследования
+
+  inistress [-s sections] [-l levels] [-n ops] [-r seed] [-b bits] [-m]
+
+  Секции делятся на levels уровней, секция наследует только секции нижних
+уровней, поэтому граф остаётся без циклов, а глубина наследования не больше
+levels. Тест случайно добавляет наследования (IniSectInherit), удаляет их с
+обеих сторон (IniExcludeInherit, IniExcludeHeir) и между изменениями ищет
+параметры (IniFindParam), проверяет предков и наследников (IniIsAncestor,
+IniCollectAncestors, IniCollectDescendants). Каждый результат сверяется с
+простой моделью: списки родителей и наследников в массивах и поиск обходом в
+глубину. Списки наследования самого ini (порядок, обратные ссылки, Last
+указатели и парные элементы) сверяются с моделью периодически и в конце.
+С ключом -b включаются фильтры Блума (IniSetBloomFilters), с ключом -m
+случайные секции получают таблицы параметров (IniMaterializeSect), которые
+должны сбрасываться при перестройке графа
+*/
+
+#include <ini.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#define STRESS_KEYS         32      // Keys k0..k31
+#define STRESS_MAX_PARENTS  3       // Bounds the naive search to 3^levels
+#define STRESS_CHECK_PERIOD 1024    // Operations between the list checks
+
+typedef struct {
+    int*            items;
+    int             count;
+    int             size;
+} stresslist_t;
+
+typedef struct {
+    ini_t           ini;
+    inisect_t**     sects;      // Sections of the ini by the model index
+    stresslist_t*   parents;    // Inherited sections in the list order
+    stresslist_t*   heirs;      // Heirs in the list order
+    unsigned*       keys;       // Own keys of each section (bit mask)
+    unsigned*       visited;    // Visit stamps of the reachability search
+    unsigned        stamp;      // Current visit stamp
+    inisect_t**     collected;  // Result of IniCollect*
+    int             numSects;
+    int             levels;
+    int             materialize;
+    long            errors;
+} stress_t;
+
+static unsigned long stressState;
+
+
+
+/*
+================
+StressRand
+================
+*/
+static unsigned long StressRand( void ) {
+    stressState ^= (stressState << 13) & 0xffffffffUL;
+    stressState ^= stressState >> 17;
+    stressState ^= (stressState << 5) & 0xffffffffUL;
+    return stressState & 0xffffffffUL;
+}
+
+/*
+================
+StressFail
+================
+*/
+static void StressFail( stress_t* st, long op, const char* what, int a, int b ) {
+    if( st->errors++ < 20 ) {
+        fprintf( stderr, "inistress: op %ld: %s (s%d, s%d)\n", op, what, a, b );
+    }
+}
+
+/*
+================
+StressListAdd
+================
+*/
+static void StressListAdd( stresslist_t* list, int v ) {
+    if( list->count == list->size ) {
+        list->size = list->size ? list->size * 2 : 4;
+        list->items = (int*)realloc( list->items, list->size * sizeof(int) );
+    }
+    list->items[list->count++] = v;
+}
+
+/*
+================
+StressListRemove
+================
+*/
+static void StressListRemove( stresslist_t* list, int v ) {
+    int i;
+
+    for( i = 0; i < list->count && list->items[i] != v; i++ );
+    if( i < list->count ) {
+        memmove( list->items + i, list->items + i + 1,
+            (list->count - i - 1) * sizeof(int) );
+        list->count--;
+    }
+}
+
+/*
+================
+StressListHas
+================
+*/
+static int StressListHas( const stresslist_t* list, int v ) {
+    int i;
+
+    for( i = 0; i < list->count; i++ ) {
+        if( list->items[i] == v ) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+================
+StressIndex
+
+  Номер секции в модели по названию "sN"
+================
+*/
+static int StressIndex( const inisect_t* sect ) {
+    return atoi( sect->key->string + 1 );
+}
+
+/*
+================
+StressLevel
+================
+*/
+static int StressLevel( const stress_t* st, int n ) {
+    return (int)((long)n * st->levels / st->numSects);
+}
+
+/*
+================
+StressFind
+
+  Поиск ключа как в IniFindParam: своя секция, затем унаследованные
+секции по порядку, каждая со своими предками. Возвращает номер секции с
+ключом или -1
+================
+*/
+static int StressFind( const stress_t* st, int n, int key ) {
+    int found;
+    int i;
+
+    if( st->keys[n] & (1u << key) ) {
+        return n;
+    }
+    for( i = 0; i < st->parents[n].count; i++ ) {
+        found = StressFind( st, st->parents[n].items[i], key );
+        if( found >= 0 ) {
+            return found;
+        }
+    }
+    return -1;
+}
+
+/*
+================
+StressReach
+
+  Отметить текущей меткой все секции, достижимые из n по спискам lists
+================
+*/
+static int StressReach( stress_t* st, const stresslist_t* lists, int n ) {
+    int count;
+    int next;
+    int i;
+
+    count = 0;
+    for( i = 0; i < lists[n].count; i++ ) {
+        next = lists[n].items[i];
+        if( st->visited[next] != st->stamp ) {
+            st->visited[next] = st->stamp;
+            count += 1 + StressReach( st, lists, next );
+        }
+    }
+    return count;
+}
+
+/*
+================
+StressCheckCollected
+
+  Сверить результат IniCollectAncestors или IniCollectDescendants с
+обходом модели
+================
+*/
+static void StressCheckCollected( stress_t* st, long op, int n, int ancestors ) {
+    ptrdiff_t count;
+    ptrdiff_t i;
+    int expected;
+
+    if( ancestors ) {
+        count = IniCollectAncestors( st->sects[n], st->collected,
+            st->numSects );
+    } else {
+        count = IniCollectDescendants( st->sects[n], st->collected,
+            st->numSects );
+    }
+    st->stamp++;
+    expected = StressReach( st, ancestors ? st->parents : st->heirs, n );
+    if( count != expected ) {
+        StressFail( st, op, ancestors ? "ancestor count" : "descendant count",
+            n, (int)count );
+        return;
+    }
+    for( i = 0; i < count; i++ ) {
+        if( st->visited[StressIndex( st->collected[i] )] != st->stamp ) {
+            StressFail( st, op, ancestors ? "wrong ancestor" :
+                "wrong descendant", n, StressIndex( st->collected[i] ) );
+            return;
+        }
+    }
+}
+
+/*
+================
+StressCheckLists
+
+  Сверить списки наследования секции n с моделью в обе стороны
+================
+*/
+static void StressCheckLists( stress_t* st, long op, int n ) {
+    inisect_t* sect;
+    iniinh_t* inh;
+    iniinh_t* last;
+    int i;
+
+    sect = st->sects[n];
+    last = NULL;
+    for( i = 0, inh = sect->inherit; inh; inh = inh->next, i++ ) {
+        if( i >= st->parents[n].count || inh->prev != last ||
+            inh->sect != sect ||
+            StressIndex( inh->inhSect ) != st->parents[n].items[i] ||
+            !inh->twin || inh->twin->twin != inh ||
+            inh->twin->sect != inh->inhSect || inh->twin->inhSect != sect )
+        {
+            StressFail( st, op, "inherit list", n, i );
+            return;
+        }
+        last = inh;
+    }
+    if( i != st->parents[n].count || sect->inheritLast != last ) {
+        StressFail( st, op, "inherit list end", n, i );
+        return;
+    }
+
+    last = NULL;
+    for( i = 0, inh = sect->heirs; inh; inh = inh->next, i++ ) {
+        if( i >= st->heirs[n].count || inh->prev != last ||
+            inh->sect != sect ||
+            StressIndex( inh->inhSect ) != st->heirs[n].items[i] ||
+            !inh->twin || inh->twin->twin != inh )
+        {
+            StressFail( st, op, "heir list", n, i );
+            return;
+        }
+        last = inh;
+    }
+    if( i != st->heirs[n].count || sect->heirsLast != last ) {
+        StressFail( st, op, "heir list end", n, i );
+    }
+}
+
+/*
+================
+StressInherit
+
+  Добавить наследование секции a от секции b и в ini, и в модель
+================
+*/
+static void StressInherit( stress_t* st, long op, int a, int b ) {
+    char name[32];
+
+    sprintf( name, "s%d", b );
+    if( IniSectInherit( st->sects[a], name ) ) {
+        StressFail( st, op, "IniSectInherit failed", a, b );
+        return;
+    }
+    StressListAdd( st->parents + a, b );
+    StressListAdd( st->heirs + b, a );
+}
+
+/*
+================
+StressNth
+
+  Элемент списка с номером k
+================
+*/
+static iniinh_t* StressNth( iniinh_t* inh, int k ) {
+    while( inh && k-- > 0 ) {
+        inh = inh->next;
+    }
+    return inh;
+}
+
+/*
+================
+StressOp
+================
+*/
+static void StressOp( stress_t* st, long op ) {
+    iniparam_t* p;
+    iniinh_t* inh;
+    char name[32];
+    char value[32];
+    int kind;
+    int found;
+    int key;
+    int a;
+    int b;
+    int k;
+
+    a = (int)(StressRand() % (unsigned long)st->numSects);
+    kind = (int)(StressRand() % 100);
+
+    if( kind < 25 ) {
+        // New inheritance from a lower level, without repeated links
+        if( StressLevel( st, a ) == 0 ||
+            st->parents[a].count >= STRESS_MAX_PARENTS )
+        {
+            return;
+        }
+        b = (int)(StressRand() % (unsigned long)a);
+        if( StressLevel( st, b ) < StressLevel( st, a ) &&
+            !StressListHas( st->parents + a, b ) )
+        {
+            StressInherit( st, op, a, b );
+        }
+    } else if( kind < 35 ) {
+        if( st->parents[a].count == 0 ) {
+            return;
+        }
+        k = (int)(StressRand() % (unsigned long)st->parents[a].count);
+        inh = StressNth( st->sects[a]->inherit, k );
+        if( !inh ) {
+            StressFail( st, op, "short inherit list", a, k );
+            return;
+        }
+        b = StressIndex( inh->inhSect );
+        IniExcludeInherit( inh );
+        StressListRemove( st->parents + a, b );
+        StressListRemove( st->heirs + b, a );
+    } else if( kind < 45 ) {
+        if( st->heirs[a].count == 0 ) {
+            return;
+        }
+        k = (int)(StressRand() % (unsigned long)st->heirs[a].count);
+        inh = StressNth( st->sects[a]->heirs, k );
+        if( !inh ) {
+            StressFail( st, op, "short heir list", a, k );
+            return;
+        }
+        b = StressIndex( inh->inhSect );
+        IniExcludeHeir( inh );
+        StressListRemove( st->heirs + a, b );
+        StressListRemove( st->parents + b, a );
+    } else if( kind < 90 ) {
+        key = (int)(StressRand() % STRESS_KEYS);
+        if( st->materialize && StressRand() % 16 == 0 ) {
+            IniMaterializeSect( st->sects[a] );
+        }
+        sprintf( name, "k%d", key );
+        p = IniFindParam( st->sects[a], name );
+        found = StressFind( st, a, key );
+        if( found >= 0 ) {
+            sprintf( value, "s%d.k%d", found, key );
+        }
+        if( (found < 0) != (p == NULL) ||
+            (p && strcmp( p->value->string, value )) )
+        {
+            StressFail( st, op, p ? p->value->string : "not found", a, found );
+        }
+    } else if( kind < 96 ) {
+        b = (int)(StressRand() % (unsigned long)st->numSects);
+        st->stamp++;
+        StressReach( st, st->parents, a );
+        if( IniIsAncestor( st->sects[a], st->sects[b] ) !=
+            (st->visited[b] == st->stamp) )
+        {
+            StressFail( st, op, "IniIsAncestor", a, b );
+        }
+    } else {
+        StressCheckCollected( st, op, a, kind < 98 );
+    }
+}
+
+/*
+================
+StressCreate
+================
+*/
+static void StressCreate( stress_t* st, int sections, int levels, int bloomBits ) {
+    inidescr_t* descr;
+    char name[32];
+    char value[32];
+    int i;
+    int k;
+
+    st->numSects = sections;
+    st->levels = levels;
+    st->sects = (inisect_t**)calloc( sections, sizeof(inisect_t*) );
+    st->collected = (inisect_t**)calloc( sections, sizeof(inisect_t*) );
+    st->parents = (stresslist_t*)calloc( sections, sizeof(stresslist_t) );
+    st->heirs = (stresslist_t*)calloc( sections, sizeof(stresslist_t) );
+    st->keys = (unsigned*)calloc( sections, sizeof(unsigned) );
+    st->visited = (unsigned*)calloc( sections, sizeof(unsigned) );
+    st->stamp = 0;
+    st->errors = 0;
+
+    IniInit( &st->ini, malloc, free, NULL, NULL, 0 );
+    if( bloomBits ) {
+        IniSetBloomFilters( &st->ini, bloomBits );
+    }
+    descr = IniAppendDescr( &st->ini, "inistress.ini" );
+    for( i = 0; i < sections; i++ ) {
+        sprintf( name, "s%d", i );
+        st->sects[i] = IniAppendSect( descr, name );
+        // Few keys per section, most of the lookups go to the ancestors
+        st->keys[i] = (unsigned)StressRand() & (unsigned)StressRand() &
+            (unsigned)StressRand();
+        for( k = 0; k < STRESS_KEYS; k++ ) {
+            if( st->keys[i] & (1u << k) ) {
+                sprintf( name, "k%d", k );
+                sprintf( value, "s%d.k%d", i, k );
+                IniAppendParam( st->sects[i], name, value );
+            }
+        }
+        // One parent from any lower level to start with
+        if( StressLevel( st, i ) > 0 ) {
+            do {
+                k = (int)(StressRand() % (unsigned long)i);
+            } while( StressLevel( st, k ) == StressLevel( st, i ) );
+            StressInherit( st, 0, i, k );
+        }
+    }
+}
+
+/*
+================
+main
+================
+*/
+int main( int argc, char** argv ) {
+    stress_t st;
+    long ops;
+    long op;
+    int sections;
+    int levels;
+    int bloomBits;
+    int i;
+
+    sections = 4000;
+    levels = 6;
+    ops = 200000;
+    bloomBits = 0;
+    stressState = 1;
+    memset( &st, 0, sizeof(st) );
+
+    for( i = 1; i < argc; i++ ) {
+        if( !strcmp( argv[i], "-m" ) ) {
+            st.materialize = 1;
+        } else if( argv[i][0] == '-' && argv[i][1] && !argv[i][2] &&
+            i + 1 < argc )
+        {
+            switch( argv[i][1] ) {
+                case 's': sections = atoi( argv[++i] ); continue;
+                case 'l': levels = atoi( argv[++i] ); continue;
+                case 'n': ops = atol( argv[++i] ); continue;
+                case 'r': stressState = strtoul( argv[++i], NULL, 10 ); continue;
+                case 'b': bloomBits = atoi( argv[++i] ); continue;
+            }
+            sections = 0;
+            break;
+        } else {
+            sections = 0;
+            break;
+        }
+    }
+    stressState &= 0xffffffffUL;
+    if( stressState == 0 ) {
+        stressState = 1;
+    }
+    if( sections < 2 || levels < 1 || levels > sections || ops < 0 ||
+        bloomBits < 0 )
+    {
+        fprintf( stderr, "usage: inistress [-s sections] [-l levels] "
+            "[-n ops] [-r seed] [-b bits] [-m]\n" );
+        return 1;
+    }
+
+    StressCreate( &st, sections, levels, bloomBits );
+    for( op = 1; op <= ops && st.errors == 0; op++ ) {
+        StressOp( &st, op );
+        if( op % STRESS_CHECK_PERIOD == 0 ) {
+            StressCheckLists( &st, op,
+                (int)(StressRand() % (unsigned long)sections) );
+        }
+    }
+    for( i = 0; i < sections; i++ ) {
+        StressCheckLists( &st, ops, i );
+    }
+
+    IniFree( &st.ini );
+    for( i = 0; i < sections; i++ ) {
+        free( st.parents[i].items );
+        free( st.heirs[i].items );
+    }
+    free( st.parents );
+    free( st.heirs );
+    free( st.sects );
+    free( st.collected );
+    free( st.keys );
+    free( st.visited );
+
+    if( st.errors ) {
+        fprintf( stderr, "inistress: %ld errors\n", st.errors );
+        return 1;
+    }
+    printf( "inistress: %ld operations on %d sections ok\n", ops, sections );
+    return 0;
+}
@@ -0,0 +1,40 @@
+#!/bin/sh
+# Прогон бенчмарков на наборе сгенерированных деревьев
+#   bench/run.sh [out.tsv]
+# Для каждого дерева пишутся строки "дерево<TAB>имя<TAB>значение<TAB>единицы"
+# (см. bench/inibench.c), по умолчанию в stdout, а время загрузки каждого
+# дерева дублируется в stderr. Размеры 10k, 100k и 1M
+# ключей, отдельно глубокое наследование, вложенные #include и 100 тысяч
+# секций, каждая из которых наследует две секции
+
+set -e
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+BIN=$ROOT/bin
+WORK=${WORK:-$ROOT/bench/data}
+OUT=${1:-/dev/stdout}
+
+"$ROOT/build.sh" bench
+
+# name sections params valueSize depth fanout includes
+CONFIGS="
+keys10k     1000    10  16  3   1   0
+keys100k    10000   10  16  3   1   0
+keys1m      100000  10  16  3   1   0
+deep        5000    10  16  6   2   0
+wide        1000    50  64  1   1   0
+includes    5000    10  16  3   1   8
+inherit100k 100000  5   16  3   2   0
+"
+
+echo "$CONFIGS" | while read name sects params value depth fanout includes; do
+    [ -n "$name" ] || continue
+    mkdir -p "$WORK/$name"
+    "$BIN/inigen" -s $sects -p $params -v $value -d $depth -f $fanout \
+        -i $includes "$WORK/$name"
+    "$BIN/inibench" ${BENCH_ARGS} "$WORK/$name/main.ini" > "$WORK/$name.tsv"
+    sed "/^#/!s/^/$name\t/" "$WORK/$name.tsv"
+    awk -v name="$name" -F '\t' '$1 ~ /^load\./ {
+        printf "%-12s %-13s %10s %s\n", name, $1, $2, $3 }' \
+        "$WORK/$name.tsv" >&2
+done > "$OUT"
@@ -0,0 +1,34 @@
+#!/bin/sh
+# Сборка libini.a под Linux
+#   ./build.sh          - библиотека
+#   ./build.sh bench    - библиотека, генератор inigen, бенчмарк inibench и
+#                         стресс-тест наследования inistress
+# Флаги оптимизации можно переопределить: OPTIMIZE="-O3 -march=native"
+
+set -e
+
+SRC_DIR=src
+OBJ_DIR=obj
+LIB_DIR=lib
+BIN_DIR=bin
+
+SRCS=$SRC_DIR/ini.c
+OBJS=$OBJ_DIR/ini.o
+LIBNAME=libini.a
+
+CC=${CC:-gcc}
+OPTIMIZE=${OPTIMIZE:--O2 -DNDEBUG}
+WARNINGS="-Wall -Wno-unused-function"
+INCLUDE=-Iinclude
+
+mkdir -p $OBJ_DIR $LIB_DIR
+
+$CC -c $OPTIMIZE $WARNINGS $INCLUDE $SRCS -o $OBJS
+ar crs $LIB_DIR/$LIBNAME $OBJS
+
+if [ "$1" = "bench" ]; then
+    mkdir -p $BIN_DIR
+    $CC $OPTIMIZE $WARNINGS bench/inigen.c -o $BIN_DIR/inigen
+    $CC $OPTIMIZE $WARNINGS $INCLUDE bench/inibench.c -L$LIB_DIR -lini -pthread -o $BIN_DIR/inibench
+    $CC $OPTIMIZE $WARNINGS $INCLUDE bench/inistress.c -L$LIB_DIR -lini -pthread -o $BIN_DIR/inistress
+fi
@@ -0,0 +1,35 @@
+#!/bin/sh
+# Сборка фаззинг-тестов, бинарники в bin/fuzz
+#   fuzz/build.sh             - libFuzzer (clang -fsanitize=fuzzer)
+#   fuzz/build.sh standalone  - без libFuzzer, с fuzz/driver.c (gcc, AFL:
+#                               CC=afl-clang-fast fuzz/build.sh standalone)
+# Все сборки с ASan и UBSan. Запуск:
+#   bin/fuzz/fuzz_load -dict=fuzz/ini.dict fuzz/corpus/load
+#   bin/fuzz/fuzz_read fuzz/corpus/read
+#   bin/fuzz/fuzz_roundtrip fuzz/corpus/load
+# Сборка standalone прогоняет корпус, а с ключом -runs N делает N мутаций:
+#   bin/fuzz/fuzz_load -runs 100000 fuzz/corpus/load
+
+set -e
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+OUT=$ROOT/bin/fuzz
+TARGETS="fuzz_load fuzz_read fuzz_roundtrip"
+SANITIZE="-fsanitize=address,undefined -fno-sanitize-recover=undefined"
+FLAGS="-g -O1 -fno-omit-frame-pointer $SANITIZE -I$ROOT/include"
+
+mkdir -p "$OUT"
+
+if [ "$1" = "standalone" ]; then
+    CC=${CC:-gcc}
+    for t in $TARGETS; do
+        $CC $FLAGS "$ROOT/src/ini.c" "$ROOT/fuzz/$t.c" "$ROOT/fuzz/driver.c" \
+            -pthread -o "$OUT/$t"
+    done
+else
+    CC=${CC:-clang}
+    for t in $TARGETS; do
+        $CC $FLAGS -fsanitize=fuzzer "$ROOT/src/ini.c" "$ROOT/fuzz/$t.c" \
+            -pthread -o "$OUT/$t"
+    done
+fi
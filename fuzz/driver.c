@@ -0,0 +1,256 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+
+/*
+  Запуск фаззинг-функций без libFuzzer (gcc, AFL)
+
+  fuzz_x [-runs N] [-seed S] [files or dirs...]
+
+  Без -runs каждый вход выполняется один раз (воспроизведение падений и
+прогон корпуса), без файлов вход читается из stdin (так его передаёт AFL).
+С -runs N выполняется N случайных мутаций входов: замена, вставка и удаление
+байт, вставка слов из словаря ini и склейка входов. Это грубая замена
+libFuzzer для сборок, где его нет. Вход, на котором сработал abort (в том
+числе отчёт ASan с ASAN_OPTIONS=abort_on_error=1), сохраняется в файл
+crash-input текущего каталога
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define DRIVER_MAX_INPUT    65536
+#define DRIVER_MAX_INPUTS   1024
+
+typedef struct {
+    uint8_t*        data;
+    size_t          size;
+} driverinput_t;
+
+int LLVMFuzzerTestOneInput( const uint8_t* data, size_t size );
+
+static const char* driverWords[] = {
+    "[", "]", "=", ";", ",", ":", "\"", "'", "\\", "\n", " ", "/",
+    "#include", "#print", "true", "false", "on", "off", "1.5", "-7",
+    "[a]", "[b]: a", "k = v\n", "\\n", "\"str\"", "'s'"
+};
+
+static driverinput_t driverInputs[DRIVER_MAX_INPUTS];
+static int driverNumInputs;
+static unsigned long long driverState = 1;
+static const uint8_t* driverData;
+static size_t driverSize;
+
+
+
+/*
+================
+DriverCrash
+================
+*/
+static void DriverCrash( int sig ) {
+    ssize_t written;
+    int fd;
+
+    (void)sig;
+    fd = open( "crash-input", O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+    if( fd >= 0 ) {
+        written = write( fd, driverData, driverSize );
+        (void)written;
+        close( fd );
+    }
+    signal( SIGABRT, SIG_DFL );
+    abort();
+}
+
+/*
+================
+DriverRun
+================
+*/
+static void DriverRun( const uint8_t* data, size_t size ) {
+    driverData = data;
+    driverSize = size;
+    LLVMFuzzerTestOneInput( data, size );
+}
+
+/*
+================
+DriverRand
+================
+*/
+static size_t DriverRand( size_t n ) {
+    driverState = driverState * 6364136223846793005ULL + 1442695040888963407ULL;
+    return n ? (size_t)(driverState >> 33) % n : 0;
+}
+
+/*
+================
+DriverAdd
+================
+*/
+static void DriverAdd( FILE* f ) {
+    static uint8_t buf[DRIVER_MAX_INPUT];
+    driverinput_t* in;
+    size_t size;
+
+    size = fread( buf, 1, sizeof(buf), f );
+    if( driverNumInputs == DRIVER_MAX_INPUTS ) {
+        return;
+    }
+    in = driverInputs + driverNumInputs++;
+    in->data = (uint8_t*)malloc( size ? size : 1 );
+    memcpy( in->data, buf, size );
+    in->size = size;
+}
+
+/*
+================
+DriverAddPath
+================
+*/
+static void DriverAddPath( const char* path ) {
+    char name[2048];
+    struct dirent* e;
+    struct stat st;
+    DIR* dir;
+    FILE* f;
+
+    if( stat( path, &st ) == 0 && S_ISDIR( st.st_mode ) ) {
+        if( (dir = opendir( path )) == NULL ) {
+            return;
+        }
+        while( (e = readdir( dir )) != NULL ) {
+            if( e->d_name[0] != '.' ) {
+                sprintf( name, "%.1000s/%.1000s", path, e->d_name );
+                DriverAddPath( name );
+            }
+        }
+        closedir( dir );
+    } else if( (f = fopen( path, "rb" )) != NULL ) {
+        DriverAdd( f );
+        fclose( f );
+    } else {
+        fprintf( stderr, "driver: can not open '%s'\n", path );
+    }
+}
+
+/*
+================
+DriverMutate
+================
+*/
+static size_t DriverMutate( uint8_t* buf, size_t size ) {
+    const driverinput_t* other;
+    const char* word;
+    size_t pos;
+    size_t len;
+    int n;
+
+    for( n = 1 + (int)DriverRand( 4 ); n > 0; n-- ) {
+        pos = DriverRand( size + 1 );
+        switch( DriverRand( 5 ) ) {
+            case 0:
+                if( size ) {
+                    buf[DriverRand( size )] = (uint8_t)DriverRand( 256 );
+                }
+                break;
+            case 1:
+                if( size ) {
+                    len = 1 + DriverRand( 8 );
+                    len = pos + len > size ? size - pos : len;
+                    memmove( buf + pos, buf + pos + len, size - pos - len );
+                    size -= len;
+                }
+                break;
+            case 2:
+                if( size < DRIVER_MAX_INPUT ) {
+                    memmove( buf + pos + 1, buf + pos, size - pos );
+                    buf[pos] = (uint8_t)DriverRand( 256 );
+                    size++;
+                }
+                break;
+            case 3:
+                word = driverWords[DriverRand( sizeof(driverWords) /
+                    sizeof(driverWords[0]) )];
+                len = strlen( word );
+                if( size + len <= DRIVER_MAX_INPUT ) {
+                    memmove( buf + pos + len, buf + pos, size - pos );
+                    memcpy( buf + pos, word, len );
+                    size += len;
+                }
+                break;
+            default:
+                other = driverInputs + DriverRand( driverNumInputs );
+                len = DriverRand( other->size + 1 );
+                if( pos + len <= DRIVER_MAX_INPUT ) {
+                    memcpy( buf + pos, other->data + other->size - len, len );
+                    size = pos + len;
+                }
+                break;
+        }
+    }
+    return size;
+}
+
+/*
+================
+main
+================
+*/
+int main( int argc, char** argv ) {
+    static uint8_t buf[DRIVER_MAX_INPUT];
+    const driverinput_t* in;
+    uint8_t* data;
+    long runs;
+    long r;
+    size_t size;
+    int i;
+
+    signal( SIGABRT, DriverCrash );
+    signal( SIGSEGV, DriverCrash );
+
+    runs = 0;
+    for( i = 1; i < argc; i++ ) {
+        if( !strcmp( argv[i], "-runs" ) && i + 1 < argc ) {
+            runs = atol( argv[++i] );
+        } else if( !strcmp( argv[i], "-seed" ) && i + 1 < argc ) {
+            driverState = strtoul( argv[++i], NULL, 10 );
+        } else {
+            DriverAddPath( argv[i] );
+        }
+    }
+    if( driverNumInputs == 0 ) {
+        DriverAdd( stdin );
+    }
+
+    for( i = 0; i < driverNumInputs; i++ ) {
+        DriverRun( driverInputs[i].data, driverInputs[i].size );
+    }
+    // Every input gets its own allocation, so the sanitizer sees reads
+    // past its end
+    for( r = 0; r < runs; r++ ) {
+        in = driverInputs + DriverRand( driverNumInputs );
+        memcpy( buf, in->data, in->size );
+        size = DriverMutate( buf, in->size );
+        data = (uint8_t*)malloc( size ? size : 1 );
+        memcpy( data, buf, size );
+        DriverRun( data, size );
+        free( data );
+    }
+    fprintf( stderr, "driver: %d inputs, %ld mutations\n", driverNumInputs,
+        runs );
+
+    for( i = 0; i < driverNumInputs; i++ ) {
+        free( driverInputs[i].data );
+    }
+    return 0;
+}
@@ -0,0 +1,34 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+
+#ifndef __INI_FUZZ_H__
+#define __INI_FUZZ_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Имя загружаемого из памяти файла. Каталога нет, поэтому директивы
+// #include во входе не открывают файлы с диска
+#define FUZZ_FILENAME   "/nonexistent-ini-fuzz/fuzz.ini"
+
+// Проверка, которая работает и со сборкой без assert
+#define FUZZ_ASSERT(expr)   if(!(expr)){fprintf(stderr,"%s:%d: %s\n",\
+    __FILE__,__LINE__,#expr);abort();}else(void)0
+
+int LLVMFuzzerTestOneInput( const uint8_t* data, size_t size );
+
+// Настройки для входа: контрольная сумма байт
+static unsigned FuzzFlags( const uint8_t* data, size_t size ) {
+    unsigned sum;
+    size_t i;
+
+    sum = 0;
+    for( i = 0; i < size; i++ ) {
+        sum = sum * 31 + data[i];
+    }
+    return sum ^ (sum >> 8);
+}
+
+#endif //__INI_FUZZ_H__
@@ -0,0 +1,82 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+
+/*
+  Фаззинг разбора ini из памяти (IniLoadMem)
+
+  Настройки загрузки (комментарии, проверки повторов, фильтры Блума,
+IniFreeze, IniCompact) выбираются по контрольной сумме входа, поэтому
+корпус - обычные ini-файлы. После загрузки проверяется, что каждая секция
+и каждый параметр находятся поиском
+*/
+
+#include <ini.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "fuzz.h"
+
+/*
+================
+FuzzCheck
+================
+*/
+static void FuzzCheck( ini_t* ini ) {
+    inihandler_t hs;
+    inihandler_t hp;
+    iniparam_t* p;
+
+    if( IniFirstSect( &hs, ini, NULL, NULL ) ) {
+        do {
+            FUZZ_ASSERT( IniFindSect( ini, hs.cstr ) == hs.sect );
+            if( IniFirstParam( &hp, hs.sect, NULL, NULL ) ) {
+                do {
+                    p = hp.param;
+                    if( p->key ) {
+                        FUZZ_ASSERT( IniFindParam( hs.sect, p->key->string ) );
+                    }
+                } while( IniNextParam( &hp ) );
+            }
+        } while( IniNextSect( &hs ) );
+    }
+}
+
+/*
+================
+LLVMFuzzerTestOneInput
+================
+*/
+int LLVMFuzzerTestOneInput( const uint8_t* data, size_t size ) {
+    ini_t ini;
+    inidiag_t* diag;
+    unsigned flags;
+    char err[256];
+    char text[64];
+
+    flags = FuzzFlags( data, size );
+    IniInit( &ini, malloc, free, NULL, flags & 0x01 ? err : NULL, sizeof(err) );
+    IniSetParseComments( &ini, flags & 0x02 ? 1 : 0 );
+    IniSetCheckForSections( &ini, flags & 0x04 ? 0 : 1 );
+    IniSetCheckForParameters( &ini, flags & 0x08 ? 1 : 0 );
+    if( flags & 0x10 ) {
+        IniSetBloomFilters( &ini, 64 );
+    }
+    IniLoadMem( &ini, FUZZ_FILENAME, (const char*)data, (ptrdiff_t)size );
+
+    for( diag = IniFirstDiag( &ini ); diag; diag = diag->next ) {
+        FUZZ_ASSERT( IniFormatDiag( diag, text, sizeof(text) ) > 0 );
+    }
+    FuzzCheck( &ini );
+    if( flags & 0x20 ) {
+        IniFreeze( &ini );
+        FuzzCheck( &ini );
+    }
+    if( flags & 0x40 ) {
+        IniCompact( &ini );
+        FuzzCheck( &ini );
+    }
+    IniFree( &ini );
+    return 0;
+}
@@ -0,0 +1,82 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+
+/*
+  Фаззинг функций IniRead*
+
+  Весь вход становится значением параметра, которое читается всеми
+функциями IniRead*. Буферы строк выделяются по длине значения, как
+требует IniReadString
+*/
+
+#include <ini.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "fuzz.h"
+
+#define FUZZ_VECTOR     8
+
+/*
+================
+LLVMFuzzerTestOneInput
+================
+*/
+int LLVMFuzzerTestOneInput( const uint8_t* data, size_t size ) {
+    ini_t ini;
+    inidescr_t* descr;
+    inisect_t* sect;
+    iniparam_t* p;
+    char* value;
+    char* strings[FUZZ_VECTOR];
+    unsigned char bv[FUZZ_VECTOR];
+    float fv[4];
+    int iv[4];
+    int i;
+
+    value = (char*)malloc( size + 1 );
+    memcpy( value, data, size );
+    value[size] = 0;
+
+    IniInit( &ini, malloc, free, NULL, NULL, 0 );
+    descr = IniAppendDescr( &ini, FUZZ_FILENAME );
+    sect = IniAppendSect( descr, "fuzz" );
+    p = IniAppendParam( sect, "value", value );
+
+    // An empty value is stored as NULL, IniRead* do not accept it
+    if( p->value == NULL ) {
+        IniFree( &ini );
+        free( value );
+        return 0;
+    }
+
+    IniRead4fv( p, fv );
+    IniRead3fv( p, fv );
+    IniRead2fv( p, fv );
+    IniRead1fv( p, fv );
+    IniRead4iv( p, iv );
+    IniRead3iv( p, iv );
+    IniRead2iv( p, iv );
+    IniRead1iv( p, iv );
+    IniReadBool( p, bv );
+    for( i = 1; i <= FUZZ_VECTOR; i++ ) {
+        IniReadBoolv( p, bv, i );
+    }
+
+    for( i = 0; i < FUZZ_VECTOR; i++ ) {
+        strings[i] = (char*)malloc( p->value->length + 1 );
+    }
+    IniReadString( p, strings[0] );
+    for( i = 1; i <= FUZZ_VECTOR; i++ ) {
+        IniReadStringv( p, strings, i );
+    }
+    for( i = 0; i < FUZZ_VECTOR; i++ ) {
+        free( strings[i] );
+    }
+
+    IniFree( &ini );
+    free( value );
+    return 0;
+}
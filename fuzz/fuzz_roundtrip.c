@@ -0,0 +1,94 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+
+/*
+  Фаззинг сохранения: загруженное без ошибок дерево сохраняется
+(IniSaveToFile), сохранённый файл загружается снова и сохраняется ещё раз.
+Оба сохранённых файла должны совпадать, а вторая загрузка - пройти без
+ошибок. Файлы пишутся в каталог TMPDIR (или /tmp)
+*/
+
+#include <ini.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "fuzz.h"
+
+/*
+================
+FuzzReadFile
+================
+*/
+static char* FuzzReadFile( const char* filename, long* size ) {
+    FILE* f;
+    char* data;
+
+    f = fopen( filename, "rb" );
+    FUZZ_ASSERT( f );
+    fseek( f, 0, SEEK_END );
+    *size = ftell( f );
+    fseek( f, 0, SEEK_SET );
+    data = (char*)malloc( *size + 1 );
+    FUZZ_ASSERT( fread( data, 1, *size, f ) == (size_t)*size );
+    fclose( f );
+    return data;
+}
+
+/*
+================
+LLVMFuzzerTestOneInput
+================
+*/
+int LLVMFuzzerTestOneInput( const uint8_t* data, size_t size ) {
+    static char first[1024];
+    static char second[1024];
+    const char* dir;
+    ini_t ini;
+    char* a;
+    char* b;
+    long sizeA;
+    long sizeB;
+    unsigned flags;
+
+    if( !first[0] ) {
+        dir = getenv( "TMPDIR" );
+        dir = dir && dir[0] ? dir : "/tmp";
+        sprintf( first, "%.900s/inifuzz-%ld-a.ini", dir, (long)getpid() );
+        sprintf( second, "%.900s/inifuzz-%ld-b.ini", dir, (long)getpid() );
+    }
+
+    flags = FuzzFlags( data, size );
+    IniInit( &ini, malloc, free, NULL, NULL, 0 );
+    IniSetParseComments( &ini, flags & 0x01 ? 1 : 0 );
+    IniSetPrintComments( &ini, flags & 0x01 ? 1 : 0 );
+    IniSetCheckForParameters( &ini, flags & 0x02 ? 1 : 0 );
+    if( IniLoadMem( &ini, FUZZ_FILENAME, (const char*)data, (ptrdiff_t)size ) ||
+        ini.numOfErrors || ini.numOfWarnings )
+    {
+        IniFree( &ini );
+        return 0;
+    }
+    FUZZ_ASSERT( IniSaveToFile( &ini, first ) == 0 );
+    IniFree( &ini );
+
+    IniInit( &ini, malloc, free, NULL, NULL, 0 );
+    IniSetParseComments( &ini, flags & 0x01 ? 1 : 0 );
+    IniSetPrintComments( &ini, flags & 0x01 ? 1 : 0 );
+    IniSetCheckForParameters( &ini, flags & 0x02 ? 1 : 0 );
+    FUZZ_ASSERT( IniLoad( &ini, first ) == 0 && ini.numOfErrors == 0 );
+    FUZZ_ASSERT( IniSaveToFile( &ini, second ) == 0 );
+    IniFree( &ini );
+
+    a = FuzzReadFile( first, &sizeA );
+    b = FuzzReadFile( second, &sizeB );
+    FUZZ_ASSERT( sizeA == sizeB && !memcmp( a, b, sizeA ) );
+    free( a );
+    free( b );
+    remove( first );
+    remove( second );
+    return 0;
+}
@@ -5,10 +5,12 @@
 #define __INI_H__
 
 #include <stdio.h>
+#include <stddef.h>
 
 
 
 struct inidescr_s;
+struct inidiag_s;
 struct iniinh_s;
 struct iniparam_s;
 struct inisect_s;
@@ -18,6 +20,7 @@ typedef void*(*fnIniMalloc)(size_t);
 typedef void(*fnIniMallocTag)(unsigned);
 typedef void(*fnIniFree)(void*);
 typedef int(*fnIniFilter)(void*,void* userData);
+typedef void(*fnIniDiag)(const struct inidiag_s*,ptrdiff_t file,void* userData);
 
 
 
@@ -27,41 +30,232 @@ typedef int(*fnIniFilter)(void*,void* userData);
 #define INI_MTAG_HEIR       0x04
 #define INI_MTAG_PARAM      0x05
 #define INI_MTAG_SECT       0x06
+#define INI_MTAG_PARSER     0x07
+#define INI_MTAG_ATOMS      0x08
+#define INI_MTAG_ARENA      0x09
+#define INI_MTAG_EFFECTIVE  0x0A
+#define INI_MTAG_INDEX      0x0B
+#define INI_MTAG_KEYINDEX   0x0C
+#define INI_MTAG_CLOSURE    0x0D
+#define INI_MTAG_BLOOM      0x0E
+#define INI_MTAG_MPH        0x0F
+#define INI_MTAG_KEYS       0x10
+#define INI_MTAG_DIAG       0x11
+#define INI_MTAG_COUNT      0x12
+
+
+
+// Важность диагностики (inidiag_t::severity)
+#define INI_DIAG_ERROR      0
+#define INI_DIAG_WARNING    1
+
+// Коды диагностики (inidiag_t::code)
+#define INI_DIAG_OPEN_FILE          0x01    // Не удалось открыть файл
+#define INI_DIAG_READ_FILE          0x02    // Ошибка чтения файла
+#define INI_DIAG_REOPEN_FILE        0x03    // Не удалось снова открыть файл
+#define INI_DIAG_SAVE_FILE          0x04    // Не удалось открыть файл для
+                                            //     сохранения
+#define INI_DIAG_SECT_EXPECTED      0x05    // Параметр вне секции
+#define INI_DIAG_SECT_CLOSE         0x06    // Ожидалась ']'
+#define INI_DIAG_INHERIT            0x07    // Нет секции для наследования
+#define INI_DIAG_INCLUDE_NAME       0x08    // Ожидалось имя файла
+#define INI_DIAG_PRINT_VALUE        0x09    // Ожидалось значение #print
+#define INI_DIAG_DIRECTIVE          0x0A    // Неизвестная директива
+#define INI_DIAG_TOKEN              0x0B    // Неизвестная лексема
+#define INI_DIAG_PARAM_DEFINED      0x0C    // Повторный параметр (warning)
+#define INI_DIAG_FILE_INCLUDED      0x0D    // Повторное включение файла
+                                            //     (warning)
+#define INI_DIAG_SECT_DEFINED       0x0E    // Повторная секция (warning)
+#define INI_DIAG_COUNT              0x0F
 
 
 
+typedef struct {
+    ptrdiff_t           curBytes;   // Занято памяти сейчас
+    ptrdiff_t           peakBytes;  // Максимум занятой памяти
+    ptrdiff_t           allocs;     // Количество аллокаций
+    ptrdiff_t           frees;      // Количество освобождений
+} inimemcount_t;
+
+typedef struct {
+    inimemcount_t       tags[INI_MTAG_COUNT];// Счётчики по тегам аллокаций
+    inimemcount_t       total;      // Суммарные счётчики
+} inimemstats_t;
+
+typedef struct {
+    ptrdiff_t           checks;     // Проверок по фильтрам Блума
+    ptrdiff_t           negatives;  // Поисков отброшенных фильтром
+    ptrdiff_t           falsePositives;// Ложных срабатываний: фильтр
+                                    //     пропустил ключ, которого нет
+} inibloomstats_t;
+
+
+
+// Названия секций и ключи параметров интернированы: одинаковые ключи
+// ссылаются на одну и ту же строку, поэтому изменять их нельзя
 typedef struct {
     ptrdiff_t           length;     // Длинна строки
-    ptrdiff_t           size;       // Размер выделенной памяти
+    ptrdiff_t           size;       // Размер выделенной памяти (0 - строка
+                                    //     размещена внутри параметра)
+    unsigned            hash;       // Хеш строки (для интернированных строк)
+    unsigned            refs;       // Количество ссылок на интернированную
+                                    //     строку (0 - строка не интернирована)
     char                string[0];  // Сама строка
 } inistring_t;
 
+// Статистика загрузки (см. IniGetLoadStats). Время в секундах считается
+// только с IniSetLoadStats
+typedef struct {
+    ptrdiff_t           files;      // Количество файлов
+    ptrdiff_t           bytes;      // Прочитано байт
+    ptrdiff_t           lines;      // Количество строк
+    ptrdiff_t           tokens;     // Количество лексем
+    ptrdiff_t           sects;      // Количество заголовков секций
+    ptrdiff_t           params;     // Количество строк с параметрами
+    ptrdiff_t           comments;   // Количество комментариев
+    ptrdiff_t           includes;   // Количество директив #include
+    ptrdiff_t           depth;      // Глубина вложенности файла (0 у
+                                    //     загружаемого файла, в общей
+                                    //     статистике - наибольшая)
+    double              ioTime;     // Открытие, чтение и закрытие файлов
+    double              parseTime;  // Разбор строк целиком
+    double              scanTime;   // Разбор строк без аллокаций, проверок
+                                    //     повторов и поиска файлов (лексемы,
+                                    //     интернирование ключей, списки)
+    double              allocTime;  // Аллокации памяти при разборе строк
+    double              dupTime;    // Проверки повторных секций и
+                                    //     параметров (и слияние повторов
+                                    //     без проверки, см.
+                                    //     IniSetCheckForSections)
+    double              descrTime;  // Поиск уже включённых файлов
+                                    //     (IniFiledescrFind)
+} iniloadstats_t;
+
 typedef struct inidescr_s {
     struct inidescr_s*  next;       // Следующий описатель файла
     struct ini_s*       ini;        // Указатель на ini
     inistring_t*        filename;   // Название ini файла
     struct inisect_s*   gsect;      // Глобальная секция в файле
     struct inisect_s*   lastSect;   // Последняя секция в файле
+    inimemstats_t       mem;        // Память занятая данными файла
+    iniloadstats_t      load;       // Статистика загрузки файла
 } inidescr_t;
 
+// Аргументы сообщения хранятся в той же аллокации, что и сама диагностика
+typedef struct inidiag_s {
+    struct inidiag_s*   next;       // Следующая диагностика
+    int                 code;       // Код INI_DIAG_*
+    int                 severity;   // INI_DIAG_ERROR или INI_DIAG_WARNING
+    inidescr_t*         descr;      // Файл (или NULL, если файл не открылся)
+    int                 line;       // Строка в файле (0 - не относится к
+                                    //     строке)
+    int                 column;     // Столбец начала, с 1 (0 - неизвестен)
+    ptrdiff_t           begin;      // Начало участка строки в байтах
+    ptrdiff_t           end;        // Конец участка строки в байтах
+    const char*         arg;        // Первый аргумент сообщения (имя
+                                    //     файла, ключа и т.д.) или NULL
+    const char*         arg2;       // Второй аргумент сообщения или NULL
+} inidiag_t;
+
 typedef struct iniinh_s {
     struct iniinh_s*    next;       // Следующая унаследованная секция
+    struct iniinh_s*    prev;       // Предыдущая унаследованная секция
     struct inisect_s*   inhSect;    // Указатель на унаследованную секцию
                                     // Или на наследника
     struct inisect_s*   sect;       // Указатель секции к которой наследуется
+    struct iniinh_s*    twin;       // Парный элемент: для унаследованной
+                                    //     секции элемент в списке наследников
+                                    //     и наоборот
 } iniinh_t;
 
+// Значение и комментарий параметра размещаются в той же аллокации, что и
+// сам параметр
 typedef struct iniparam_s {
     struct iniparam_s*  next;       // Следующий параметр
+    struct iniparam_s*  prev;       // Предыдущий параметр
     struct inisect_s*   sect;       // Указатель на секцию
     inistring_t*        key;        // Ключ параметра
     inistring_t*        value;      // Значение параметра
     inistring_t*        comment;    // Комментарий идущий после параметра
 } iniparam_t;
 
+// Таблица всех параметров секции с учётом наследования (см. IniMaterializeSect)
+typedef struct {
+    ptrdiff_t           size;       // Размер таблицы (степень двойки)
+    ptrdiff_t           count;      // Количество параметров в таблице
+    iniparam_t*         params[0];  // Параметры по хешу ключа
+} inieffective_t;
+
+// Упорядоченный по ключам индекс секций или параметров секции (см.
+// IniFirstSectPrefix, IniFirstParamPrefix)
+typedef struct {
+    ptrdiff_t           size;       // Размер выделенного массива
+    ptrdiff_t           count;      // Количество элементов
+    void*               items[0];   // Секции или параметры по возрастанию
+                                    //     ключа (побайтовое сравнение)
+} iniindex_t;
+
+// Таблица минимального идеального хеширования (см. IniFreeze)
+typedef struct {
+    ptrdiff_t           size;       // Количество ключей и мест в таблице
+    ptrdiff_t           buckets;    // Количество корзин
+    unsigned*           seeds;      // Параметр хеша для каждой корзины
+    void*               items[0];   // Секции или параметры по местам
+} inimph_t;
+
+// Виды поиска в профиле (см. IniSetProfiling)
+#define INI_PROF_SECT       0       // IniFindSect, IniFindSectK
+#define INI_PROF_PARAM      1       // IniFindParam, IniFindParamK
+#define INI_PROF_READ       2       // IniRead*
+#define INI_PROF_BUCKETS    24      // Корзин гистограммы времени
+
+// Счётчики профиля для одного ключа (см. IniGetProfile)
+typedef struct {
+    int                 kind;       // Вид поиска INI_PROF_*
+    const char*         name;       // Название секции или ключ параметра
+    ptrdiff_t           length;     // Длинна названия
+    ptrdiff_t           calls;      // Количество вызовов
+    ptrdiff_t           hits;       // Найдено в самой секции (у IniRead* -
+                                    //     прочитано без ошибок)
+    ptrdiff_t           inheritedHits;// Найдено у предков
+    ptrdiff_t           misses;     // Не найдено (у IniRead* - ошибка)
+    ptrdiff_t           depth;      // Сумма просмотренных предков
+    ptrdiff_t           maxDepth;   // Больше всего предков за один поиск
+    ptrdiff_t           latency[INI_PROF_BUCKETS];// Вызовы по времени: в i-й
+                                    //     корзине от 2^i до 2^(i+1) нс, в
+                                    //     последней всё что дольше
+} iniprofentry_t;
+
+// Ключи параметров секции подряд в памяти: хеши ключей для сравнения по
+// несколько ключей за раз и параметры. Массив поддерживается у секций
+// начиная с нескольких параметров, у которых нет таблицы IniFreeze (таблица
+// заменяет массив, пока секция не изменится). После загрузки размер массива
+// равен числу параметров. Параметры идут в порядке списка секции, а в режиме
+// IniSetAdaptiveLookup - по убыванию числа обращений
+typedef struct {
+    ptrdiff_t           size;       // Размер выделенных массивов
+    ptrdiff_t           count;      // Количество параметров
+    ptrdiff_t           lookups;    // Поисков с последнего упорядочивания
+    unsigned*           hashes;     // Хеши ключей параметров
+    unsigned*           hits;       // Количество найденных обращений
+    iniparam_t*         params[0];  // Параметры
+} inikeys_t;
+
+// Все параметры с одним ключом (см. IniCollectKeyOwners)
+typedef struct {
+    inistring_t*        key;        // Ключ (NULL - свободный элемент)
+    ptrdiff_t           count;      // Количество параметров
+    ptrdiff_t           size;       // Размер массива параметров
+    iniparam_t**        params;     // Параметры в порядке добавления
+} iniposting_t;
+
 typedef struct inisect_s {
     struct inisect_s*   next;       // Следующая секция
+    struct inisect_s*   prev;       // Предыдущая секция
     struct inisect_s*   fnext;      // Следующая секция в этом файле
+    struct inisect_s*   fprev;      // Предыдущая секция в этом файле (у
+                                    //     первой секции файла это
+                                    //     глобальная секция)
     inistring_t*        key;        // Название секции
     inistring_t*        comment;    // Комментарий идущий после секции
     iniparam_t*         firstParam; // Первый параметр в секции
@@ -71,6 +265,25 @@ typedef struct inisect_s {
     iniinh_t*           heirs;      // Список секций прямых наследников
     iniinh_t*           heirsLast;  // Последний из списка прямых наследников
     inidescr_t*         filename;   // Файл в котором находится секция
+    inieffective_t*     effective;  // Таблица параметров с учётом
+                                    //     наследования (или NULL)
+    iniindex_t*         index;      // Параметры упорядоченные по ключу (или
+                                    //     NULL, строится при обращении)
+    ptrdiff_t           id;         // Номер секции (-1 у глобальных секций)
+    int                 line;       // Строка заголовка секции в файле (0 у
+                                    //     секций, добавленных не разбором)
+    size_t*             ancestors;  // Битовое множество номеров всех
+                                    //     предков (или NULL, строится при
+                                    //     обращении)
+    size_t*             descendants;// Битовое множество номеров всех
+                                    //     наследников (или NULL)
+    size_t*             bloomOwn;   // Фильтр Блума ключей секции (или NULL)
+    size_t*             bloomAll;   // Фильтр Блума ключей секции и всех
+                                    //     предков (или NULL)
+    inimph_t*           mph;        // Таблица ключей секции (или NULL, см.
+                                    //     IniFreeze)
+    inikeys_t*          keys;       // Массив ключей секции (или NULL у
+                                    //     небольших секций)
 } inisect_t;
 
 typedef struct ini_s {
@@ -81,6 +294,9 @@ typedef struct ini_s {
     ptrdiff_t           errbufSize; // Размер буфера
     ptrdiff_t           bufFill;    // Сколько байт из буфера заполнено
     int                 numOfErrors;// Количество ошибок
+    int                 numOfWarnings;// Количество предупреждений
+    inidiag_t*          firstDiag;  // Первая диагностика
+    inidiag_t*          lastDiag;   // Последняя диагностика
 
     unsigned            flags;      // Флаги 0x1 - флаг буфера (используется
                                     //     внутренними функциями)
@@ -90,8 +306,61 @@ typedef struct ini_s {
     inisect_t*          lastSect;   // Последняя секция в ini
     inidescr_t*         filenames;  // Дескрипторы всех ini файлов
     inidescr_t*         lastfname;  // Последний дескриптор файла
+    inistring_t**       atoms;      // Хеш таблица интернированных строк
+    ptrdiff_t           atomsSize;  // Размер таблицы
+    ptrdiff_t           numAtoms;   // Количество интернированных строк
+    char*               arena;      // Непрерывная память сжатого дерева
+    ptrdiff_t           arenaSize;  // Размер памяти сжатого дерева
+    inimemstats_t       mem;        // Вся занятая память
+    ptrdiff_t           numEffective;// Количество секций с таблицей
+                                    //     параметров (IniMaterializeSect)
+    iniindex_t*         sectIndex;  // Секции упорядоченные по названию (или
+                                    //     NULL, строится при обращении)
+    inisect_t**         sectTable;  // Хеш таблица секций по названию, для
+                                    //     каждого названия первая по
+                                    //     списку секция
+    ptrdiff_t           sectTableSize;// Размер таблицы (степень двойки)
+    ptrdiff_t           sectTableCount;// Количество названий в таблице
+    ptrdiff_t           numDupSects;// Количество повторных секций, ещё не
+                                    //     слитых с первой (см.
+                                    //     IniSetCheckForSections)
+    iniposting_t*       keyIndex;   // Параметры по ключам (или NULL,
+                                    //     строится при обращении)
+    ptrdiff_t           keyIndexSize;// Размер таблицы ключей
+    ptrdiff_t           keyIndexCount;// Количество ключей в таблице
+    inisect_t**         sectById;   // Секции по номерам (NULL - свободный
+                                    //     номер)
+    ptrdiff_t*          freeIds;    // Свободные номера секций
+    ptrdiff_t           numIds;     // Количество выданных номеров
+    ptrdiff_t           numFreeIds; // Количество свободных номеров
+    ptrdiff_t           idsSize;    // Размер таблицы номеров (и размер
+                                    //     битовых множеств в битах)
+    ptrdiff_t           numClosures;// Количество построенных множеств
+    ptrdiff_t           bloomBits;  // Размер фильтров Блума в битах (0 -
+                                    //     фильтры выключены)
+    inibloomstats_t     bloom;      // Статистика фильтров Блума
+    inimph_t*           sectMph;    // Таблица названий секций (или NULL, см.
+                                    //     IniFreeze)
+    ptrdiff_t           numMph;     // Количество построенных таблиц
+    struct iniprofthread_s* profThreads;// Счётчики профиля потоков (см.
+                                    //     IniSetProfiling)
+    unsigned            profId;     // Поколение профиля (0 - не включался)
+    iniloadstats_t      load;       // Статистика загрузки не относящаяся к
+                                    //     отдельным файлам
 } ini_t;
 
+// Заранее подготовленный ключ для поиска (см. IniFindK)
+typedef struct {
+    const char*         string;     // Строка ключа
+    ptrdiff_t           length;     // Длинна строки
+    unsigned            hash;       // Хеш строки (0 - ещё не посчитан)
+} inikey_t;
+
+// Ключ из строкового литерала, длинна считается при компиляции, а хеш при
+// первом поиске: static inikey_t health = INI_KEY( "health" );
+// Хеш записывается атомарно, один ключ можно искать из нескольких потоков
+#define INI_KEY(str)    { (str), sizeof(str) - 1, 0 }
+
 typedef struct {
     ini_t*              ini;        // Указатель на ini
     fnIniFilter         inifilter;  // Используемый callback фильтр
@@ -103,8 +372,26 @@ typedef struct {
     inistring_t*        string;     // ini-строка
     const char*         cstr;       // си строка
     ptrdiff_t           length;     // Длинна строки
+    iniindex_t*         index;      // Индекс (IniFirstSectPrefix и т.д.)
+    const char*         pattern;    // Шаблон (или NULL)
+    ptrdiff_t           pos;        // Текущая позиция в индексе
+    ptrdiff_t           end;        // Конец перебираемой части индекса
 } inihandler_t;
 
+// Настройки проверки файлов (IniValidate, IniValidateBatch), нулевые поля
+// означают значения по умолчанию
+typedef struct {
+    fnIniMalloc         inimalloc;  // Функция аллокации памяти (NULL -
+                                    //     malloc)
+    fnIniFree           inifree;    // Функция деаллокации памяти (NULL -
+                                    //     free)
+    fnIniDiag           diag;       // Вызывается для каждой диагностики
+                                    //     (или NULL)
+    void*               userData;   // Пользовательские данные для diag
+    int                 threads;    // Количество потоков IniValidateBatch
+                                    //     (0 - по числу процессоров)
+} inivalidate_t;
+
 
 
 void IniInit( ini_t* ini, fnIniMalloc malloc, fnIniFree free, fnIniMallocTag memtag, char* buf, ptrdiff_t size );
@@ -112,13 +399,24 @@ void IniInit( ini_t* ini, fnIniMalloc malloc, fnIniFree free, fnIniMallocTag mem
 // malloc - аллокатор памяти, вызывается во всех аллокациях памяти.
 // free - освобождение памяти выделенной функцией malloc
 // buf - указатель на буфер памяти, в который будут записываться ошибки
-// парсинга, а size указывает на размер этой памяти.
+// парсинга, а size указывает на размер этой памяти. Если buf равен NULL,
+// текст ошибок не форматируется, они доступны только через IniFirstDiag
 
 void IniFree( ini_t* ini );
 // Высвободить все ресурсы захваченные под ini структуру и вернуть всю память
 
 void IniClearErrors( ini_t* ini );
-// Очистить буфер ошибок
+// Очистить буфер ошибок и список диагностик
+
+inidiag_t* IniFirstDiag( ini_t* ini );
+// Получить первую диагностику последней загрузки или сохранения
+// Следующие перебираются через diag->next, ошибки считаются в numOfErrors,
+// предупреждения в numOfWarnings
+
+ptrdiff_t IniFormatDiag( const inidiag_t* diag, char* buf, ptrdiff_t size );
+// Записать текст диагностики в buf (как в буфере ошибок, с переводом строки)
+// Записывается не больше size - 1 символов и завершающий 0. Функция
+// возвращает длинну полного текста, buf может быть NULL при size равном 0
 
 
 
@@ -177,16 +475,70 @@ void IniSetCheckForSections( ini_t* ini, unsigned char flag );
 // Проверять существование секций с таким же именем перед добавлением
 // Изначально установлено в 1
 // Для того что бы не было проверки на существование секций нужно передать
-// в flag значение 0. Это может значительно ускоритьарсинг
+// в flag значение 0. Это может значительно ускорить парсинг: секции
+// добавляются без поиска, а повторные секции объединяются одним проходом в
+// конце IniLoad. Результат загрузки и набор диагностик такие же как с
+// проверкой, но предупреждения о повторных секциях (INI_DIAG_SECT_DEFINED) и
+// о повторных параметрах в них выводятся при объединении, то есть после
+// остальных диагностик IniLoad, и без позиции в строке (column, begin и end
+// равны 0)
 
 void IniSetCheckForParameters( ini_t* ini, unsigned char flag );
-// Проверять существование параметров с таким же именем перед добавлением вверху
+// Проверять существование параметров с таким же именем перед добавлением в
 // секцию
-// Изначально установлено в 1
-// Для выключения проверки существующих параметров нужно в flags передать 0
+// Изначально установлено в 0
+// Если проверка включена, то повторный параметр не добавляется (остаётся
+// первый, его же находит IniFindParam) и выводится предупреждение
 // Выключение проверки может ускорить парсинг
 
-
+void IniSetBloomFilters( ini_t* ini, ptrdiff_t bits );
+// Использовать фильтры Блума при поиске параметров. Изначально выключено (0)
+// bits - размер фильтра секции в битах (округляется вверх до степени двойки)
+// У секции два фильтра: фильтр своих ключей и общий фильтр ключей секции и
+// всех её предков. Фильтры строятся при первом поиске в секции, поэтому
+// IniFindParam и т.д. изменяют ini. Если ключа нет в общем фильтре, то
+// поиск сразу возвращает NULL, не просматривая параметры секции и предков
+// Ключи новых параметров сразу добавляются в фильтры, а удалённые ключи
+// остаются в фильтрах до следующего вызова IniSetBloomFilters. На 3 бита
+// ключа при 20 ключах на 256 бит приходится около 1% ложных срабатываний
+
+
+void IniSetAdaptiveLookup( ini_t* ini, unsigned char flag );
+// Упорядочивать ключи секций по частоте обращений. Изначально выключено (0)
+// Поиск считает найденные параметры, и время от времени ключи секции
+// переставляются по убыванию счётчиков, так что частые ключи проверяются
+// первыми. Счётчики при этом делятся пополам, чтобы порядок следовал за
+// изменением нагрузки. Переставляется только массив ключей поиска (см.
+// inikeys_t), порядок firstParam, печать и сохранение не меняются
+// В этом режиме IniFindParam и т.д. изменяют ini
+
+void IniSetProfiling( ini_t* ini, unsigned char flag );
+// Считать вызовы IniFindSect, IniFindParam (и их версий с inikey_t) и
+// IniRead*. Изначально выключено (0)
+// По каждому ключу считаются вызовы, попадания в секции и у предков,
+// промахи, количество просмотренных предков и гистограмма времени вызова
+// Каждый поток пишет в свои счётчики без блокировок, счётчики потоков
+// складываются только при вызове IniGetProfile. Память счётчиков берётся
+// функцией аллокации ini в том потоке, где идёт поиск, и не учитывается в
+// IniGetMemStats. Счётчики сохраняются при выключении до IniResetProfile
+
+void IniResetProfile( ini_t* ini );
+// Удалить счётчики профиля всех потоков
+// Нельзя вызывать одновременно с поиском в ini из других потоков
+
+ptrdiff_t IniGetProfile( ini_t* ini, iniprofentry_t* entries, ptrdiff_t max );
+// Сложить счётчики профиля всех потоков
+// entries - массив для max ключей с наибольшим количеством вызовов (по
+// убыванию), может быть NULL при max = 0
+// Функция возвращает количество всех ключей профиля
+// Счётчики других потоков читаются атомарно без блокировок и могут отставать
+// на несколько вызовов. name указывает в память профиля и действителен до
+// IniResetProfile или IniFree
+
+void IniPrintProfile( ini_t* ini, FILE* f, ptrdiff_t n );
+// Напечатать n ключей с наибольшим количеством вызовов: строка заголовка и
+// по строке на ключ, поля разделены табуляцией. Время p50 и p99 - верхние
+// границы корзин гистограммы в наносекундах
 
 void IniExcludeParam( iniparam_t* param );
 // Извлечь параметр param из секции и удалить его и все связанные с ним ссылки
@@ -202,6 +554,11 @@ void IniExcludeHeir( iniinh_t* inh );
 void IniExcludeSect( inisect_t* sect );
 // Извлечь секцию sect из списка секций, так же удаляет всех наследников
 
+int IniExcludeSects( ini_t* ini, fnIniFilter filter, void* userData );
+// Извлечь все секции, для которых filter (вызывается с inisect_t*) вернул
+// не 0, за один проход по списку секций
+// Функция возвращает количество удалённых секций
+
 
 
 inidescr_t* IniAppendDescr( ini_t* ini, const char* filename );
@@ -254,6 +611,73 @@ iniparam_t* IniFind( ini_t* ini, const char* sect, const char* param );
 // возвращает указатель на параметр, если удалось найти нужную секцию а в
 // секции удалось найти нужный параметр.
 
+inikey_t    IniKeyMake( const char* str );
+// Подготовить ключ для поиска: посчитать длинну и хеш строки str
+// Строка не копируется и должна существовать всё время использования ключа
+
+inisect_t*  IniFindSectK( ini_t* ini, inikey_t* key );
+iniparam_t* IniFindParamK( inisect_t* sect, inikey_t* key );
+iniparam_t* IniFindK( ini_t* ini, inikey_t* sect, inikey_t* param );
+// То же что IniFindSect, IniFindParam и IniFind, но с подготовленными ключами
+// (IniKeyMake или INI_KEY): без strlen и повторного подсчёта хеша. Хеш
+// ключа сравнивается до сравнения строк
+
+ptrdiff_t   IniFindBatch( ini_t* ini, inikey_t* sects, inikey_t* keys, iniparam_t** out, ptrdiff_t n );
+// Найти n параметров сразу: out[i] = IniFindK( ini, &sects[i], &keys[i] )
+// Запросы к одной секции обрабатываются вместе: секция ищется один раз, а
+// параметры секции и унаследованных секций просматриваются один раз для
+// всех ключей запросов. Функция возвращает количество найденных параметров
+
+ptrdiff_t   IniCollectKeyOwners( ini_t* ini, const char* key, inisect_t** sects, ptrdiff_t max );
+// Найти все секции, в которых есть параметр с ключом key (без учёта
+// наследования). В sects записывается не больше max секций, функция
+// возвращает количество всех найденных секций
+// Поиск идёт по индексу ключей: индекс строится при первом вызове, новые
+// параметры добавляются в него сразу, а удалённые сразу из него убираются.
+// Удаление параметра ключа, который есть больше чем в 64 секциях, удаляет
+// индекс, и он строится заново при следующем вызове
+
+ptrdiff_t   IniCollectAffected( inisect_t* sect, const char* key, inisect_t** sects, ptrdiff_t max );
+// Найти секции, на которые влияет параметр key секции sect: секцию sect и
+// всех её наследников (по всей глубине), для которых IniFindParam находит
+// параметр key в секции sect. Если в sect ещё нет параметра key, то
+// находятся секции, на которые повлияет его добавление. В sects
+// записывается не больше max секций, функция возвращает количество всех
+// найденных секций
+
+ptrdiff_t   IniCollectAncestors( inisect_t* sect, inisect_t** sects, ptrdiff_t max );
+// Найти всех предков секции: унаследованные секции, их унаследованные
+// секции и т.д. Сама секция попадает в результат только если она входит в
+// цикл наследования. Секции записываются в порядке номеров (sect->id), в
+// sects записывается не больше max секций, функция возвращает количество
+// всех найденных секций
+// Множество предков строится при первом вызове и хранится в секции. При
+// добавлении наследования (IniSectInherit) построенные множества
+// дополняются, а при удалении наследования (IniExcludeInherit и т.д.)
+// затронутые множества удаляются и строятся заново при следующем вызове
+
+ptrdiff_t   IniCollectDescendants( inisect_t* sect, inisect_t** sects, ptrdiff_t max );
+// Найти всех наследников секции по всей глубине (см. IniCollectAncestors)
+
+int         IniIsAncestor( inisect_t* sect, inisect_t* ancestor );
+// Проверить, наследуется ли секция sect от секции ancestor (напрямую или
+// через другие секции). Функция возвращает 1 или 0
+
+int         IniFreeze( ini_t* ini );
+// Построить таблицы минимального идеального хеширования (CHD) для названий
+// секций и для ключей каждой секции, в которой не меньше 8 разных ключей.
+// После этого поиск секции и своего параметра секции делает ровно одну
+// пробу в таблице без цепочек коллизий, а таблица занимает одно место на
+// ключ и 1 байт на ключ под параметры хеша
+// Вызывается после загрузки, когда набор секций и ключей больше не
+// меняется. Изменение списка секций или параметров секции удаляет
+// затронутую таблицу, дальше поиск идёт как без IniFreeze. IniCompact
+// строит таблицы заново. Функция возвращает 0 или -1, если какую-то таблицу
+// построить не удалось (такая секция ищется как без IniFreeze)
+
+void        IniUnfreeze( ini_t* ini );
+// Удалить таблицы построенные IniFreeze
+
 
 
 int IniSectInherit( inisect_t* sect, const char* name );
@@ -263,6 +687,20 @@ int IniSectInherit( inisect_t* sect, const char* name );
 // Фукнция возвращает -1 если не удалось найти секцию name.
 // В случае успеха фукнция возвращает 0
 
+void IniMaterializeSect( inisect_t* sect );
+// Построить таблицу всех параметров секции с учётом наследования
+// После этого IniFindParam находит параметр секции или любой из
+// унаследованных секций одним поиском в таблице. Таблицы строятся и для
+// всех унаследованных секций. Таблица удаляется при изменении секции, любой
+// из унаследованных секций или связей наследования и строится заново только
+// следующим вызовом IniMaterializeSect. IniCompact удаляет все таблицы
+
+void IniMaterializeAll( ini_t* ini );
+// Построить таблицы параметров для всех секций (см. IniMaterializeSect)
+
+void IniDematerializeAll( ini_t* ini );
+// Удалить все таблицы параметров и вернуть занятую ими память
+
 
 
 int IniLoad( ini_t* ini, const char* filename );
@@ -273,6 +711,32 @@ int IniLoad( ini_t* ini, const char* filename );
 // Для проверки на наличие ошибок при парсинге файлов нужно смотреть список
 // ошибок и количество ошибок парсинга
 
+int IniLoadMem( ini_t* ini, const char* filename, const char* data, ptrdiff_t size );
+// Загрузить ini из памяти: data - содержимое файла размером size байт
+// filename - имя файла, оно записывается в описатель файла (по нему же
+// сохраняет IniSave) и от него отсчитываются пути директив #include, сами
+// включённые файлы читаются с диска. Память data после вызова не нужна
+
+int IniValidate( const char* filename, const inivalidate_t* options );
+// Проверить ini-файл и включённые в него файлы без загрузки в ini
+// Разбор тот же, что и в IniLoad: синтаксис, директивы #include (в том числе
+// повторное включение) и наследование только от уже объявленных секций. В
+// памяти остаются только названия секций и описатели файлов, параметры,
+// значения и комментарии не создаются, поэтому повторные параметры не
+// проверяются, а о повторных секциях предупреждается всегда, как в обоих
+// режимах IniSetCheckForSections. Директива #print ничего не печатает. Каждая диагностика
+// передаётся в options->diag (file равен 0), описатель файла diag->descr
+// существует только во время вызова. options может быть NULL
+// Функция возвращает количество ошибок (предупреждения не считаются)
+
+ptrdiff_t IniValidateBatch( const char** filenames, ptrdiff_t n, int* results, const inivalidate_t* options );
+// Проверить n файлов filenames в нескольких потоках (см. IniValidate)
+// Каждый поток берёт следующий непроверенный файл. Количество ошибок файла i
+// записывается в results[i] (results может быть NULL). options->diag
+// вызывается из разных потоков, но не одновременно, и диагностики одного
+// файла идут подряд, file - номер файла в filenames
+// Функция возвращает количество файлов с ошибками
+
 int IniSaveToFile( ini_t* ini, const char* filename );
 // Сохранить всё ini содержимое в один файл с именем filename
 // Функция возвращает 0 если удалось успешно сохранить ini в один файл.
@@ -283,6 +747,38 @@ int IniSave( ini_t* ini );
 // Перезаписывает все ini-файлы которые были добавлены либо ранее распаршены.
 // Функция возвращает 0 в случае успеха либо -1 в случае ошибки
 
+void IniCompact( ini_t* ini );
+// Перенести всё дерево в одну непрерывную область памяти
+// Описатели файлов, секции, параметры и строки копируются в порядке обхода
+// (IniFirstSect, IniFirstParam), поэтому обход и поиск идут по памяти
+// последовательно. Все ранее полученные указатели на секции, параметры и
+// строки после вызова становятся недействительными. Память удалённых после
+// сжатия элементов возвращается только при следующем сжатии или в IniFree
+
+void IniGetMemStats( ini_t* ini, inidescr_t* descr, inimemstats_t* stats );
+// Получить статистику занятой памяти
+// Если descr равен NULL, то возвращается статистика всего ini, иначе только
+// память данных файла descr (описатель, секции, параметры, строки и его
+// часть сжатого дерева). Счётчики ведутся по тегам INI_MTAG_*, таблица
+// интернированных строк и буферы парсера учитываются только в общей
+// статистике
+
+void IniSetLoadStats( ini_t* ini, unsigned char flag );
+// Засекать время этапов загрузки для IniGetLoadStats. Изначально выключено
+// (0). Количества (байты, строки, лексемы и т.д.) считаются всегда, время -
+// только при включённом флаге, по два чтения часов на строку, аллокацию и
+// проверку повтора
+
+void IniGetLoadStats( ini_t* ini, inidescr_t* descr, iniloadstats_t* stats );
+// Получить статистику загрузки
+// Если descr равен NULL, то возвращается сумма по всем файлам (глубина -
+// наибольшая) вместе со слиянием повторных секций, иначе только файл descr
+// Статистика накапливается всеми вызовами IniLoad
+
+void IniGetBloomStats( ini_t* ini, inibloomstats_t* stats );
+// Получить статистику фильтров Блума (см. IniSetBloomFilters)
+// Статистика обнуляется вызовом IniSetBloomFilters
+
 
 
 /* Общее для inihandler_t*: (перебор данных)
@@ -377,6 +873,44 @@ void* IniNextInherit( void* h );
 void* IniFirstHeir( inihandler_t* handler, inisect_t* sect, fnIniFilter filter, void* userData );
 void* IniNextHeir( void* h );
 
+/* IniFirstSectPrefix IniFirstSectGlob IniNextSectMatch
+  Обход секций, названия которых начинаются с prefix или подходят под
+шаблон pattern ('*' - любое количество любых символов, '?' - один любой
+символ). Секции перебираются по возрастанию названия (побайтовое сравнение)
+  Поиск идёт по упорядоченному индексу секций, который строится при первом
+вызове после изменения списка секций, поэтому время обхода зависит от
+количества подходящих секций, а не от количества всех секций. Для шаблона
+просматриваются секции, названия которых начинаются с части шаблона до
+первого '*' или '?'. Во время обхода нельзя добавлять и удалять секции
+
+Результат выполнения IniFirstSectPrefix, IniFirstSectGlob и IniNextSectMatch:
+    handler->sect - указатель на секцию
+    handler->string - ini-строка, название секции (key)
+    handler->cstr - константный указатель на си строку (key)
+    handler->length - длинна строки (key)
+*/
+void* IniFirstSectPrefix( inihandler_t* handler, ini_t* ini, const char* prefix, fnIniFilter filter, void* userData );
+void* IniFirstSectGlob( inihandler_t* handler, ini_t* ini, const char* pattern, fnIniFilter filter, void* userData );
+void* IniNextSectMatch( void* h );
+
+/* IniFirstParamPrefix IniFirstParamGlob IniNextParamMatch
+  Обход параметров секции, ключи которых начинаются с prefix или подходят
+под шаблон pattern (см. IniFirstSectGlob). Параметры перебираются по
+возрастанию ключа, параметры с одинаковыми ключами в порядке следования в
+секции. Унаследованные параметры не перебираются. Во время обхода нельзя
+добавлять и удалять параметры секции
+
+Результат выполнения IniFirstParamPrefix, IniFirstParamGlob и IniNextParamMatch:
+    handler->sect - указатель на секцию
+    handler->param - указатель на параметр
+    handler->string - ini-строка, ключ параметра (key)
+    handler->cstr - константный указатель на си строку (key)
+    handler->length - длинна строки (key)
+*/
+void* IniFirstParamPrefix( inihandler_t* handler, inisect_t* sect, const char* prefix, fnIniFilter filter, void* userData );
+void* IniFirstParamGlob( inihandler_t* handler, inisect_t* sect, const char* pattern, fnIniFilter filter, void* userData );
+void* IniNextParamMatch( void* h );
+
 
 
 /* Общее для функций чтения (IniRead):
@@ -417,7 +951,8 @@ int IniReadBoolv( iniparam_t* param, unsigned char* b, ptrdiff_t n );
 // Читать последовательность из n логических значений, разделённых запятыми
 
 int IniReadString( iniparam_t* param, char* s );
-// Читать строку. Содержимое value копируется полностью в s, только в том
+// Читать строку. s должен вмещать длинну значения и завершающий 0
+// Содержимое value копируется полностью в s, только в том
 // случае если начало строки не начинается на ' или ". Если же строка
 // начинается на ковычки, или двойные ковычки, то содержимое в этих ковычках
 // будет обработано соответствующим образом, а так же будут обработаны все
@@ -1,6 +1,12 @@
 // This is an independent project of an individual developer. Dear PVS-Studio, please check it.
 // PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
 
+// clock_gettime, pthreads and sysconf are POSIX, strict C modes (-std=c99)
+// do not declare them without this macro
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+    #define _POSIX_C_SOURCE 200112L
+#endif
+
 #include <ini.h>
 
 #include <assert.h>
@@ -9,6 +15,7 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <stddef.h>
 
 #ifdef ININO_DEBUG
     #define iniassert(expr)
@@ -34,6 +41,88 @@
 #define INI_FLAG_CHECK_FOR_SECT         INI_BIT(16)
 #define INI_FLAG_CHECK_FOR_PARAM        INI_BIT(17)
 #define INI_FLAG_PRINT_HEIRS            INI_BIT(18)
+#define INI_FLAG_ADAPTIVE_LOOKUP        INI_BIT(19)
+#define INI_FLAG_PROFILE                INI_BIT(20)
+#define INI_FLAG_LOAD_STATS             INI_BIT(21)
+#define INI_FLAG_PARSING_LINE           INI_BIT(22)
+#define INI_FLAG_VALIDATE               INI_BIT(23)
+
+#define INI_PARSER_OPEN_FILES           16
+#define INI_BATCH_SIZE                  128
+#define INI_BATCH_DEPTH                 64
+#define INI_WORD_BITS                   ((ptrdiff_t)sizeof(size_t) * 8)
+#define INI_MPH_BUCKET                  4
+#define INI_MPH_MIN_PARAMS              8
+#define INI_MPH_MAX_SEED                0x1000000
+#define INI_MPH_DIRECT                  0x80000000u
+#define INI_KEYS_MIN_PARAMS             4
+#define INI_KEYS_REORDER_PERIOD         64
+#define INI_KEYINDEX_REMOVE_MAX         64
+#define INI_PROF_SLOTS                  4
+#define INI_PROF_MIN_TABLE              64
+
+#define INI_PROF_MISS                   0
+#define INI_PROF_HIT                    1
+#define INI_PROF_INHERITED              2
+
+#if defined(__GNUC__)
+    #define INI_PREFETCH(addr)          __builtin_prefetch(addr)
+#else
+    #define INI_PREFETCH(addr)
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define INI_SSE2
+#endif
+
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    #define INI_LOCK_T                  CRITICAL_SECTION
+    #define INI_LOCK_INIT(l)            InitializeCriticalSection(l)
+    #define INI_LOCK_FREE(l)            DeleteCriticalSection(l)
+    #define INI_LOCK(l)                 EnterCriticalSection(l)
+    #define INI_UNLOCK(l)               LeaveCriticalSection(l)
+#else
+    #include <time.h>
+    #include <unistd.h>
+    #include <pthread.h>
+    #define INI_LOCK_T                  pthread_mutex_t
+    #define INI_LOCK_INIT(l)            pthread_mutex_init((l),NULL)
+    #define INI_LOCK_FREE(l)            pthread_mutex_destroy(l)
+    #define INI_LOCK(l)                 pthread_mutex_lock(l)
+    #define INI_UNLOCK(l)               pthread_mutex_unlock(l)
+#endif
+
+#if defined(_MSC_VER)
+    #define INI_THREAD_LOCAL            __declspec(thread)
+    #define INI_ATOMIC_INC(p)           InterlockedIncrement((volatile LONG*)(p))
+    #define INI_ATOMIC_CAS(p,old,new)   (InterlockedCompareExchangePointer( \
+                                            (PVOID volatile*)(p),(new),(old))==(old))
+    #define INI_ATOMIC_LOAD(p)          (*(p))
+    #define INI_ATOMIC_STORE(p,v)       (*(p)=(v))
+    #define INI_ATOMIC_ACQUIRE(p)       InterlockedCompareExchangePointer( \
+                                            (PVOID volatile*)(p),NULL,NULL)
+    #define INI_ATOMIC_RELEASE(p,v)     InterlockedExchangePointer((PVOID volatile*)(p),(v))
+#elif defined(__GNUC__)
+    #define INI_THREAD_LOCAL            __thread
+    #define INI_ATOMIC_INC(p)           __sync_add_and_fetch((p),1)
+    #define INI_ATOMIC_CAS(p,old,new)   __sync_bool_compare_and_swap((p),(old),(new))
+    #define INI_ATOMIC_LOAD(p)          __atomic_load_n((p),__ATOMIC_RELAXED)
+    #define INI_ATOMIC_STORE(p,v)       __atomic_store_n((p),(v),__ATOMIC_RELAXED)
+    #define INI_ATOMIC_ACQUIRE(p)       __atomic_load_n((p),__ATOMIC_ACQUIRE)
+    #define INI_ATOMIC_RELEASE(p,v)     __atomic_store_n((p),(v),__ATOMIC_RELEASE)
+#else
+    #define INI_NO_ATOMICS
+    #define INI_THREAD_LOCAL
+    #define INI_ATOMIC_INC(p)           (++*(p))
+    #define INI_ATOMIC_CAS(p,old,new)   (*(p)==(old)?(*(p)=(new),1):0)
+    #define INI_ATOMIC_LOAD(p)          (*(p))
+    #define INI_ATOMIC_STORE(p,v)       (*(p)=(v))
+    #define INI_ATOMIC_ACQUIRE(p)       (*(p))
+    #define INI_ATOMIC_RELEASE(p,v)     (*(p)=(v))
+#endif
 
 
 
@@ -42,15 +131,117 @@ typedef struct {
     ptrdiff_t       length;
 } inikeyword_t;
 
+typedef struct {
+    int             severity;   // INI_DIAG_ERROR or INI_DIAG_WARNING
+    const char*     message;    // Message text, '%s' are the arguments
+} inidiaginfo_t;
+
 typedef struct {
     char*       begin;
     char*       forward;
     ptrdiff_t   length;
     int         token;
+    ptrdiff_t   count;      // Number of the scanned tokens (line ends too)
+    ptrdiff_t   comments;   // Number of the scanned comments
 } iniscan_t;
 
+typedef struct {
+    FILE*           file;       // Opened file (NULL if suspended or if the
+                                // file is in memory)
+    long            offset;     // Read position of the suspended file
+    const char*     mem;        // Contents of the file loaded from memory
+                                // (or NULL)
+    ptrdiff_t       memSize;    // Size of the contents
+    ptrdiff_t       memPos;     // Read position in the contents
+    inidescr_t*     descr;      // File descriptor
+    inisect_t*      sect;       // Current section in the file
+    inistring_t*    sectKey;    // Name of the current section in the
+                                // validate mode (NULL - global section)
+    int             line;       // Current line in the file
+} iniframe_t;
+
+typedef struct {
+    ini_t*          ini;        // Pointer to ini
+    void**          items;      // Open addressing table of pointers
+    ptrdiff_t       size;       // Size of the table (power of two)
+    ptrdiff_t       count;      // Number of pointers in the table
+} iniptrset_t;
+
+typedef struct {
+    iniparam_t*     param;      // Parameter of a duplicate section
+    int             line;       // Line of the parameter
+} iniparamline_t;
+
+typedef struct {
+    ini_t*          ini;        // Pointer to ini
+    iniparamline_t* items;      // Open addressing table (or NULL)
+    ptrdiff_t       size;       // Size of the table (power of two)
+    ptrdiff_t       count;      // Number of the parameters
+} iniparamlines_t;
+
+typedef struct {
+    ini_t*          ini;        // Pointer to ini
+    iniframe_t*     frames;     // Stack of the opened files
+    ptrdiff_t       depth;      // Number of the opened files
+    ptrdiff_t       maxDepth;   // Size of the stack
+    char*           buf;        // Line buffer (shared by all files, grows
+                                // up to the longest line)
+    ptrdiff_t       bufSize;    // Size of the line buffer
+    char*           path;       // Path to the included file
+    ptrdiff_t       pathSize;   // Size of the path buffer
+    int             include;    // Include path is ready for opening
+    iniscan_t       scan;       // Scanner of the current line
+    iniptrset_t     sects;      // Names of the sections in the validate
+                                // mode (interned strings)
+    iniparamlines_t* lines;     // Lines of the parameters of duplicate
+                                // sections (or NULL)
+} iniparser_t;
+
+typedef struct iniproftable_s {
+    struct iniproftable_s* retired;// Previous smaller table (kept until the
+                                // profile is reset, other threads may read it)
+    ptrdiff_t       size;       // Size of the table (power of two)
+    ptrdiff_t       count;      // Number of the entries
+    iniprofentry_t* items[0];   // Open addressing table of the entries
+} iniproftable_t;
+
+typedef struct iniprofthread_s {
+    struct iniprofthread_s* next;// Next thread of the ini
+    iniproftable_t* table;      // Entries of the thread
+} iniprofthread_t;
+
+typedef struct {
+    ini_t*          ini;        // Profiled ini
+    unsigned        id;         // Profile generation of the ini
+    iniprofthread_t* rec;       // Counters of the current thread
+} iniprofslot_t;
+
+typedef struct {
+    const char**    filenames;  // Files to validate
+    ptrdiff_t       count;      // Number of the files
+    int*            results;    // Errors of each file (or NULL)
+    const inivalidate_t* options;// Validation options
+    long            next;       // Number of the files taken by the threads
+    long            failed;     // Number of the files with errors
+    INI_LOCK_T      lock;       // Serializes the diagnostic callbacks
+} inivalidbatch_t;
+
+typedef struct {
+    inisect_t*      sect;       // Section with the key
+    iniptrset_t     owners;     // Sections defining the key
+    iniptrset_t     heirs;      // Visited heirs
+    iniptrset_t     path;       // Sections visited by IniAffectedOwner
+    inisect_t**     sects;      // Result
+    ptrdiff_t       max;        // Size of the result
+    ptrdiff_t       count;      // Number of the affected sections
+} iniaffected_t;
+
 
 
+static unsigned iniProfGeneration;
+static INI_THREAD_LOCAL iniprofslot_t iniProfSlots[INI_PROF_SLOTS];
+static INI_THREAD_LOCAL unsigned iniProfNextSlot;
+
 const inikeyword_t inikeywords[] = {
     { "include", 7 },
     { "print", 5 },
@@ -59,1975 +250,7016 @@ const inikeyword_t inikeywords[] = {
     { NULL, 0 }
 };
 
+const inidiaginfo_t inidiaginfo[INI_DIAG_COUNT] = {
+    { INI_DIAG_ERROR, "" },
+    { INI_DIAG_ERROR, "can not open file '%s'" },
+    { INI_DIAG_ERROR, "error reading file '%s'" },
+    { INI_DIAG_ERROR, "can not reopen file '%s'" },
+    { INI_DIAG_ERROR, "can not open file for saving '%s'" },
+    { INI_DIAG_ERROR, "section start expected" },
+    { INI_DIAG_ERROR, "expected ']'" },
+    { INI_DIAG_ERROR, "can not find section for inherit '%s'" },
+    { INI_DIAG_ERROR, "expected included file name" },
+    { INI_DIAG_ERROR, "expected printing value" },
+    { INI_DIAG_ERROR, "uncnown directive '%s'" },
+    { INI_DIAG_ERROR, "uncnown token '%s'" },
+    { INI_DIAG_WARNING, "parameter '%s' is already defined in section '%s'" },
+    { INI_DIAG_WARNING, "file '%s' is already included" },
+    { INI_DIAG_WARNING, "section '%s' is already defined" }
+};
+
 
 
 /*
 ================
-IniStringCreate
+IniMemCount
+
+  Учесть аллокацию (size > 0) или освобождение (size < 0) памяти с тегом tag
 ================
 */
-static inistring_t* IniStringCreate( ini_t* ini, const char* str, ptrdiff_t len ) {
-    inistring_t* s;
-    
-    iniassert( ini );
+static void IniMemCount( inimemstats_t* stats, unsigned tag, ptrdiff_t size ) {
+    inimemcount_t* c[2];
+    int i;
     
-    if( !str || len == 0 ) {
-        return NULL;
-    }
-    if( len < 0 ) {
-        len = strlen(str);
+    iniassert( stats );
+    iniassert( tag < INI_MTAG_COUNT );
+    
+    c[0] = stats->tags + tag;
+    c[1] = &stats->total;
+    for( i = 0; i < 2; i++ ) {
+        c[i]->curBytes += size;
+        if( size > 0 ) {
+            c[i]->allocs++;
+            if( c[i]->curBytes > c[i]->peakBytes ) {
+                c[i]->peakBytes = c[i]->curBytes;
+            }
+        } else {
+            c[i]->frees++;
+        }
     }
-    
-    inicalldbg( ini->inimemtag, INI_MTAG_STRING );
-    s = (inistring_t*)ini->inimalloc( sizeof(inistring_t) + len + 1 );
-    s->size = len + 1;
-    s->length = len;
-    strncpy( s->string, str, len );
-    s->string[len] = 0;
-    return s;
 }
 
 /*
 ================
-IniInheritCreate
+IniProfNow
+
+  Время в наносекундах от произвольного момента (разность двух значений
+верна и при переполнении)
 ================
 */
-static iniinh_t* IniInheritCreate( ini_t* ini, inisect_t* sect ) {
-    iniinh_t* inh;
-    
-    iniassert( ini );
-    iniassert( sect );
+static size_t IniProfNow( void ) {
+#if defined(_WIN32)
+    LARGE_INTEGER count;
+    LARGE_INTEGER freq;
+    
+    QueryPerformanceCounter( &count );
+    QueryPerformanceFrequency( &freq );
+    return (size_t)((double)count.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+    struct timespec ts;
     
-    inicalldbg( ini->inimemtag, INI_MTAG_INHERIT );
-    inh = (iniinh_t*)ini->inimalloc( sizeof(iniinh_t) );
-    inh->next = NULL;
-    inh->inhSect = sect;
-    inh->sect = NULL;
-    return inh;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (size_t)ts.tv_sec * 1000000000u + (size_t)ts.tv_nsec;
+#endif
 }
 
 /*
 ================
-IniHeirCreate
+IniLoadClock
+
+  Начало замера времени загрузки (0 без IniSetLoadStats)
 ================
 */
-static iniinh_t* IniHeirCreate( ini_t* ini, inisect_t* sect ) {
-    iniinh_t* inh;
-    
-    iniassert( ini );
-    iniassert( sect );
-    
-    inicalldbg( ini->inimemtag, INI_MTAG_HEIR );
-    inh = (iniinh_t*)ini->inimalloc( sizeof(iniinh_t) );
-    inh->next = NULL;
-    inh->inhSect = sect;
-    inh->sect = NULL;
-    return inh;
+static size_t IniLoadClock( ini_t* ini ) {
+    return (ini->flags & INI_FLAG_LOAD_STATS) ? IniProfNow() : 0;
 }
 
 /*
 ================
-IniParamCreate
+IniLoadTime
+
+  Прибавить к time время прошедшее от start
 ================
 */
-static iniparam_t* IniParamCreate( ini_t* ini, inistring_t* key, inistring_t* value, inistring_t* comment ) {
-    iniparam_t* p;
-    
-    iniassert( ini );
-    
-    inicalldbg( ini->inimemtag, INI_MTAG_PARAM );
-    p = (iniparam_t*)ini->inimalloc( sizeof(iniparam_t) );
-    p->next = NULL;
-    p->sect = NULL;
-    p->key = key;
-    p->value = value;
-    p->comment = comment;
-    return p;
+static void IniLoadTime( ini_t* ini, double* time, size_t start ) {
+    if( ini->flags & INI_FLAG_LOAD_STATS ) {
+        *time += (double)(IniProfNow() - start) * 1e-9;
+    }
 }
 
 /*
 ================
-IniSectCreate
+IniMalloc
+
+  Выделить память с тегом tag. Память учитывается в статистике ini и в
+статистике файлового описателя descr (если он указан)
 ================
 */
-static inisect_t* IniSectCreate( ini_t* ini, inistring_t* key, inistring_t* comment ) {
-    inisect_t* s;
+static void* IniMalloc( ini_t* ini, inidescr_t* descr, unsigned tag, ptrdiff_t size ) {
+    void* mem;
+    size_t start;
     
     iniassert( ini );
-    iniassert( key );
+    iniassert( size > 0 );
     
-    if( (s = IniFindSect( ini, key->string )) != NULL ) {
-        printf( "already append sect: %s\n", key->string );
-        return s;
+    inicalldbg( ini->inimemtag, tag );
+    IniMemCount( &ini->mem, tag, size );
+    if( !descr ) {
+        return ini->inimalloc( size );
     }
-    
-    inicalldbg( ini->inimemtag, INI_MTAG_SECT );
-    s = (inisect_t*)ini->inimalloc( sizeof(inisect_t) );
-    s->next = NULL;
-    s->fnext = NULL;
-    s->key = key;
-    s->comment = comment;
-    s->firstParam = NULL;
-    s->lastParam = NULL;
-    s->inherit = NULL;
-    s->inheritLast = NULL;
-    s->heirs = NULL;
-    s->heirsLast = NULL;
-    s->filename = NULL;
-    return s;
+    IniMemCount( &descr->mem, tag, size );
+    // Only allocations of the line parsing are timed, they are part of its
+    // time (see IniGetLoadStats)
+    if( !(ini->flags & INI_FLAG_PARSING_LINE) ) {
+        return ini->inimalloc( size );
+    }
+    start = IniLoadClock( ini );
+    mem = ini->inimalloc( size );
+    IniLoadTime( ini, &descr->load.allocTime, start );
+    return mem;
 }
 
 /*
 ================
-IniDescrCreate
+IniMfree
+
+  Освободить память размером size выделенную IniMalloc. Память сжатого
+дерева (см. IniCompact) освобождается целиком, отдельные узлы в ней не
+освобождаются.
 ================
 */
-static inidescr_t* IniDescrCreate( ini_t* ini, const char* filename, ptrdiff_t len ) {
-    inidescr_t* d;
-    
+static void IniMfree( ini_t* ini, inidescr_t* descr, unsigned tag, void* ptr, ptrdiff_t size ) {
     iniassert( ini );
-    iniassert( filename );
     
-    inicalldbg( ini->inimemtag, INI_MTAG_DESCR );
-    d = (inidescr_t*)ini->inimalloc( sizeof(inidescr_t) );
-    d->next = NULL;
-    d->ini = ini;
-    d->filename = IniStringCreate( ini, filename, len );
-    d->gsect = IniSectCreate( ini,
-        IniStringCreate( ini, "_g", -1 ),
-        NULL
-    );
-    d->lastSect = d->gsect;
-    d->gsect->filename = d;
-    return d;
+    if( (char*)ptr >= ini->arena && (char*)ptr < ini->arena + ini->arenaSize ) {
+        return;
+    }
+    IniMemCount( &ini->mem, tag, -size );
+    if( descr ) {
+        IniMemCount( &descr->mem, tag, -size );
+    }
+    ini->inifree( ptr );
 }
 
 /*
 ================
-IniAppendDescr_s
+IniMemMove
+
+  Перенести учёт памяти с тегом tag из статистики файла from в статистику
+файла to
 ================
 */
-static void IniAppendDescr_s( ini_t* ini, inidescr_t* descr ) {
-    iniassert( ini );
-    iniassert( descr );
-    iniassert( !(ini->filenames) == !(ini->lastfname) );
-    
-    if( ini->filenames ) {
-        ini->lastfname->next = descr;
-        ini->lastfname = descr;
-    } else {
-        ini->filenames = descr;
-        ini->lastfname = descr;
+static void IniMemMove( inidescr_t* from, inidescr_t* to, unsigned tag, ptrdiff_t size ) {
+    if( from != to && size ) {
+        IniMemCount( &from->mem, tag, -size );
+        IniMemCount( &to->mem, tag, size );
     }
 }
 
 /*
 ================
-IniAppendSect_s
+IniStringCreate
 ================
 */
-static void IniAppendSect_s( inidescr_t* descr, inisect_t* sect ) {
-    ini_t* ini;
+static inistring_t* IniStringCreate( ini_t* ini, inidescr_t* descr, const char* str, ptrdiff_t len ) {
+    inistring_t* s;
     
-    iniassert( descr );
-    iniassert( sect );
-    iniassert( descr->ini );
-    //iniassert( !sect->filename );
+    iniassert( ini );
     
-    if( sect->filename ) {
-        return;
+    if( !str || len == 0 ) {
+        return NULL;
     }
-    
-    ini = descr->ini;
-    if( ini->firstSect ) {
-        ini->lastSect->next = sect;
-        ini->lastSect = sect;
-    } else {
-        ini->firstSect = sect;
-        ini->lastSect = sect;
+    if( len < 0 ) {
+        len = strlen(str);
     }
-    descr->lastSect->fnext = sect;
-    descr->lastSect = sect;
-    sect->filename = descr;
+    
+    s = (inistring_t*)IniMalloc( ini, descr, INI_MTAG_STRING, 
+        sizeof(inistring_t) + len + 1 );
+    s->size = len + 1;
+    s->length = len;
+    s->hash = 0;
+    s->refs = 0;
+    strncpy( s->string, str, len );
+    s->string[len] = 0;
+    return s;
 }
 
 /*
 ================
-IniAppendParam_s
+IniHash
+
+FNV-1a хеш строки
 ================
 */
-static void IniAppendParam_s( inisect_t* sect, iniparam_t* param ) {
-    iniassert( sect );
-    iniassert( param );
-    iniassert( !(sect->firstParam) == !(sect->lastParam) );
-    
-    param->sect = sect;
-    if( sect->firstParam ) {
-        sect->lastParam->next = param;
-        sect->lastParam = param;
-    } else {
-        sect->firstParam = param;
-        sect->lastParam = param;
+static unsigned IniHash( const char* str, ptrdiff_t len ) {
+    unsigned h = 2166136261u;
+    ptrdiff_t i;
+    for( i = 0; i < len; i++ ) {
+        h = (h ^ (unsigned char)str[i]) * 16777619u;
     }
+    return h;
 }
 
 /*
 ================
-IniFindOnlyInSect
+IniHash2
+
+  Второй хеш строки, независимый от IniHash. Вместе они дают 64 бита для
+таблиц идеального хеширования
 ================
 */
-static iniparam_t* IniFindOnlyInSect( inisect_t* sect, const char* key, ptrdiff_t len ) {
-    iniparam_t* p;
-    
-    iniassert( sect );
-    
-    p = sect->firstParam;
-    while( p ) {
-        if( len == p->key->length && !strncmp(key, p->key->string, len) ) {
-            return p;
-        }
-        p = p->next;
+static unsigned IniHash2( const char* str, ptrdiff_t len ) {
+    unsigned h = 0x9747b28cu;
+    ptrdiff_t i;
+    for( i = 0; i < len; i++ ) {
+        h = (h ^ (unsigned char)str[i]) * 0x5bd1e995u;
+        h ^= h >> 15;
     }
-    return NULL;
+    h ^= h >> 13;
+    h *= 0x5bd1e995u;
+    return h ^ (h >> 15);
 }
 
 /*
 ================
-IniFindInInherit
+IniMphSlot
+
+  Место ключа с хешами h1 и h2 в таблице идеального хеширования
 ================
 */
-static iniparam_t* IniFindInInherit( inisect_t* sect, const char* key, ptrdiff_t length ) {
-    iniinh_t* inh;
-    iniparam_t* p;;
-    
-    iniassert( sect );
+static unsigned IniMphMix( unsigned h1, unsigned h2, unsigned seed ) {
+    unsigned h;
+    
+    h = h1 ^ (h2 * 0x9e3779b1u + seed * 0x85ebca6bu);
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    return h ^ (h >> 16);
+}
+
+static ptrdiff_t IniMphSlot( const inimph_t* mph, unsigned h1, unsigned h2 ) {
+    unsigned seed;
     
-    inh = sect->inherit;
-    while( inh ) {
-        p = IniFindOnlyInSect( inh->inhSect, key, length );
-        if( p ) {
-            return p;
-        }
-        p = IniFindInInherit( inh->inhSect, key, length );
-        if( p ) {
-            return p;
-        }
-        inh = inh->next;
+    seed = mph->seeds[h2 % (unsigned)mph->buckets];
+    if( seed & INI_MPH_DIRECT ) {
+        return seed & ~INI_MPH_DIRECT;
     }
-    
-    return NULL;
+    return IniMphMix( h1, h2, seed ) % (unsigned)mph->size;
 }
 
 /*
 ================
-IniFiledescrFind
+IniAtomFind
+
+  Найти интернированную строку str длинной len с хешем hash. Функция
+возвращает NULL если такой строки нет ни в одной секции и ни в одном ключе
 ================
 */
-static inidescr_t* IniFiledescrFind( ini_t* ini, const char* filename, ptrdiff_t len ) {
-    inidescr_t* it;
-    const char* s1;
-    const char* s2;
+static inistring_t* IniAtomFind( ini_t* ini, const char* str, ptrdiff_t len, unsigned hash ) {
+    inistring_t* a;
+    ptrdiff_t mask;
+    ptrdiff_t i;
     
     iniassert( ini );
-    iniassert( filename );
+    iniassert( str );
     
-    if( len < 0 ) {
-        len = strlen( filename );
+    if( !ini->atoms ) {
+        return NULL;
     }
-    
-    it = ini->filenames;
-    while( it ) {
-        if( it->filename->length == len ) {
-            s1 = filename;
-            s2 = it->filename->string;
-            while( *s1 ) {
-                if( !(((*s1 == '\\' || *s1 == '/') && 
-                    (*s2 == '\\' || *s2 == '/')) || 
-                    (tolower(*s1) == tolower(*s2))) ) {
-                    break;
-                }
-                s1++;
-                s2++;
-            }
-            if( *s1 == 0 ) {
-                return it;
-            }
+    mask = ini->atomsSize - 1;
+    i = hash & mask;
+    while( (a = ini->atoms[i]) != NULL ) {
+        if( a->hash == hash && a->length == len && 
+            !memcmp( a->string, str, len ) ) {
+            return a;
         }
-        it = it->next;
+        i = (i + 1) & mask;
     }
-    
     return NULL;
 }
 
 /*
 ================
-IniPrint
+IniAtomsGrow
 ================
 */
-static void IniPrint( ini_t* ini, const char* fmt, ... ) {
-    va_list args;
+static void IniAtomsGrow( ini_t* ini ) {
+    inistring_t** old;
+    ptrdiff_t oldSize;
+    ptrdiff_t mask;
+    ptrdiff_t i;
+    ptrdiff_t j;
     
-    if( ini->errbuf ) {
-        va_start( args, fmt );
-        if( (ini->errbufSize - ini->bufFill) > 128 ) {
-            ini->bufFill += vsprintf( ini->errbuf + ini->bufFill, fmt, args );
-        } else if( (ini->flags & 0x1) == 0 && (ini->errbufSize - ini->bufFill) > 6 ) {
-            ini->bufFill += vsprintf( ini->errbuf + ini->bufFill, "...\n", args );
-            ini->flags |= 0x1;
+    iniassert( ini );
+    
+    old = ini->atoms;
+    oldSize = ini->atomsSize;
+    ini->atomsSize = oldSize ? oldSize * 2 : 64;
+    mask = ini->atomsSize - 1;
+    
+    ini->atoms = (inistring_t**)IniMalloc( ini, NULL, INI_MTAG_ATOMS,
+        ini->atomsSize * sizeof(inistring_t*) );
+    memset( ini->atoms, 0, ini->atomsSize * sizeof(inistring_t*) );
+    
+    for( i = 0; i < oldSize; i++ ) {
+        if( old[i] ) {
+            j = old[i]->hash & mask;
+            while( ini->atoms[j] ) {
+                j = (j + 1) & mask;
+            }
+            ini->atoms[j] = old[i];
         }
-        va_end( args );
     }
-    ini->numOfErrors++;
+    if( old ) {
+        IniMfree( ini, NULL, INI_MTAG_ATOMS, old, 
+            oldSize * sizeof(inistring_t*) );
+    }
 }
 
 /*
 ================
-IniSectIsInheriteded
+IniAtomCreate
 
-Возвращает 1 если inh есть в списке наследованных секций иначе возвращает 0
+  Вернуть интернированную строку str. Если такая строка уже есть, то 
+увеличивается её счётчик ссылок, иначе строка создаётся.
 ================
 */
-static int IniSectIsInheriteded( inisect_t* sect, iniinh_t* inh ) {
-    iniinh_t* it;
-    it = sect->inherit;
-    while( it ) {
-        if( it == inh ) {
-            return 1;
-        }
-        it = it->next;
+static inistring_t* IniAtomCreate( ini_t* ini, const char* str, ptrdiff_t len ) {
+    inistring_t* a;
+    unsigned hash;
+    ptrdiff_t i;
+    
+    iniassert( ini );
+    
+    if( !str || len == 0 ) {
+        return NULL;
     }
-    return 0;
+    if( len < 0 ) {
+        len = strlen(str);
+    }
+    
+    hash = IniHash( str, len );
+    a = IniAtomFind( ini, str, len, hash );
+    if( a ) {
+        a->refs++;
+        return a;
+    }
+    
+    // Keep the load factor of the table below 1/2
+    if( (ini->numAtoms + 1) * 2 > ini->atomsSize ) {
+        IniAtomsGrow( ini );
+    }
+    
+    // Interned strings are shared by all files
+    a = IniStringCreate( ini, NULL, str, len );
+    a->hash = hash;
+    a->refs = 1;
+    i = hash & (ini->atomsSize - 1);
+    while( ini->atoms[i] ) {
+        i = (i + 1) & (ini->atomsSize - 1);
+    }
+    ini->atoms[i] = a;
+    ini->numAtoms++;
+    return a;
 }
 
-
 /*
 ================
-IniScanToken
+IniAtomRelease
+
+  Уменьшить счётчик ссылок интернированной строки, строка удаляется когда на
+неё не осталось ссылок.
 ================
 */
-#define INI_IDENTIFICATOR   0x1f00  // identificator
-#define INI_EQUAL           '='     // string
-#define INI_SECT_OPEN       '['     // identificator
-#define INI_SECT_CLOSE      ']'     //
-#define INI_COMMA           ','     // identificator
-#define INI_COMMENT         ';'     // comment
-#define INI_INHERIT         ':'     // identificator
-#define INI_PREPROCESSOR    '#'     // string
-#define INI_INCLUDE_PATH    '\"'    // "string"
-
-#define f   (s->forward)
-#define b   (s->begin)
-#define l   (s->length)
-#define tk  (s->token)
-
-static int IniIsSpace( int ch ) {
-    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\v' || 
-        ch == '\f' || ch == '\r';
-}
-
-static void IniSkipSpaces( char** p ) {
-    while( IniIsSpace(**p) ) {
-        (*p)++;
+static void IniAtomRelease( ini_t* ini, inistring_t* a ) {
+    ptrdiff_t mask;
+    ptrdiff_t i;
+    ptrdiff_t j;
+    ptrdiff_t k;
+    
+    iniassert( ini );
+    iniassert( a );
+    iniassert( a->refs > 0 );
+    
+    if( --a->refs ) {
+        return;
     }
-}
-
-static int IniIsIdSymbol( int ch ) {
-    return ch == '_' || ch == '$' || ch == '-' || ch == '.' || 
-        ch == ':' || ch == '\\' || ch == '#' || ch == '(' || ch == ')'
-        || ch == ',' || ch == '?' || ch == '@';
-}
-
-static int IniIsIdSymbol2( int ch ) {
-    return ch == '_' || ch == '$' || ch == '-' || ch == '.' || 
-        ch == ':' || ch == '\\' || ch == '#' || ch == '(' || ch == ')'
-        || ch == '?' || ch == '@';
-}
-
-static int IniScanIdentificator( iniscan_t* s ) {
-    IniSkipSpaces( &f );
-    b = f;
-    while( isalnum(*f) || IniIsIdSymbol(*f) ) {
-        f++;
+    
+    mask = ini->atomsSize - 1;
+    i = a->hash & mask;
+    while( ini->atoms[i] != a ) {
+        i = (i + 1) & mask;
     }
-    l = f - b;
-    return l ? 0 : -1;
-}
-
-static int IniScanIdentificator2( iniscan_t* s ) {
-    IniSkipSpaces( &f );
-    b = f;
-    while( isalnum(*f) || IniIsIdSymbol2(*f) ) {
-        f++;
+    
+    // Backward shift deletion, keeps probe sequences without holes
+    ini->atoms[i] = NULL;
+    j = i;
+    for(;;) {
+        j = (j + 1) & mask;
+        if( ini->atoms[j] == NULL ) {
+            break;
+        }
+        k = ini->atoms[j]->hash & mask;
+        if( (j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j)) ) {
+            ini->atoms[i] = ini->atoms[j];
+            ini->atoms[j] = NULL;
+            i = j;
+        }
     }
-    l = f - b;
-    return l ? 0 : -1;
+    ini->numAtoms--;
+    IniMfree( ini, NULL, INI_MTAG_STRING, a, sizeof(inistring_t) + a->size );
 }
 
-static int IniScanValue( iniscan_t* s ) {
-    IniSkipSpaces( &f );
-    b = f;
-    while( *f && !(*f == ';' || *f == '/' || *f == '\n') ) {
-        if( !IniIsSpace(*f) ) {
-            l = f - b;
-        }
-        f++;
+/*
+================
+IniStringFree
+
+  Освободить строку (интернированные строки освобождаются по счётчику
+ссылок, строки размещённые внутри параметра не освобождаются)
+================
+*/
+static void IniStringFree( ini_t* ini, inidescr_t* descr, inistring_t* s ) {
+    iniassert( ini );
+    
+    if( !s ) {
+        return;
     }
-    if( b != f && (*f == ';' || *f == '/' || *f == '\n') ) {
-        l++;
+    if( s->refs ) {
+        IniAtomRelease( ini, s );
+    } else if( s->size ) {
+        IniMfree( ini, descr, INI_MTAG_STRING, s, sizeof(inistring_t) + s->size );
     }
-    return 0;
 }
 
-static int IniScanComment( iniscan_t* s ) {
-    b = f;
-    l = 0;
-    while( *f && *f != '\n' ) {
-        if( !IniIsSpace(*f) ) {
-            l = f - b + 1;
-        }
-        f++;
-    }
-    return 0;
-}
+/*
+================
+IniSectTableSlot
 
-static int IniScanIncludePath( iniscan_t* s ) {
-    char ch = *f;
-    f++;
-    b = f;
-    while( *f && *f != ch ) {
-        f++;
-    }
-    l = f - b;
-    if( *f && *f == ch ) {
-        f++;
-        return 0;
-    } else {
-        return -1;
+  Слот таблицы секций с названием key, либо пустой слот куда это название
+можно вставить
+================
+*/
+static ptrdiff_t IniSectTableSlot( const ini_t* ini, const inistring_t* key ) {
+    ptrdiff_t mask;
+    ptrdiff_t i;
+    
+    mask = ini->sectTableSize - 1;
+    i = key->hash & mask;
+    while( ini->sectTable[i] && ini->sectTable[i]->key != key ) {
+        i = (i + 1) & mask;
     }
+    return i;
 }
 
-static int IniFindKeyword( const char* word, ptrdiff_t len ) {
-    int i;
-    for( i = 0; inikeywords[i].word; i++ ) {
-        if( len == inikeywords[i].length && 
-            !strncmp( inikeywords[i].word, word, len ) ) {
-            return i;
+/*
+================
+IniSectTableGrow
+================
+*/
+static void IniSectTableGrow( ini_t* ini ) {
+    inisect_t** old;
+    ptrdiff_t oldSize;
+    ptrdiff_t i;
+    
+    iniassert( ini );
+    
+    old = ini->sectTable;
+    oldSize = ini->sectTableSize;
+    ini->sectTableSize = oldSize ? oldSize * 2 : 64;
+    ini->sectTable = (inisect_t**)IniMalloc( ini, NULL, INI_MTAG_INDEX,
+        ini->sectTableSize * sizeof(inisect_t*) );
+    memset( ini->sectTable, 0, ini->sectTableSize * sizeof(inisect_t*) );
+    
+    for( i = 0; i < oldSize; i++ ) {
+        if( old[i] ) {
+            ini->sectTable[IniSectTableSlot( ini, old[i]->key )] = old[i];
         }
     }
-    return -1;
+    if( old ) {
+        IniMfree( ini, NULL, INI_MTAG_INDEX, old, 
+            oldSize * sizeof(inisect_t*) );
+    }
 }
 
-static int IniScanToken( iniscan_t* s ) {
-    l = 0;
+/*
+================
+IniSectTableAdd
 
-    for(;;) {
-        b = f;
-        switch( *f ) {
-            case 0: tk = 0; l = 0; return 0;
-            case ' ': case '\t': case '\n': case '\v': case '\f':
-            case '\r': f++; break;
-            case '=':
-                f++;
-                IniScanValue( s );
-                return tk = INI_EQUAL;
-            case '[':
-                f++;
-                if( IniScanIdentificator( s ) ) {
-                    return tk = -1;
-                }
-                return tk = INI_SECT_OPEN;
-            case ']':
-                f++;
-                l = 1;
-                return tk = INI_SECT_CLOSE;
-            case ',':
-                f++;
-                if( IniScanIdentificator2( s ) ) {
-                    return tk = -1;
-                }
-                return tk = INI_COMMA;
-            case ';': case '/':
-                f++;
-                IniScanComment( s );
-                return tk = INI_COMMENT;
-            case ':':
-                f++;
-                if( IniScanIdentificator2( s ) ) {
-                    return tk = -1;
-                }
-                return tk = INI_INHERIT;
-            case '#':
-                f++;
-                if( IniScanIdentificator( s ) ) {
-                    return tk = -1;
-                }
-                return tk = INI_PREPROCESSOR;
-            case '\'': case '"':
-                if( IniScanIncludePath( s ) ) {
-                    return tk = -1;
-                }
-                return tk = INI_INCLUDE_PATH;
-            default:
-                if( IniScanIdentificator( s ) ) {
-                    return tk = -1;
-                }
-                return tk = INI_IDENTIFICATOR;
-        }
+  Добавить секцию, только что добавленную в конец списка секций. Если
+секция с таким названием уже есть, то в таблице остаётся она
+================
+*/
+static void IniSectTableAdd( ini_t* ini, inisect_t* sect ) {
+    ptrdiff_t i;
+    
+    iniassert( ini );
+    iniassert( sect );
+    iniassert( sect->key );
+    
+    // Keep the load factor of the table below 1/2
+    if( (ini->sectTableCount + 1) * 2 > ini->sectTableSize ) {
+        IniSectTableGrow( ini );
     }
+    i = IniSectTableSlot( ini, sect->key );
+    if( ini->sectTable[i] ) {
+        ini->numDupSects++;
+        return;
+    }
+    ini->sectTable[i] = sect;
+    ini->sectTableCount++;
 }
 
 /*
 ================
-IniPathCopy
+IniSectTableRemove
 
-Скопировать путь к файлу из src в dst, функция возвращает указатель на символ
-следующий после конца пути к файлу.
-
-src: "path\to\file\filename.ext"
-dst: "path\to\file\"
-return:            ^ - pointer to this NULL symbol
+  Убрать секцию из таблицы до того, как она исключена из списка секций
 ================
 */
-static char* IniPathCopy( char* dst, const char* src ) {
-    char* ret = dst;
-    ptrdiff_t i = 0;
-    for( ; src[i]; i++ ) {
-        if( src[i] == '\\' || src[i] == '/' ) {
-            ret = dst + i + 1;
+static void IniSectTableRemove( ini_t* ini, inisect_t* sect ) {
+    inisect_t* s;
+    ptrdiff_t mask;
+    ptrdiff_t i;
+    ptrdiff_t j;
+    ptrdiff_t k;
+    
+    iniassert( ini );
+    iniassert( sect );
+    iniassert( sect->key );
+    
+    i = IniSectTableSlot( ini, sect->key );
+    iniassert( ini->sectTable[i] );
+    if( ini->sectTable[i] != sect ) {
+        ini->numDupSects--;
+        return;
+    }
+    
+    // The next duplicate in the list order takes the place, without
+    // duplicates the list is not walked
+    if( ini->numDupSects ) {
+        for( s = sect->next; s; s = s->next ) {
+            if( s->key == sect->key ) {
+                ini->sectTable[i] = s;
+                ini->numDupSects--;
+                return;
+            }
         }
     }
-    strncpy( dst, src, ret - dst );
-    *ret = 0;
-    return ret;
+    
+    // Backward shift deletion, the same as in IniAtomRelease
+    mask = ini->sectTableSize - 1;
+    ini->sectTable[i] = NULL;
+    j = i;
+    for(;;) {
+        j = (j + 1) & mask;
+        if( ini->sectTable[j] == NULL ) {
+            break;
+        }
+        k = ini->sectTable[j]->key->hash & mask;
+        if( (j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j)) ) {
+            ini->sectTable[i] = ini->sectTable[j];
+            ini->sectTable[j] = NULL;
+            i = j;
+        }
+    }
+    ini->sectTableCount--;
 }
 
 /*
 ================
-IniRecursiveParse
+IniFindSectAtom
 ================
 */
-static int IniRecursiveParse( ini_t* ini, const char* filename, ptrdiff_t relative ) {
-    iniparam_t* param;      // Pointer to parameter
-    inidescr_t* descr;      // Pointer to description
-    iniscan_t* s;           // Scanner pointer
-    inisect_t* sect;        // Current section
-    iniscan_t scan;         // Scanner
-    FILE* file;             // Current file
-    char* key;              // Key pointer
-    char* val;              // Value pointer
-    char* nextfname;        // Pointer to filename
-    char buf[4096*2];       // Scanner buffer
-    char nextpath[1024];    // Path to file
-    char string[1024];      // Used for inheritance
-    ptrdiff_t keylen;       // Key length
-    ptrdiff_t vallen;       // Value length
-    int line;               // Current line in the file
-    int ret;                // Return code
-    int tmp;                //
+static inisect_t* IniFindSectAtom( ini_t* ini, const inistring_t* key ) {
+    inisect_t* s;
     
-    s = &scan;
-    param = NULL;
-    nextfname = NULL;
-    line = 0;
-    ret = 0;
-    //scan.forward = buf;
+    iniassert( ini );
+    iniassert( key );
     
-    // Open current file
-    if( (file = fopen( filename, "r" )) == NULL ) {
-        IniPrint( ini, "error: can not open file '%s'\n", filename );
-        return -1;
+    // One probe in the frozen table, a missing key lands on another section
+    if( ini->sectMph ) {
+        s = (inisect_t*)ini->sectMph->items[IniMphSlot( ini->sectMph, 
+            key->hash, IniHash2( key->string, key->length ) )];
+        return s->key == key ? s : NULL;
     }
     
-    // Append current filename to filedescr
-    descr = IniAppendDescr( ini, filename );
-    sect = descr->gsect;
-    // Main parsing loop
-    while( fgets( buf, sizeof(buf), file ) != NULL ) {
-        line++;
-        f = buf; //-V507
-
-        switch( IniScanToken( s ) ) {
-            case INI_IDENTIFICATOR:
-                // Save pointer to key and key length
-                key = b;
-                keylen = l;
-                
-                IniScanToken( s );
-                // Save pointer to value and value length (if token is value)
-                if( tk == INI_EQUAL ) {
-                    val = b;
-                    vallen = l;
-                    IniScanToken( s );
-                } else {
-                    val = NULL;
-                    vallen = 0;
-                }
-                
-                // Check section. Section cannot be is global
-                if( sect != descr->gsect ) {
-                    // Append parametr to section
-                    param = IniParamCreate( ini,
-                        IniStringCreate( ini, key, keylen ),
-                        IniStringCreate( ini, val, vallen ),
-                        NULL
-                    );
-                    IniAppendParam_s( sect, param );
-                } else {
-                    IniPrint( ini, "error: section start expected line:%d \
-file:'%s'\n", line, filename );
-                    ret = -1;
-                    continue;
-                }
-                
-                // Append comment to current sectoin (if token is comment)
-                if( ini->flags & INI_FLAG_PARSE_COMMENTS && tk == INI_COMMENT ) {
-                    if( !param->comment ) {
-                        param->comment = IniStringCreate( ini, b, l );
-                    }
-                    // Scan next token
-                    IniScanToken( s );
-                }
-                
-                break;
-                
-            // Parse next sequence:
-            // [section]: inherit1, inherit2, ... , inherit_n ; comment
-            case INI_SECT_OPEN:
-                key = b;
-                keylen = l;
-                
-                IniScanToken( s );
-                // Expect close section symbol ']'
-                if( tk != INI_SECT_CLOSE ) {
-                    IniPrint( ini, "error: expected ']' line:%d file'%s'\n", 
-                        line, filename );
-                    ret = -1;
-                    continue;
-                }
-                
-                // Create new section and append section to filedescr
-                sect = IniSectCreate( ini,
-                    IniStringCreate( ini, key, keylen ),
-                    NULL
-                );
-                IniAppendSect_s( descr, sect );
-                
-                IniScanToken( s );
-                // Check for inherit and parse 'inherit' sequences
-                while( tk == INI_COMMA || tk == INI_INHERIT ) {
-                    strncpy( string, b, l );
-                    string[l] = 0;
-                    // Inherit for current section
-                    if( IniSectInherit( sect, string ) ) {
-                        IniPrint( ini, "error: can not find section for \
-inherit '%s' line:%d file:'%s'\n", string, line, filename );
-                        ret = -1;
-                    }
-                    // Scan next token
-                    IniScanToken( s );
-                }
-                
-                // Append comment to current sectoin (if token is comment)
-                if( !!(ini->flags & INI_FLAG_PARSE_COMMENTS) && tk == INI_COMMENT ) {
-                    if( !sect->comment ) {
-                        sect->comment = IniStringCreate( ini, b, l );
-                    }
-                    // Scan next token
-                    IniScanToken( s );
-                }
-                
-                break;
-            
-            // Parse next sequence:
-            // #preproc "path\filename.ext" ; comment
-            case INI_PREPROCESSOR:
-                switch( IniFindKeyword( b, l ) ) {
-                    
-                    // Parse next sequence:
-                    // #include "path\filename.ext" ; comment
-                    case 0:
-                        IniScanToken( s );
-                        if( tk == INI_INCLUDE_PATH ) {
-                            
-                            // If new file path is not initialized
-                            if( nextfname == NULL ) {
-                                nextfname = IniPathCopy( nextpath, filename );
-                                relative = nextfname - nextpath;
-                            }
-                            
-                            // Append new filename to new file path
-                            strncpy( nextfname, b, l );
-                            nextfname[l] = 0;
-                            
-                            // Check the included file for already include
-                            if( IniFiledescrFind( ini, nextpath, -1 ) ) {
-                                IniPrint( ini, "warning: file '%s' is \
-already included line:%d file:'%s'\n", nextpath, line, filename );
-                                continue;
-                            } else {
-                                // Append parametr to section
-                                param = IniAppendIncludeToSect( sect, 
-                                    nextpath + relative
-                                );
-                                // Parsing nested include files
-                                tmp = IniRecursiveParse( ini, nextpath, 
-                                    relative
-                                );
-                                ret = ret ? tmp : ret;
-                            }
-                        } else {
-                            IniPrint( ini, "error: expected included file \
-name line:%d file:'%s'\n", line, filename );
-                            ret = -1;
-                            continue;
-                        }
-                        break;
-                        
-                    // Parse next sequence:
-                    // #print "to print" ; comment
-                    case 1:
-                        IniScanToken( s );
-                        if( tk == INI_INCLUDE_PATH ) {
-                            // Create new parameter
-                            param = IniParamCreate( ini,
-                                IniStringCreate( ini, "#print", 6 ),
-                                IniStringCreate( ini, b, l ),
-                                NULL
-                            );
-                            // Append to section
-                            IniAppendParam_s( sect, param );
-                            // And print data to stdout
-                            fprintf( stdout, "%.*s\n", (int)l, b );
-                        } else {
-                            IniPrint( ini, "error: expected printing value \
-line:%d file:'%s'\n", line, filename );
-                            ret = -1;
-                            continue;
-                        }
-                        break;
-                        
-                    // Uncnown #keyword
-                    default:
-                        IniPrint( ini, "error: uncnown directive '%.*s' \
-line:%d file:'%s'\n", (int)l, b, line, filename );
-                        ret = -1;
-                        continue;
-                }
-                IniScanToken( s );
-                
-                // Append comment to current parametr
-                if( !!(ini->flags & INI_FLAG_PARSE_COMMENTS) && tk == INI_COMMENT ) {
-                    if( !param->comment ) {
-                        param->comment = IniStringCreate( ini, b, l );
-                    }
-                    IniScanToken( s );
-                }
-                break;
-                
-            // Parse next sequence:
-            // ; comment
-            case INI_COMMENT:
-                if( !!(ini->flags & INI_FLAG_PARSE_COMMENTS) ) {
-                    // Create comment
-                    param = IniParamCreate( ini, NULL, NULL,
-                        IniStringCreate( ini, b, l )
-                    );
-                    if( sect != NULL ) {
-                        // Append comment to current section
-                        IniAppendParam_s( sect, param );
-                    } else {
-                        // Append comment to global section
-                        IniAppendParam_s( descr->gsect, param );
-                    }
-                }
-                // Scan next token and break from case
-                IniScanToken( s );
-                break;
-        }
-        
-        // Check for next empty token
-        if( !(tk == 0 || (tk == INI_COMMENT && !(ini->flags & INI_FLAG_PARSE_COMMENTS))) ) { 
-            IniPrint( ini, "error: uncnown token '%.*s' line:%d file:'%s'\n", 
-                (int)l, b, line, filename );
-            ret = -1;
-        }
+    if( !ini->sectTable ) {
+        return NULL;
     }
+    return ini->sectTable[IniSectTableSlot( ini, key )];
+}
+
+/*
+================
+IniInheritCreate
+================
+*/
+static iniinh_t* IniInheritCreate( ini_t* ini, inidescr_t* descr, inisect_t* sect ) {
+    iniinh_t* inh;
     
-    // Check if the file is read correctly
-    if( !feof(file) && ferror(file) ) {
-        IniPrint( ini, "error: error reading file '%s'\n", filename );
-        ret = -1;
-    }
-    fclose(file);
+    iniassert( ini );
+    iniassert( sect );
     
-    return ret;
+    inh = (iniinh_t*)IniMalloc( ini, descr, INI_MTAG_INHERIT, 
+        sizeof(iniinh_t) );
+    inh->next = NULL;
+    inh->prev = NULL;
+    inh->inhSect = sect;
+    inh->sect = NULL;
+    inh->twin = NULL;
+    return inh;
 }
 
-#undef f
-#undef b
-#undef l
-#undef tk
+/*
+================
+IniHeirCreate
+================
+*/
+static iniinh_t* IniHeirCreate( ini_t* ini, inidescr_t* descr, inisect_t* sect ) {
+    iniinh_t* inh;
+    
+    iniassert( ini );
+    iniassert( sect );
+    
+    inh = (iniinh_t*)IniMalloc( ini, descr, INI_MTAG_HEIR, sizeof(iniinh_t) );
+    inh->next = NULL;
+    inh->prev = NULL;
+    inh->inhSect = sect;
+    inh->sect = NULL;
+    inh->twin = NULL;
+    return inh;
+}
 
 /*
 ================
-IniFprintSect
+IniPtrSetInit
+
+  Множество указателей для временных данных обхода
 ================
 */
-static void IniFprintSect( FILE* f, inisect_t* s, int includeignore ) {
-    unsigned flags;         // Флаги для печати
-    int keyalign;           // Выравнивание ключа (выравнивание пробелами)
-    int emptyline;          // Печатать ли пустую строку после конца секции
-    int printcomment;       // Печатать ли комментарии
-    int spaceaftereq;       // Пробел после знака равно
-    int printheirs;         // Печатать наследников перед секцией
-    int printempty;         // Печатать пустые строки, если такие есть
-    int spacebeforeeq;      // Печатать пробел перед знаком
-    iniinh_t* inh;          // Унаследованные секции
-    iniparam_t* p;          // Параметры секции
+static void IniPtrSetInit( ini_t* ini, iniptrset_t* set ) {
+    set->ini = ini;
+    set->size = 16;
+    set->count = 0;
+    set->items = (void**)IniMalloc( ini, NULL, INI_MTAG_KEYINDEX, 
+        set->size * sizeof(void*) );
+    memset( set->items, 0, set->size * sizeof(void*) );
+}
 
-    iniassert( f );
-    iniassert( s );
-    iniassert( s->filename );
-    iniassert( s->filename->gsect );
+static void IniPtrSetFree( iniptrset_t* set ) {
+    IniMfree( set->ini, NULL, INI_MTAG_KEYINDEX, set->items, 
+        set->size * sizeof(void*) );
+    set->items = NULL;
+}
 
-    flags = s->filename->ini->flags;
-    keyalign = (flags >> 24) & 0xff;
-    emptyline = flags & INI_FLAG_EMPTY_LINE_AFTER_SECT;
-    printheirs = flags & INI_FLAG_PRINT_HEIRS;
-    printcomment = flags & INI_FLAG_PRINT_COMMENTS;
-    spaceaftereq = flags & INI_FLAG_SPACE_AFTER_EQ;
-    printempty = flags & INI_FLAG_PRINT_EMPTY_LINES;
-    spacebeforeeq = keyalign == 0 && (flags & INI_FLAG_SPACE_BEFORE_EQ);
+static void IniPtrSetClear( iniptrset_t* set ) {
+    if( set->count ) {
+        memset( set->items, 0, set->size * sizeof(void*) );
+        set->count = 0;
+    }
+}
 
-    // ; sect_heir1, sect_heir2, ...
-    if( printheirs ) {
-        inh = s->heirs;
-        if( inh ) {
-            fprintf( f, "; heirs: " );
-            while( inh ) {
-                fprintf( f, "%s", inh->inhSect->key->string );
-                inh = inh->next;
-                if( inh ) {
-                    fprintf( f, ", " );
-                }
-            }
-            fprintf( f, "\n" );
-        }
+static ptrdiff_t IniPtrSetSlot( const iniptrset_t* set, const void* ptr ) {
+    ptrdiff_t i;
+    
+    i = (ptrdiff_t)(((size_t)ptr >> 4) * 2654435761u) & (set->size - 1);
+    while( set->items[i] && set->items[i] != ptr ) {
+        i = (i + 1) & (set->size - 1);
     }
+    return i;
+}
 
-    // [section_name]:inherit1, inherit2, ...; comment
-    if( s != s->filename->gsect ) {
-        if( s->key ) {  // [section_name]
-            fprintf( f, "[%s]", s->key->string );
-        }
-        inh = s->inherit;
-        if( inh ) {     // :inherit1, inherit2, ...
-            fprintf( f, ":" );
-            while( inh ) {
-                fprintf( f, "%s", inh->inhSect->key->string );
-                inh = inh->next;
-                if( inh ) {
-                    fprintf( f, ", " );
-                }
+static int IniPtrSetHas( const iniptrset_t* set, const void* ptr ) {
+    return set->items[IniPtrSetSlot( set, ptr )] != NULL;
+}
+
+/*
+================
+IniPtrSetAdd
+
+  Добавить указатель в множество. Функция возвращает 0, если указатель уже
+был в множестве
+================
+*/
+static int IniPtrSetAdd( iniptrset_t* set, void* ptr ) {
+    void** old;
+    ptrdiff_t oldSize;
+    ptrdiff_t i;
+    
+    i = IniPtrSetSlot( set, ptr );
+    if( set->items[i] ) {
+        return 0;
+    }
+    set->items[i] = ptr;
+    set->count++;
+    
+    if( set->count * 2 > set->size ) {
+        old = set->items;
+        oldSize = set->size;
+        set->size *= 2;
+        set->items = (void**)IniMalloc( set->ini, NULL, INI_MTAG_KEYINDEX, 
+            set->size * sizeof(void*) );
+        memset( set->items, 0, set->size * sizeof(void*) );
+        for( i = 0; i < oldSize; i++ ) {
+            if( old[i] ) {
+                set->items[IniPtrSetSlot( set, old[i] )] = old[i];
             }
         }
-        if( printcomment && s->comment ) {  // ; comment
-            fprintf( f,";%s\n", s->comment->string );
-        } else {
-            fprintf( f, "\n" );
-        }
+        IniMfree( set->ini, NULL, INI_MTAG_KEYINDEX, old, oldSize * sizeof(void*) );
     }
+    return 1;
+}
 
-    // key = value; comment
-    p = s->firstParam;
-    while( p ) {
-        if( p->key && p->key->string[0] == '#' ) {
-            // #preproc_key "value"; comment
-            if( includeignore && 
-                !strncmp( p->key->string, "#include", 8 ) ) {
-                goto goIgnore;
-            }
-            fprintf( f, "%s", p->key->string );
-            if( p->value ) {
-                fprintf( f, " \"%s\"", p->value->string );
-            }
-            goIgnore:
-            if( printcomment && p->comment ) {
-                fprintf( f, ";%s", p->comment->string );
-            }
-        } else {
-            // key = value; comment
-            if( p->key ) {
-                if( p->value || (printcomment && p->comment) ) {
-                    fprintf( f, "%-*s", keyalign, p->key->string );
-                } else {
-                    fprintf( f, "%s", p->key->string );
-                }
-            }
-            if( p->value ) {
-                if( spacebeforeeq && spaceaftereq ) {
-                    fprintf( f, " = %s", p->value->string );
-                } else if( spacebeforeeq ) {
-                    fprintf( f, " =%s", p->value->string );
-                } else if( spaceaftereq ) {
-                    fprintf( f, "= %s", p->value->string );
-                } else {
-                    fprintf( f, "=%s", p->value->string );
+/*
+================
+IniParamLinesAdd
+
+  Запомнить строку параметра повторной секции. Параметры не хранят номер
+строки, а предупреждения о повторных параметрах при объединении секций
+(см. IniMergeSects) выводятся с ним, как при разборе с проверкой
+================
+*/
+static void IniParamLinesAdd( iniparamlines_t* lines, iniparam_t* param, int line ) {
+    iniparamline_t* old;
+    ptrdiff_t oldSize;
+    ptrdiff_t i;
+    ptrdiff_t j;
+    
+    if( (lines->count + 1) * 2 > lines->size ) {
+        old = lines->items;
+        oldSize = lines->size;
+        lines->size = oldSize ? oldSize * 2 : 64;
+        lines->items = (iniparamline_t*)IniMalloc( lines->ini, NULL, 
+            INI_MTAG_DIAG, lines->size * sizeof(iniparamline_t) );
+        memset( lines->items, 0, lines->size * sizeof(iniparamline_t) );
+        for( j = 0; j < oldSize; j++ ) {
+            if( old[j].param ) {
+                i = (ptrdiff_t)(((size_t)old[j].param >> 4) * 2654435761u) & 
+                    (lines->size - 1);
+                while( lines->items[i].param ) {
+                    i = (i + 1) & (lines->size - 1);
                 }
-            }
-            if( p->comment && printcomment ) {
-                fprintf( f, ";%s", p->comment->string );
+                lines->items[i] = old[j];
             }
         }
-        if( ((p->comment && printcomment) || p->key || p->value) &&
-            !(p->key && p->key->string[0] == '#' && includeignore) ) {
-            fprintf( f, "\n" );
-        } else if( printempty ) {
-            fprintf( f, "\n" );
+        if( old ) {
+            IniMfree( lines->ini, NULL, INI_MTAG_DIAG, old, 
+                oldSize * sizeof(iniparamline_t) );
         }
-        p = p->next;
     }
-        
-    // empty line after section
-    if( emptyline ) {
-        fprintf( f, "\n" );
+    
+    i = (ptrdiff_t)(((size_t)param >> 4) * 2654435761u) & (lines->size - 1);
+    while( lines->items[i].param ) {
+        i = (i + 1) & (lines->size - 1);
     }
+    lines->items[i].param = param;
+    lines->items[i].line = line;
+    lines->count++;
 }
 
 /*
 ================
-IniFprintFiledescr
+IniParamLinesFind
+
+  Строка параметра повторной секции (0 - не запомнена)
 ================
 */
-static void IniFprintFiledescr( FILE* f, inidescr_t* d, int includeignore ) {
-    unsigned flags;
-    inisect_t* s;
-    
-    iniassert( f );
-    iniassert( d );
-    iniassert( d->ini );
+static int IniParamLinesFind( const iniparamlines_t* lines, const iniparam_t* param ) {
+    ptrdiff_t i;
     
-    flags = d->ini->flags;
-    // print the file name at the top of the file
-    if( flags & INI_FLAG_PRINT_FNAME_TOP ) {
-        fprintf( f, "; %s\n", d->filename->string );
+    if( !lines || !lines->items ) {
+        return 0;
     }
-    
-    s = d->gsect;
+    i = (ptrdiff_t)(((size_t)param >> 4) * 2654435761u) & (lines->size - 1);
+    while( lines->items[i].param ) {
+        if( lines->items[i].param == param ) {
+            return lines->items[i].line;
+        }
+        i = (i + 1) & (lines->size - 1);
+    }
+    return 0;
+}
+
+static void IniParamLinesFree( iniparamlines_t* lines ) {
+    if( lines->items ) {
+        IniMfree( lines->ini, NULL, INI_MTAG_DIAG, lines->items, 
+            lines->size * sizeof(iniparamline_t) );
+        lines->items = NULL;
+    }
+    lines->size = 0;
+    lines->count = 0;
+}
+
+/*
+================
+IniKeyIndexFree
+
+  Удалить индекс ключей. Индекс удаляется, когда параметры переходят в
+другие секции или удаляется параметр частого ключа (см. IniKeyIndexRemove),
+и строится заново при следующем обращении
+================
+*/
+static void IniKeyIndexFree( ini_t* ini ) {
+    iniposting_t* e;
+    ptrdiff_t i;
+    
+    if( !ini->keyIndex ) {
+        return;
+    }
+    for( i = 0; i < ini->keyIndexSize; i++ ) {
+        e = ini->keyIndex + i;
+        if( e->key ) {
+            IniMfree( ini, NULL, INI_MTAG_KEYINDEX, e->params, 
+                e->size * sizeof(iniparam_t*) );
+        }
+    }
+    IniMfree( ini, NULL, INI_MTAG_KEYINDEX, ini->keyIndex, 
+        ini->keyIndexSize * sizeof(iniposting_t) );
+    ini->keyIndex = NULL;
+    ini->keyIndexSize = 0;
+    ini->keyIndexCount = 0;
+}
+
+/*
+================
+IniKeyIndexAlloc
+================
+*/
+static void IniKeyIndexAlloc( ini_t* ini, ptrdiff_t size ) {
+    ini->keyIndex = (iniposting_t*)IniMalloc( ini, NULL, INI_MTAG_KEYINDEX, 
+        size * sizeof(iniposting_t) );
+    memset( ini->keyIndex, 0, size * sizeof(iniposting_t) );
+    ini->keyIndexSize = size;
+    ini->keyIndexCount = 0;
+}
+
+/*
+================
+IniKeyIndexFind
+================
+*/
+static iniposting_t* IniKeyIndexFind( ini_t* ini, const inistring_t* key ) {
+    ptrdiff_t i;
+    
+    i = key->hash & (ini->keyIndexSize - 1);
+    while( ini->keyIndex[i].key && ini->keyIndex[i].key != key ) {
+        i = (i + 1) & (ini->keyIndexSize - 1);
+    }
+    return ini->keyIndex + i;
+}
+
+/*
+================
+IniKeyIndexAdd
+
+  Добавить параметр в индекс ключей (если индекс построен). Параметры
+глобальных секций в индекс не попадают
+================
+*/
+static void IniKeyIndexAdd( ini_t* ini, iniparam_t* p ) {
+    iniposting_t* e;
+    iniposting_t* old;
+    iniparam_t** params;
+    ptrdiff_t oldSize;
+    ptrdiff_t i;
+    
+    if( !ini->keyIndex || !p->key || !p->sect->filename || 
+        p->sect == p->sect->filename->gsect ) 
+    {
+        return;
+    }
+    
+    e = IniKeyIndexFind( ini, p->key );
+    if( !e->key ) {
+        e->key = p->key;
+        e->count = 0;
+        e->size = 4;
+        e->params = (iniparam_t**)IniMalloc( ini, NULL, INI_MTAG_KEYINDEX, 
+            e->size * sizeof(iniparam_t*) );
+        ini->keyIndexCount++;
+    } else if( e->count == e->size ) {
+        params = (iniparam_t**)IniMalloc( ini, NULL, INI_MTAG_KEYINDEX, 
+            e->size * 2 * sizeof(iniparam_t*) );
+        memcpy( params, e->params, e->count * sizeof(iniparam_t*) );
+        IniMfree( ini, NULL, INI_MTAG_KEYINDEX, e->params, 
+            e->size * sizeof(iniparam_t*) );
+        e->params = params;
+        e->size *= 2;
+    }
+    e->params[e->count++] = p;
+    
+    if( ini->keyIndexCount * 2 > ini->keyIndexSize ) {
+        old = ini->keyIndex;
+        oldSize = ini->keyIndexSize;
+        IniKeyIndexAlloc( ini, oldSize * 2 );
+        for( i = 0; i < oldSize; i++ ) {
+            if( old[i].key ) {
+                *IniKeyIndexFind( ini, old[i].key ) = old[i];
+                ini->keyIndexCount++;
+            }
+        }
+        IniMfree( ini, NULL, INI_MTAG_KEYINDEX, old, oldSize * sizeof(iniposting_t) );
+    }
+}
+
+/*
+================
+IniKeyIndexRemove
+
+  Убрать параметр из индекса ключей (если индекс построен). Порядок
+остальных параметров с тем же ключом сохраняется, ключ без параметров
+удаляется из таблицы со сдвигом следующих за ним элементов. Если у ключа
+больше INI_KEYINDEX_REMOVE_MAX параметров, то индекс удаляется целиком и
+строится заново при следующем обращении: иначе удаление многих параметров с
+одним ключом стало бы квадратичным
+================
+*/
+static void IniKeyIndexRemove( ini_t* ini, iniparam_t* p ) {
+    iniposting_t* e;
+    ptrdiff_t mask;
+    ptrdiff_t hole;
+    ptrdiff_t home;
+    ptrdiff_t i;
+    
+    // Parameters of global sections are not in the index
+    if( !ini->keyIndex || !p->key || !p->sect || !p->sect->filename || 
+        p->sect == p->sect->filename->gsect ) 
+    {
+        return;
+    }
+    
+    e = IniKeyIndexFind( ini, p->key );
+    if( !e->key ) {
+        return;
+    }
+    // Bulk deletes free the index once, the following ones cost nothing
+    if( e->count > INI_KEYINDEX_REMOVE_MAX ) {
+        IniKeyIndexFree( ini );
+        return;
+    }
+    for( i = 0; i < e->count && e->params[i] != p; i++ );
+    if( i == e->count ) {
+        return;
+    }
+    e->count--;
+    memmove( e->params + i, e->params + i + 1, 
+        (e->count - i) * sizeof(iniparam_t*) );
+    if( e->count ) {
+        return;
+    }
+    
+    IniMfree( ini, NULL, INI_MTAG_KEYINDEX, e->params, 
+        e->size * sizeof(iniparam_t*) );
+    ini->keyIndexCount--;
+    // Linear probing: pull back the entries whose probe passes the hole
+    mask = ini->keyIndexSize - 1;
+    hole = e - ini->keyIndex;
+    i = (hole + 1) & mask;
+    while( ini->keyIndex[i].key ) {
+        home = ini->keyIndex[i].key->hash & mask;
+        if( ((i - home) & mask) >= ((i - hole) & mask) ) {
+            ini->keyIndex[hole] = ini->keyIndex[i];
+            hole = i;
+        }
+        i = (i + 1) & mask;
+    }
+    memset( ini->keyIndex + hole, 0, sizeof(iniposting_t) );
+}
+
+/*
+================
+IniKeyIndex
+
+  Построить индекс ключей, если его ещё нет. Пока индекс есть, новые
+параметры добавляются в него сразу (см. IniAppendParam_s)
+================
+*/
+static void IniKeyIndex( ini_t* ini ) {
+    inisect_t* s;
+    iniparam_t* p;
+    
+    if( ini->keyIndex ) {
+        return;
+    }
+    IniKeyIndexAlloc( ini, 64 );
+    for( s = ini->firstSect; s; s = s->next ) {
+        for( p = s->firstParam; p; p = p->next ) {
+            IniKeyIndexAdd( ini, p );
+        }
+    }
+}
+
+/*
+================
+IniClosureWords
+
+  Размер строки транзитивного замыкания (в словах size_t)
+================
+*/
+static ptrdiff_t IniClosureWords( const ini_t* ini ) {
+    return ini->idsSize / INI_WORD_BITS;
+}
+
+#define INI_CLOSURE_HAS(row, id)    ((row)[(id) / INI_WORD_BITS] & ((size_t)1 << ((id) % INI_WORD_BITS)))
+#define INI_CLOSURE_SET(row, id)    ((row)[(id) / INI_WORD_BITS] |= ((size_t)1 << ((id) % INI_WORD_BITS)))
+
+/*
+================
+IniClosureAlloc
+================
+*/
+static size_t* IniClosureAlloc( ini_t* ini ) {
+    size_t* row;
+    
+    row = (size_t*)IniMalloc( ini, NULL, INI_MTAG_CLOSURE, 
+        IniClosureWords( ini ) * sizeof(size_t) );
+    memset( row, 0, IniClosureWords( ini ) * sizeof(size_t) );
+    return row;
+}
+
+static void IniClosureRelease( ini_t* ini, size_t** prow ) {
+    if( *prow ) {
+        IniMfree( ini, NULL, INI_MTAG_CLOSURE, *prow, 
+            IniClosureWords( ini ) * sizeof(size_t) );
+        *prow = NULL;
+        ini->numClosures--;
+    }
+}
+
+/*
+================
+IniClosureFreeAll
+
+  Удалить все сохранённые множества предков и наследников
+================
+*/
+static void IniClosureFreeAll( ini_t* ini ) {
+    ptrdiff_t i;
+    
+    for( i = 0; i < ini->numIds && ini->numClosures; i++ ) {
+        if( ini->sectById[i] ) {
+            IniClosureRelease( ini, &ini->sectById[i]->ancestors );
+            IniClosureRelease( ini, &ini->sectById[i]->descendants );
+        }
+    }
+    iniassert( !ini->numClosures );
+}
+
+/*
+================
+IniClosureFill
+
+  Добавить в row все секции достижимые из sect по ссылкам наследования
+(up != 0) или по ссылкам на наследников (up == 0). Уже отмеченные секции
+не обходятся повторно, поэтому циклы наследования не мешают обходу
+================
+*/
+static void IniClosureFill( size_t* row, inisect_t* sect, int up ) {
+    iniinh_t* inh;
+    
+    for( inh = up ? sect->inherit : sect->heirs; inh; inh = inh->next ) {
+        if( !INI_CLOSURE_HAS( row, inh->inhSect->id ) ) {
+            INI_CLOSURE_SET( row, inh->inhSect->id );
+            IniClosureFill( row, inh->inhSect, up );
+        }
+    }
+}
+
+/*
+================
+IniClosureGet
+
+  Получить множество предков (up != 0) или наследников секции, множество
+строится при первом обращении
+================
+*/
+static size_t* IniClosureGet( ini_t* ini, inisect_t* sect, int up ) {
+    size_t** prow;
+    
+    prow = up ? &sect->ancestors : &sect->descendants;
+    if( !*prow ) {
+        *prow = IniClosureAlloc( ini );
+        IniClosureFill( *prow, sect, up );
+        ini->numClosures++;
+    }
+    return *prow;
+}
+
+/*
+================
+IniClosureReach
+
+  Построить во временной строке множество из секции и всех достижимых из
+неё секций. Сохранённое множество используется, если оно есть
+================
+*/
+static size_t* IniClosureReach( ini_t* ini, inisect_t* sect, int up ) {
+    size_t* row;
+    size_t* cached;
+    
+    row = IniClosureAlloc( ini );
+    cached = up ? sect->ancestors : sect->descendants;
+    if( cached ) {
+        memcpy( row, cached, IniClosureWords( ini ) * sizeof(size_t) );
+    } else {
+        IniClosureFill( row, sect, up );
+    }
+    INI_CLOSURE_SET( row, sect->id );
+    return row;
+}
+
+/*
+================
+IniClosureLink
+
+  Обновить сохранённые множества после добавления наследования секции
+child от секции parent: предками child и всех его наследников становятся
+parent и его предки, а наследниками parent и всех его предков становятся
+child и его наследники
+================
+*/
+static void IniClosureLink( inisect_t* child, inisect_t* parent ) {
+    ini_t* ini;
+    size_t* up;
+    size_t* down;
+    inisect_t* s;
+    ptrdiff_t words;
+    ptrdiff_t i;
+    ptrdiff_t j;
+    
+    ini = child->filename->ini;
+    if( !ini->numClosures ) {
+        return;
+    }
+    words = IniClosureWords( ini );
+    up = IniClosureReach( ini, parent, 1 );
+    down = IniClosureReach( ini, child, 0 );
+    for( i = 0; i < ini->numIds; i++ ) {
+        if( !(s = ini->sectById[i]) ) {
+            continue;
+        }
+        if( s->ancestors && INI_CLOSURE_HAS( down, i ) ) {
+            for( j = 0; j < words; j++ ) {
+                s->ancestors[j] |= up[j];
+            }
+        }
+        if( s->descendants && INI_CLOSURE_HAS( up, i ) ) {
+            for( j = 0; j < words; j++ ) {
+                s->descendants[j] |= down[j];
+            }
+        }
+    }
+    IniMfree( ini, NULL, INI_MTAG_CLOSURE, up, words * sizeof(size_t) );
+    IniMfree( ini, NULL, INI_MTAG_CLOSURE, down, words * sizeof(size_t) );
+}
+
+/*
+================
+IniClosureUnlink
+
+  Вызывается до удаления наследования секции child от секции parent.
+Множества предков child и его наследников и множества наследников parent и
+его предков удаляются и строятся заново при следующем обращении
+================
+*/
+static void IniClosureUnlink( inisect_t* child, inisect_t* parent ) {
+    ini_t* ini;
+    size_t* up;
+    size_t* down;
+    inisect_t* s;
+    ptrdiff_t i;
+    
+    ini = child->filename->ini;
+    if( !ini->numClosures ) {
+        return;
+    }
+    up = IniClosureReach( ini, parent, 1 );
+    down = IniClosureReach( ini, child, 0 );
+    for( i = 0; i < ini->numIds; i++ ) {
+        if( !(s = ini->sectById[i]) ) {
+            continue;
+        }
+        if( INI_CLOSURE_HAS( down, i ) ) {
+            IniClosureRelease( ini, &s->ancestors );
+        }
+        if( INI_CLOSURE_HAS( up, i ) ) {
+            IniClosureRelease( ini, &s->descendants );
+        }
+    }
+    IniMfree( ini, NULL, INI_MTAG_CLOSURE, up, IniClosureWords( ini ) * sizeof(size_t) );
+    IniMfree( ini, NULL, INI_MTAG_CLOSURE, down, IniClosureWords( ini ) * sizeof(size_t) );
+}
+
+/*
+================
+IniSectIdAlloc
+
+  Выдать секции номер. Номера плотные: номера удалённых секций выдаются
+повторно. Если номера не помещаются в строки множеств, то таблица номеров
+увеличивается, а все множества удаляются
+================
+*/
+static void IniSectIdAlloc( ini_t* ini, inisect_t* sect ) {
+    inisect_t** byId;
+    ptrdiff_t* freeIds;
+    ptrdiff_t size;
+    
+    if( ini->numFreeIds ) {
+        sect->id = ini->freeIds[--ini->numFreeIds];
+    } else {
+        if( ini->numIds == ini->idsSize ) {
+            IniClosureFreeAll( ini );
+            size = ini->idsSize ? ini->idsSize * 2 : INI_WORD_BITS * 4;
+            byId = (inisect_t**)IniMalloc( ini, NULL, INI_MTAG_CLOSURE, 
+                size * sizeof(inisect_t*) );
+            freeIds = (ptrdiff_t*)IniMalloc( ini, NULL, INI_MTAG_CLOSURE, 
+                size * sizeof(ptrdiff_t) );
+            if( ini->idsSize ) {
+                memcpy( byId, ini->sectById, ini->numIds * sizeof(inisect_t*) );
+                IniMfree( ini, NULL, INI_MTAG_CLOSURE, ini->sectById, 
+                    ini->idsSize * sizeof(inisect_t*) );
+                IniMfree( ini, NULL, INI_MTAG_CLOSURE, ini->freeIds, 
+                    ini->idsSize * sizeof(ptrdiff_t) );
+            }
+            ini->sectById = byId;
+            ini->freeIds = freeIds;
+            ini->idsSize = size;
+        }
+        sect->id = ini->numIds++;
+    }
+    ini->sectById[sect->id] = sect;
+}
+
+/*
+================
+IniSectIdFree
+================
+*/
+static void IniSectIdFree( ini_t* ini, inisect_t* sect ) {
+    IniClosureRelease( ini, &sect->ancestors );
+    IniClosureRelease( ini, &sect->descendants );
+    if( sect->id >= 0 ) {
+        ini->sectById[sect->id] = NULL;
+        ini->freeIds[ini->numFreeIds++] = sect->id;
+        sect->id = -1;
+    }
+}
+
+/*
+================
+IniParamCreate
+
+  Параметр создаётся одной аллокацией: сразу за iniparam_t в той же памяти
+размещаются значение и комментарий (их size равен 0, отдельно они не
+освобождаются). Ключ интернирован и передаётся уже готовой строкой.
+================
+*/
+#define INI_ALIGN(n)    (((n) + sizeof(void*) - 1) & ~(sizeof(void*) - 1))
+
+static inistring_t* IniStringPlace( char* mem, const char* str, ptrdiff_t len ) {
+    inistring_t* s = (inistring_t*)mem;
+    s->size = 0;
+    s->length = len;
+    s->hash = 0;
+    s->refs = 0;
+    memcpy( s->string, str, len );
+    s->string[len] = 0;
+    return s;
+}
+
+static iniparam_t* IniParamCreate( ini_t* ini, inidescr_t* descr, inistring_t* key, const char* val, ptrdiff_t vallen, const char* comment, ptrdiff_t commentlen ) {
+    iniparam_t* p;
+    ptrdiff_t valsize;
+    ptrdiff_t size;
+    
+    iniassert( ini );
+    
+    if( val && vallen < 0 ) {
+        vallen = strlen( val );
+    }
+    if( comment && commentlen < 0 ) {
+        commentlen = strlen( comment );
+    }
+    valsize = val && vallen ? INI_ALIGN(sizeof(inistring_t) + vallen + 1) : 0;
+    size = sizeof(iniparam_t) + valsize;
+    if( comment && commentlen ) {
+        size += sizeof(inistring_t) + commentlen + 1;
+    }
+    
+    p = (iniparam_t*)IniMalloc( ini, descr, INI_MTAG_PARAM, size );
+    p->next = NULL;
+    p->prev = NULL;
+    p->sect = NULL;
+    p->key = key;
+    p->value = valsize ? IniStringPlace( (char*)(p + 1), val, vallen ) : NULL;
+    p->comment = comment && commentlen ? IniStringPlace( (char*)(p + 1) + 
+        valsize, comment, commentlen ) : NULL;
+    return p;
+}
+
+/*
+================
+IniParamSize
+
+Размер памяти выделенной под параметр вместе с размещёнными в нём строками
+================
+*/
+static ptrdiff_t IniParamSize( const iniparam_t* p ) {
+    ptrdiff_t size = sizeof(iniparam_t);
+    if( p->value && !p->value->size ) {
+        size += INI_ALIGN(sizeof(inistring_t) + p->value->length + 1);
+    }
+    if( p->comment && !p->comment->size ) {
+        size += sizeof(inistring_t) + p->comment->length + 1;
+    }
+    return size;
+}
+
+/*
+================
+IniParamFree
+
+Освободить параметр вместе с ключом и строками. Память учитывается в
+статистике descr
+================
+*/
+static void IniParamFree( ini_t* ini, inidescr_t* descr, iniparam_t* p ) {
+    ptrdiff_t size;
+    
+    IniKeyIndexRemove( ini, p );
+    if( p->key ) {
+        IniAtomRelease( ini, p->key );
+    }
+    size = IniParamSize( p );
+    IniStringFree( ini, descr, p->value );
+    IniStringFree( ini, descr, p->comment );
+    IniMfree( ini, descr, INI_MTAG_PARAM, p, size );
+}
+
+/*
+================
+IniSectCreate
+
+  Если check не равен 0 и секция с таким названием уже есть, то новая
+секция не создаётся и возвращается существующая
+================
+*/
+static inisect_t* IniSectCreate( ini_t* ini, inidescr_t* descr, inistring_t* key, inistring_t* comment, int check ) {
+    inisect_t* s;
+    size_t start;
+    
+    iniassert( ini );
+    iniassert( key );
+    
+    if( check && (ini->flags & INI_FLAG_PARSING_LINE) ) {
+        start = IniLoadClock( ini );
+        s = IniFindSectAtom( ini, key );
+        IniLoadTime( ini, &descr->load.dupTime, start );
+    } else if( check ) {
+        s = IniFindSectAtom( ini, key );
+    } else {
+        s = NULL;
+    }
+    if( s ) {
+        IniAtomRelease( ini, key );
+        return s;
+    }
+    
+    s = (inisect_t*)IniMalloc( ini, descr, INI_MTAG_SECT, sizeof(inisect_t) );
+    s->next = NULL;
+    s->prev = NULL;
+    s->fnext = NULL;
+    s->fprev = NULL;
+    s->key = key;
+    s->comment = comment;
+    s->firstParam = NULL;
+    s->lastParam = NULL;
+    s->inherit = NULL;
+    s->inheritLast = NULL;
+    s->heirs = NULL;
+    s->heirsLast = NULL;
+    s->filename = NULL;
+    s->effective = NULL;
+    s->index = NULL;
+    s->id = -1;
+    s->line = 0;
+    s->ancestors = NULL;
+    s->descendants = NULL;
+    s->bloomOwn = NULL;
+    s->bloomAll = NULL;
+    s->mph = NULL;
+    s->keys = NULL;
+    return s;
+}
+
+/*
+================
+IniDescrCreate
+================
+*/
+static inidescr_t* IniDescrCreate( ini_t* ini, const char* filename, ptrdiff_t len ) {
+    inidescr_t* d;
+    
+    iniassert( ini );
+    iniassert( filename );
+    
+    // The descriptor counts its own memory too
+    inicalldbg( ini->inimemtag, INI_MTAG_DESCR );
+    d = (inidescr_t*)ini->inimalloc( sizeof(inidescr_t) );
+    memset( &d->mem, 0, sizeof(d->mem) );
+    memset( &d->load, 0, sizeof(d->load) );
+    d->load.files = 1;
+    IniMemCount( &d->mem, INI_MTAG_DESCR, sizeof(inidescr_t) );
+    IniMemCount( &ini->mem, INI_MTAG_DESCR, sizeof(inidescr_t) );
+    d->next = NULL;
+    d->ini = ini;
+    d->filename = IniStringCreate( ini, d, filename, len );
+    d->gsect = IniSectCreate( ini, d,
+        IniAtomCreate( ini, "_g", 2 ),
+        NULL, 0
+    );
+    d->lastSect = d->gsect;
+    d->gsect->filename = d;
+    return d;
+}
+
+/*
+================
+IniAppendDescr_s
+================
+*/
+static void IniAppendDescr_s( ini_t* ini, inidescr_t* descr ) {
+    iniassert( ini );
+    iniassert( descr );
+    iniassert( !(ini->filenames) == !(ini->lastfname) );
+    
+    if( ini->filenames ) {
+        ini->lastfname->next = descr;
+        ini->lastfname = descr;
+    } else {
+        ini->filenames = descr;
+        ini->lastfname = descr;
+    }
+}
+
+/*
+================
+IniEffectiveFind
+================
+*/
+static iniparam_t* IniEffectiveFind( const inieffective_t* e, const inistring_t* key ) {
+    ptrdiff_t i;
+    
+    iniassert( e );
+    iniassert( key );
+    
+    i = key->hash & (e->size - 1);
+    while( e->params[i] ) {
+        if( e->params[i]->key == key ) {
+            return e->params[i];
+        }
+        i = (i + 1) & (e->size - 1);
+    }
+    return NULL;
+}
+
+/*
+================
+IniEffectiveAlloc
+================
+*/
+static inieffective_t* IniEffectiveAlloc( ini_t* ini, inidescr_t* descr, ptrdiff_t size ) {
+    inieffective_t* e;
+    
+    e = (inieffective_t*)IniMalloc( ini, descr, INI_MTAG_EFFECTIVE, 
+        sizeof(inieffective_t) + size * sizeof(iniparam_t*) );
+    e->size = size;
+    e->count = 0;
+    memset( e->params, 0, size * sizeof(iniparam_t*) );
+    return e;
+}
+
+/*
+================
+IniEffectiveInsert
+
+  Добавить параметр в таблицу, если параметра с таким ключом в ней ещё нет.
+Таблица заполняется не больше чем наполовину
+================
+*/
+static void IniEffectiveInsert( ini_t* ini, inidescr_t* descr, inieffective_t** pe, iniparam_t* p ) {
+    inieffective_t* e;
+    inieffective_t* old;
+    ptrdiff_t i;
+    ptrdiff_t j;
+    
+    e = *pe;
+    i = p->key->hash & (e->size - 1);
+    while( e->params[i] ) {
+        if( e->params[i]->key == p->key ) {
+            return;
+        }
+        i = (i + 1) & (e->size - 1);
+    }
+    e->params[i] = p;
+    e->count++;
+    
+    if( e->count * 2 > e->size ) {
+        old = e;
+        e = IniEffectiveAlloc( ini, descr, old->size * 2 );
+        for( j = 0; j < old->size; j++ ) {
+            if( old->params[j] ) {
+                i = old->params[j]->key->hash & (e->size - 1);
+                while( e->params[i] ) {
+                    i = (i + 1) & (e->size - 1);
+                }
+                e->params[i] = old->params[j];
+            }
+        }
+        e->count = old->count;
+        IniMfree( ini, descr, INI_MTAG_EFFECTIVE, old, 
+            sizeof(inieffective_t) + old->size * sizeof(iniparam_t*) );
+        *pe = e;
+    }
+}
+
+/*
+================
+IniEffectiveFree
+================
+*/
+static void IniEffectiveFree( ini_t* ini, inisect_t* sect ) {
+    inieffective_t* e;
+    
+    if( (e = sect->effective) != NULL ) {
+        IniMfree( ini, sect->filename, INI_MTAG_EFFECTIVE, e, 
+            sizeof(inieffective_t) + e->size * sizeof(iniparam_t*) );
+        sect->effective = NULL;
+        ini->numEffective--;
+    }
+}
+
+/*
+================
+IniInvalidateSect
+
+  Удалить таблицу параметров секции и всех её наследников. Таблица
+наследника строится только вместе с таблицами унаследованных секций,
+поэтому у наследников секции без таблицы таблиц тоже нет
+================
+*/
+static void IniInvalidateSect( inisect_t* sect ) {
+    iniinh_t* heir;
+    
+    if( !sect->effective ) {
+        return;
+    }
+    IniEffectiveFree( sect->filename->ini, sect );
+    for( heir = sect->heirs; heir; heir = heir->next ) {
+        IniInvalidateSect( heir->inhSect );
+    }
+}
+
+/*
+================
+IniMaterialize
+
+  Построить таблицу параметров секции. Сначала строятся таблицы
+унаследованных секций, затем в таблицу добавляются свои параметры и
+параметры унаследованных секций по порядку, поэтому для каждого ключа в
+таблице остаётся тот же параметр, который находит IniFindParam
+================
+*/
+static inieffective_t IniEffectiveBusy;
+
+static void IniMaterialize( ini_t* ini, inisect_t* sect ) {
+    inieffective_t* e;
+    inieffective_t* pe;
+    iniinh_t* inh;
+    iniparam_t* p;
+    ptrdiff_t count;
+    ptrdiff_t size;
+    ptrdiff_t i;
+    
+    if( sect->effective ) {
+        return;
+    }
+    
+    // The mark breaks inheritance cycles, a section being built is seen as
+    // a section without parameters
+    sect->effective = &IniEffectiveBusy;
+    count = 0;
+    for( inh = sect->inherit; inh; inh = inh->next ) {
+        IniMaterialize( ini, inh->inhSect );
+        if( count < inh->inhSect->effective->count ) {
+            count = inh->inhSect->effective->count;
+        }
+    }
+    for( p = sect->firstParam; p; p = p->next ) {
+        count++;
+    }
+    for( size = 8; size < count * 2; size *= 2 );
+    
+    e = IniEffectiveAlloc( ini, sect->filename, size );
+    for( p = sect->firstParam; p; p = p->next ) {
+        if( p->key ) {
+            IniEffectiveInsert( ini, sect->filename, &e, p );
+        }
+    }
+    for( inh = sect->inherit; inh; inh = inh->next ) {
+        pe = inh->inhSect->effective;
+        for( i = 0; i < pe->size; i++ ) {
+            if( pe->params[i] ) {
+                IniEffectiveInsert( ini, sect->filename, &e, pe->params[i] );
+            }
+        }
+    }
+    sect->effective = e;
+    ini->numEffective++;
+}
+
+/*
+================
+IniKeyCompare
+
+  Сравнить ключ с строкой str длинной length побайтово. Если одна строка
+является началом другой, то меньше более короткая
+================
+*/
+static int IniKeyCompare( const inistring_t* key, const char* str, ptrdiff_t length ) {
+    int cmp;
+    
+    cmp = memcmp( key->string, str, key->length < length ? key->length : length );
+    if( cmp ) {
+        return cmp;
+    }
+    return key->length < length ? -1 : key->length > length;
+}
+
+#define INI_INDEX_KEY(item, offset) (*(inistring_t**)((char*)(item) + (offset)))
+
+/*
+================
+IniIndexSort
+
+  Сортировка слиянием элементов индекса по ключу, ключ элемента лежит по
+смещению offset. Элементы с одинаковыми ключами остаются в исходном порядке
+================
+*/
+static void IniIndexSort( void** items, void** tmp, ptrdiff_t n, ptrdiff_t offset ) {
+    void** src;
+    void** dst;
+    void** swap;
+    ptrdiff_t width;
+    ptrdiff_t lo;
+    ptrdiff_t mid;
+    ptrdiff_t hi;
+    ptrdiff_t i;
+    ptrdiff_t j;
+    ptrdiff_t k;
+    inistring_t* a;
+    inistring_t* b;
+    
+    src = items;
+    dst = tmp;
+    for( width = 1; width < n; width *= 2 ) {
+        for( lo = 0; lo < n; lo += width * 2 ) {
+            mid = lo + width < n ? lo + width : n;
+            hi = lo + width * 2 < n ? lo + width * 2 : n;
+            i = lo;
+            j = mid;
+            for( k = lo; k < hi; k++ ) {
+                if( i < mid && j < hi ) {
+                    a = INI_INDEX_KEY( src[i], offset );
+                    b = INI_INDEX_KEY( src[j], offset );
+                    dst[k] = a == b || IniKeyCompare( a, b->string, b->length ) <= 0 ? 
+                        src[i++] : src[j++];
+                } else {
+                    dst[k] = i < mid ? src[i++] : src[j++];
+                }
+            }
+        }
+        swap = src;
+        src = dst;
+        dst = swap;
+    }
+    if( src != items ) {
+        memcpy( items, src, n * sizeof(void*) );
+    }
+}
+
+/*
+================
+IniIndexCreate
+
+  Построить индекс из count элементов списка first (следующий элемент
+лежит по смещению nextOffset, ключ по смещению keyOffset). Элементы без
+ключа в индекс не попадают
+================
+*/
+static iniindex_t* IniIndexCreate( ini_t* ini, inidescr_t* descr, void* first, ptrdiff_t count, ptrdiff_t nextOffset, ptrdiff_t keyOffset ) {
+    iniindex_t* index;
+    void** tmp;
+    void* item;
+    
+    index = (iniindex_t*)IniMalloc( ini, descr, INI_MTAG_INDEX, 
+        sizeof(iniindex_t) + count * sizeof(void*) );
+    index->count = 0;
+    for( item = first; item; item = *(void**)((char*)item + nextOffset) ) {
+        if( INI_INDEX_KEY( item, keyOffset ) ) {
+            index->items[index->count++] = item;
+        }
+    }
+    iniassert( index->count <= count );
+    
+    if( index->count > 1 ) {
+        tmp = (void**)IniMalloc( ini, descr, INI_MTAG_INDEX, 
+            index->count * sizeof(void*) );
+        IniIndexSort( index->items, tmp, index->count, keyOffset );
+        IniMfree( ini, descr, INI_MTAG_INDEX, tmp, index->count * sizeof(void*) );
+    }
+    index->size = count;
+    return index;
+}
+
+/*
+================
+IniIndexFree
+================
+*/
+static void IniIndexFree( ini_t* ini, inidescr_t* descr, iniindex_t** pindex ) {
+    if( *pindex ) {
+        IniMfree( ini, descr, INI_MTAG_INDEX, *pindex, 
+            sizeof(iniindex_t) + (*pindex)->size * sizeof(void*) );
+        *pindex = NULL;
+    }
+}
+
+/*
+================
+IniIndexFreeAll
+
+  Удалить индекс секций и индексы параметров всех секций
+================
+*/
+static void IniIndexFreeAll( ini_t* ini ) {
+    inidescr_t* d;
+    inisect_t* s;
+    
+    IniIndexFree( ini, NULL, &ini->sectIndex );
+    IniKeyIndexFree( ini );
+    IniClosureFreeAll( ini );
+    for( d = ini->filenames; d; d = d->next ) {
+        for( s = d->gsect; s; s = s->fnext ) {
+            IniIndexFree( ini, d, &s->index );
+        }
+    }
+}
+
+/*
+================
+IniIndexLowerBound
+
+  Найти в индексе первый элемент, ключ которого не меньше строки str
+================
+*/
+static ptrdiff_t IniIndexLowerBound( const iniindex_t* index, ptrdiff_t keyOffset, const char* str, ptrdiff_t length ) {
+    ptrdiff_t lo;
+    ptrdiff_t hi;
+    ptrdiff_t mid;
+    
+    lo = 0;
+    hi = index->count;
+    while( lo < hi ) {
+        mid = lo + (hi - lo) / 2;
+        if( IniKeyCompare( INI_INDEX_KEY( index->items[mid], keyOffset ), 
+                str, length ) < 0 ) 
+        {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/*
+================
+IniIndexRange
+
+  Найти в индексе элементы, ключи которых начинаются с prefix длинной
+length. Элементы занимают в индексе промежуток [*start, *end)
+================
+*/
+static void IniIndexRange( const iniindex_t* index, ptrdiff_t keyOffset, const char* prefix, ptrdiff_t length, ptrdiff_t* start, ptrdiff_t* end ) {
+    ptrdiff_t lo;
+    ptrdiff_t hi;
+    ptrdiff_t mid;
+    inistring_t* key;
+    
+    lo = IniIndexLowerBound( index, keyOffset, prefix, length );
+    *start = lo;
+    
+    // The keys with the prefix follow each other after the lower bound
+    hi = index->count;
+    while( lo < hi ) {
+        mid = lo + (hi - lo) / 2;
+        key = INI_INDEX_KEY( index->items[mid], keyOffset );
+        if( key->length >= length && !memcmp( key->string, prefix, length ) ) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    *end = lo;
+}
+
+/*
+================
+IniGlobMatch
+
+  Сравнить строку с шаблоном: '*' - любое количество любых символов, '?' -
+один любой символ
+================
+*/
+static int IniGlobMatch( const char* pattern, const char* str ) {
+    const char* star;
+    const char* back;
+    
+    star = NULL;
+    back = NULL;
+    while( *str ) {
+        if( *pattern == '*' ) {
+            star = ++pattern;
+            back = str;
+        } else if( *pattern == '?' || *pattern == *str ) {
+            pattern++;
+            str++;
+        } else if( star ) {
+            pattern = star;
+            str = ++back;
+        } else {
+            return 0;
+        }
+    }
+    while( *pattern == '*' ) {
+        pattern++;
+    }
+    return !*pattern;
+}
+
+/*
+================
+IniSectIndex
+
+  Получить индекс секций, индекс строится при первом обращении после
+изменения списка секций
+================
+*/
+static iniindex_t* IniSectIndex( ini_t* ini ) {
+    inisect_t* s;
+    ptrdiff_t count;
+    
+    if( !ini->sectIndex ) {
+        count = 0;
+        for( s = ini->firstSect; s; s = s->next ) {
+            count++;
+        }
+        ini->sectIndex = IniIndexCreate( ini, NULL, ini->firstSect, count, 
+            offsetof(inisect_t, next), offsetof(inisect_t, key) );
+    }
+    return ini->sectIndex;
+}
+
+/*
+================
+IniParamIndex
+================
+*/
+static iniindex_t* IniParamIndex( inisect_t* sect ) {
+    iniparam_t* p;
+    ptrdiff_t count;
+    
+    if( !sect->index ) {
+        count = 0;
+        for( p = sect->firstParam; p; p = p->next ) {
+            count++;
+        }
+        sect->index = IniIndexCreate( sect->filename->ini, sect->filename, 
+            sect->firstParam, count, 
+            offsetof(iniparam_t, next), offsetof(iniparam_t, key) );
+    }
+    return sect->index;
+}
+
+/*
+================
+IniBloomHas
+
+  Проверить ключ по фильтру Блума. Биты ключа берутся из хеша
+интернированной строки (три бита двойным хешированием)
+================
+*/
+static int IniBloomHas( const size_t* bloom, ptrdiff_t bits, const inistring_t* key ) {
+    unsigned h;
+    unsigned step;
+    ptrdiff_t bit;
+    int i;
+    
+    h = key->hash;
+    step = (h >> 17 | h << 15) | 1;
+    for( i = 0; i < 3; i++, h += step ) {
+        bit = h & (bits - 1);
+        if( !INI_CLOSURE_HAS( bloom, bit ) ) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void IniBloomAdd( size_t* bloom, ptrdiff_t bits, const inistring_t* key ) {
+    unsigned h;
+    unsigned step;
+    ptrdiff_t bit;
+    int i;
+    
+    h = key->hash;
+    step = (h >> 17 | h << 15) | 1;
+    for( i = 0; i < 3; i++, h += step ) {
+        bit = h & (bits - 1);
+        INI_CLOSURE_SET( bloom, bit );
+    }
+}
+
+/*
+================
+IniBloomFree
+
+  Удалить фильтры секции. Общий фильтр наследников строится только вместе с
+общими фильтрами унаследованных секций, поэтому у наследников секции без
+общего фильтра его тоже нет
+================
+*/
+static void IniBloomFree( ini_t* ini, inisect_t* sect ) {
+    ptrdiff_t size;
+    
+    size = ini->bloomBits / 8;
+    if( sect->bloomOwn ) {
+        IniMfree( ini, sect->filename, INI_MTAG_BLOOM, sect->bloomOwn, size );
+        sect->bloomOwn = NULL;
+    }
+    if( sect->bloomAll ) {
+        IniMfree( ini, sect->filename, INI_MTAG_BLOOM, sect->bloomAll, size );
+        sect->bloomAll = NULL;
+    }
+}
+
+static void IniBloomInvalidate( ini_t* ini, inisect_t* sect ) {
+    iniinh_t* heir;
+    
+    if( !sect->bloomAll ) {
+        return;
+    }
+    IniMfree( ini, sect->filename, INI_MTAG_BLOOM, sect->bloomAll, ini->bloomBits / 8 );
+    sect->bloomAll = NULL;
+    for( heir = sect->heirs; heir; heir = heir->next ) {
+        IniBloomInvalidate( ini, heir->inhSect );
+    }
+}
+
+static void IniBloomFreeAll( ini_t* ini ) {
+    inidescr_t* d;
+    inisect_t* s;
+    
+    if( !ini->bloomBits ) {
+        return;
+    }
+    for( d = ini->filenames; d; d = d->next ) {
+        for( s = d->gsect; s; s = s->fnext ) {
+            IniBloomFree( ini, s );
+        }
+    }
+}
+
+/*
+================
+IniBloomAddKey
+
+  Добавить ключ нового параметра секции в её фильтры и в общие фильтры
+наследников. Удалённые ключи из фильтров не убираются: это даёт только
+ложные срабатывания, но не пропуски
+================
+*/
+static void IniBloomAddKey( ini_t* ini, inisect_t* sect, const inistring_t* key ) {
+    iniinh_t* heir;
+    
+    if( sect->bloomOwn ) {
+        IniBloomAdd( sect->bloomOwn, ini->bloomBits, key );
+    }
+    if( !sect->bloomAll ) {
+        return;
+    }
+    IniBloomAdd( sect->bloomAll, ini->bloomBits, key );
+    for( heir = sect->heirs; heir; heir = heir->next ) {
+        IniBloomAddKey( ini, heir->inhSect, key );
+    }
+}
+
+/*
+================
+IniBloomBuild
+
+  Построить фильтры секции: фильтр своих ключей и общий фильтр ключей
+секции и всех её предков (объединение общих фильтров унаследованных
+секций). Функция возвращает -1, если секция входит в цикл наследования,
+такие секции ищутся без общего фильтра
+================
+*/
+static size_t IniBloomBusy[1];
+
+static int IniBloomBuild( ini_t* ini, inisect_t* sect ) {
+    iniinh_t* inh;
+    iniparam_t* p;
+    size_t* all;
+    ptrdiff_t words;
+    ptrdiff_t i;
+    int ret;
+    
+    if( sect->bloomAll == IniBloomBusy ) {
+        return -1;
+    }
+    if( sect->bloomAll ) {
+        return 0;
+    }
+    
+    words = ini->bloomBits / INI_WORD_BITS;
+    if( !sect->bloomOwn ) {
+        sect->bloomOwn = (size_t*)IniMalloc( ini, sect->filename, INI_MTAG_BLOOM, 
+            words * sizeof(size_t) );
+        memset( sect->bloomOwn, 0, words * sizeof(size_t) );
+        for( p = sect->firstParam; p; p = p->next ) {
+            if( p->key ) {
+                IniBloomAdd( sect->bloomOwn, ini->bloomBits, p->key );
+            }
+        }
+    }
+    
+    sect->bloomAll = IniBloomBusy;
+    ret = 0;
+    for( inh = sect->inherit; inh; inh = inh->next ) {
+        if( IniBloomBuild( ini, inh->inhSect ) < 0 ) {
+            ret = -1;
+        }
+    }
+    if( ret < 0 ) {
+        sect->bloomAll = NULL;
+        return ret;
+    }
+    
+    all = (size_t*)IniMalloc( ini, sect->filename, INI_MTAG_BLOOM, 
+        words * sizeof(size_t) );
+    memcpy( all, sect->bloomOwn, words * sizeof(size_t) );
+    for( inh = sect->inherit; inh; inh = inh->next ) {
+        for( i = 0; i < words; i++ ) {
+            all[i] |= inh->inhSect->bloomAll[i];
+        }
+    }
+    sect->bloomAll = all;
+    return 0;
+}
+
+/*
+================
+IniMphBuild
+
+  Построить таблицу идеального хеширования (CHD) для count элементов items
+с разными ключами (ключ элемента лежит по смещению keyOffset). Элементы
+раскладываются по корзинам по хешу h2, затем корзины по убыванию размера
+получают число seed, при котором их элементы попадают в свободные места
+таблицы. Корзинам из одного элемента место записывается напрямую. Функция
+возвращает NULL, если таблицу построить не удалось
+================
+*/
+static inimph_t* IniMphBuild( ini_t* ini, inidescr_t* descr, void** items, ptrdiff_t count, ptrdiff_t keyOffset ) {
+    inimph_t* mph;
+    inistring_t* key;
+    unsigned* h1;
+    unsigned* h2;
+    ptrdiff_t* start;
+    ptrdiff_t* order;
+    ptrdiff_t* bySize;
+    ptrdiff_t* slots;
+    char* taken;
+    char* tmp;
+    ptrdiff_t tmpSize;
+    ptrdiff_t buckets;
+    ptrdiff_t maxSize;
+    ptrdiff_t size;
+    ptrdiff_t b;
+    ptrdiff_t i;
+    ptrdiff_t j;
+    ptrdiff_t k;
+    ptrdiff_t freeSlot;
+    ptrdiff_t nonEmpty;
+    unsigned seed;
+    
+    iniassert( count > 0 );
+    
+    buckets = (count + INI_MPH_BUCKET - 1) / INI_MPH_BUCKET;
+    mph = (inimph_t*)IniMalloc( ini, descr, INI_MTAG_MPH, sizeof(inimph_t) + 
+        count * sizeof(void*) + buckets * sizeof(unsigned) );
+    mph->size = count;
+    mph->buckets = buckets;
+    mph->seeds = (unsigned*)(mph->items + count);
+    
+    // Temporary arrays: hashes, bucket starts, keys ordered by bucket,
+    // buckets ordered by size, slots of a bucket and taken slots
+    tmpSize = count * (2 * sizeof(unsigned) + 2 * sizeof(ptrdiff_t) + 1) + 
+        (buckets + 1) * 2 * sizeof(ptrdiff_t);
+    tmp = (char*)IniMalloc( ini, NULL, INI_MTAG_MPH, tmpSize );
+    h1 = (unsigned*)tmp;
+    h2 = h1 + count;
+    start = (ptrdiff_t*)(h2 + count);
+    order = start + buckets + 1;
+    bySize = order + count;
+    slots = bySize + buckets + 1;
+    taken = (char*)(slots + count);
+    memset( start, 0, (buckets + 1) * sizeof(ptrdiff_t) );
+    memset( taken, 0, count );
+    
+    for( i = 0; i < count; i++ ) {
+        key = INI_INDEX_KEY( items[i], keyOffset );
+        h1[i] = key->hash;
+        h2[i] = IniHash2( key->string, key->length );
+        start[h2[i] % (unsigned)buckets + 1]++;
+    }
+    maxSize = 0;
+    for( b = 0; b < buckets; b++ ) {
+        if( maxSize < start[b + 1] ) {
+            maxSize = start[b + 1];
+        }
+        start[b + 1] += start[b];
+    }
+    for( i = 0; i < count; i++ ) {
+        b = h2[i] % (unsigned)buckets;
+        order[start[b]++] = i;
+    }
+    for( b = buckets; b > 0; b-- ) {
+        start[b] = start[b - 1];
+    }
+    start[0] = 0;
+    
+    // Largest buckets are placed first, while the table is still empty
+    k = 0;
+    for( size = maxSize; size > 0; size-- ) {
+        for( b = 0; b < buckets; b++ ) {
+            if( start[b + 1] - start[b] == size ) {
+                bySize[k++] = b;
+            }
+        }
+    }
+    memset( mph->seeds, 0, buckets * sizeof(unsigned) );
+    
+    // Empty buckets are not in bySize
+    nonEmpty = k;
+    freeSlot = 0;
+    for( k = 0; k < nonEmpty; k++ ) {
+        b = bySize[k];
+        size = start[b + 1] - start[b];
+        if( size == 1 ) {
+            while( taken[freeSlot] ) {
+                freeSlot++;
+            }
+            taken[freeSlot] = 1;
+            mph->items[freeSlot] = items[order[start[b]]];
+            mph->seeds[b] = (unsigned)freeSlot | INI_MPH_DIRECT;
+            continue;
+        }
+        for( seed = 0; seed < INI_MPH_MAX_SEED; seed++ ) {
+            for( i = 0; i < size; i++ ) {
+                j = order[start[b] + i];
+                slots[i] = IniMphMix( h1[j], h2[j], seed ) % (unsigned)count;
+                if( taken[slots[i]] ) {
+                    break;
+                }
+                taken[slots[i]] = 1;
+            }
+            if( i == size ) {
+                break;
+            }
+            // The slots taken by this attempt are released
+            while( i-- > 0 ) {
+                taken[slots[i]] = 0;
+            }
+        }
+        if( seed == INI_MPH_MAX_SEED ) {
+            IniMfree( ini, NULL, INI_MTAG_MPH, tmp, tmpSize );
+            IniMfree( ini, descr, INI_MTAG_MPH, mph, sizeof(inimph_t) + 
+                count * sizeof(void*) + buckets * sizeof(unsigned) );
+            return NULL;
+        }
+        mph->seeds[b] = seed;
+        for( i = 0; i < size; i++ ) {
+            mph->items[slots[i]] = items[order[start[b] + i]];
+        }
+    }
+    
+    IniMfree( ini, NULL, INI_MTAG_MPH, tmp, tmpSize );
+    ini->numMph++;
+    return mph;
+}
+
+/*
+================
+IniMphFree
+================
+*/
+static void IniMphFree( ini_t* ini, inidescr_t* descr, inimph_t** pmph ) {
+    if( *pmph ) {
+        IniMfree( ini, descr, INI_MTAG_MPH, *pmph, sizeof(inimph_t) + 
+            (*pmph)->size * sizeof(void*) + (*pmph)->buckets * sizeof(unsigned) );
+        *pmph = NULL;
+        ini->numMph--;
+    }
+}
+
+/*
+================
+IniMphCollect
+
+  Собрать в items элементы списка с первыми вхождениями ключей (их же
+находит поиск по списку). Функция возвращает количество элементов
+================
+*/
+static ptrdiff_t IniMphCollect( ini_t* ini, void* first, ptrdiff_t nextOffset, ptrdiff_t keyOffset, void** items ) {
+    iniptrset_t keys;
+    inistring_t* key;
+    ptrdiff_t count;
+    void* item;
+    
+    IniPtrSetInit( ini, &keys );
+    count = 0;
+    for( item = first; item; item = *(void**)((char*)item + nextOffset) ) {
+        key = INI_INDEX_KEY( item, keyOffset );
+        if( key && IniPtrSetAdd( &keys, key ) ) {
+            items[count++] = item;
+        }
+    }
+    IniPtrSetFree( &keys );
+    return count;
+}
+
+/*
+================
+IniKeysSize
+================
+*/
+static ptrdiff_t IniKeysSize( ptrdiff_t size ) {
+    return sizeof(inikeys_t) + size * (sizeof(iniparam_t*) + 2 * sizeof(unsigned));
+}
+
+/*
+================
+IniKeysFree
+================
+*/
+static void IniKeysFree( ini_t* ini, inidescr_t* descr, inikeys_t** pkeys ) {
+    if( *pkeys ) {
+        IniMfree( ini, descr, INI_MTAG_KEYS, *pkeys, IniKeysSize( (*pkeys)->size ) );
+        *pkeys = NULL;
+    }
+}
+
+/*
+================
+IniKeysResize
+================
+*/
+static inikeys_t* IniKeysResize( ini_t* ini, inidescr_t* descr, inikeys_t* keys, ptrdiff_t size ) {
+    inikeys_t* nkeys;
+    
+    nkeys = (inikeys_t*)IniMalloc( ini, descr, INI_MTAG_KEYS, IniKeysSize( size ) );
+    nkeys->size = size;
+    nkeys->count = 0;
+    nkeys->lookups = 0;
+    nkeys->hashes = (unsigned*)(nkeys->params + size);
+    nkeys->hits = nkeys->hashes + size;
+    if( keys ) {
+        nkeys->count = keys->count;
+        nkeys->lookups = keys->lookups;
+        memcpy( nkeys->params, keys->params, keys->count * sizeof(iniparam_t*) );
+        memcpy( nkeys->hashes, keys->hashes, keys->count * sizeof(unsigned) );
+        memcpy( nkeys->hits, keys->hits, keys->count * sizeof(unsigned) );
+        IniKeysFree( ini, descr, &keys );
+    }
+    return nkeys;
+}
+
+/*
+================
+IniKeysBuild
+
+  Построить массив ключей по списку параметров секции, если в ней не меньше
+INI_KEYS_MIN_PARAMS параметров. Массив выделяется ровно по числу параметров
+================
+*/
+static void IniKeysBuild( ini_t* ini, inisect_t* sect ) {
+    inikeys_t* keys;
+    iniparam_t* p;
+    ptrdiff_t count;
+    
+    iniassert( !sect->keys );
+    
+    // Small sections are searched through the list
+    count = 0;
+    for( p = sect->firstParam; p && count < INI_KEYS_MIN_PARAMS; p = p->next ) {
+        count++;
+    }
+    if( count < INI_KEYS_MIN_PARAMS ) {
+        return;
+    }
+    for( ; p; p = p->next ) {
+        count++;
+    }
+    keys = IniKeysResize( ini, sect->filename, NULL, count );
+    for( p = sect->firstParam; p; p = p->next ) {
+        keys->params[keys->count] = p;
+        keys->hashes[keys->count] = p->key ? p->key->hash : 0;
+        keys->hits[keys->count] = 0;
+        keys->count++;
+    }
+    sect->keys = keys;
+}
+
+/*
+================
+IniKeysAdd
+
+  Добавить параметр, уже стоящий в конце списка секции, в массив ключей.
+Пока секция растёт, массив увеличивается вдвое, после загрузки он ужимается
+до числа параметров (см. IniKeysTrimAll). Секции с таблицей IniFreeze
+массив не нужен, он строится заново при удалении таблицы
+================
+*/
+static void IniKeysAdd( ini_t* ini, inisect_t* sect, iniparam_t* param ) {
+    inikeys_t* keys;
+    
+    iniassert( sect->lastParam == param );
+    
+    keys = sect->keys;
+    if( !keys ) {
+        IniKeysBuild( ini, sect );
+        return;
+    }
+    
+    if( keys->count == keys->size ) {
+        keys = IniKeysResize( ini, sect->filename, keys, keys->size * 2 );
+        sect->keys = keys;
+    }
+    keys->params[keys->count] = param;
+    keys->hashes[keys->count] = param->key ? param->key->hash : 0;
+    keys->hits[keys->count] = 0;
+    keys->count++;
+}
+
+/*
+================
+IniKeysTrimAll
+
+  Ужать массивы ключей до числа параметров после загрузки. Массивы секций,
+в которых после удалений осталось меньше INI_KEYS_MIN_PARAMS параметров,
+освобождаются
+================
+*/
+static void IniKeysTrimAll( ini_t* ini ) {
+    inidescr_t* d;
+    inisect_t* s;
+    
+    for( d = ini->filenames; d; d = d->next ) {
+        for( s = d->gsect; s; s = s->fnext ) {
+            if( !s->keys || s->keys->size == s->keys->count ) {
+                continue;
+            }
+            if( s->keys->count < INI_KEYS_MIN_PARAMS ) {
+                IniKeysFree( ini, d, &s->keys );
+            } else {
+                s->keys = IniKeysResize( ini, d, s->keys, s->keys->count );
+            }
+        }
+    }
+}
+
+/*
+================
+IniKeysRemove
+================
+*/
+static void IniKeysRemove( inikeys_t* keys, iniparam_t* param ) {
+    ptrdiff_t i;
+    
+    for( i = 0; i < keys->count && keys->params[i] != param; i++ );
+    iniassert( i < keys->count );
+    
+    keys->count--;
+    memmove( keys->params + i, keys->params + i + 1, 
+        (keys->count - i) * sizeof(iniparam_t*) );
+    memmove( keys->hashes + i, keys->hashes + i + 1, 
+        (keys->count - i) * sizeof(unsigned) );
+    memmove( keys->hits + i, keys->hits + i + 1, 
+        (keys->count - i) * sizeof(unsigned) );
+}
+
+/*
+================
+IniKeysReorder
+
+  Упорядочить ключи по убыванию счётчиков обращений и поделить счётчики
+пополам. Сортировка вставками устойчива: повторный ключ никогда не находится
+и не обгоняет первый, поэтому поиск находит тот же параметр что и по списку.
+Деление пополам сохраняет порядок, и следующая сортировка почти ничего не
+переставляет
+================
+*/
+static void IniKeysReorder( inikeys_t* keys ) {
+    iniparam_t* param;
+    unsigned hash;
+    unsigned hits;
+    ptrdiff_t i;
+    ptrdiff_t j;
+    
+    for( i = 1; i < keys->count; i++ ) {
+        param = keys->params[i];
+        hash = keys->hashes[i];
+        hits = keys->hits[i];
+        for( j = i; j > 0 && keys->hits[j - 1] < hits; j-- ) {
+            keys->params[j] = keys->params[j - 1];
+            keys->hashes[j] = keys->hashes[j - 1];
+            keys->hits[j] = keys->hits[j - 1];
+        }
+        keys->params[j] = param;
+        keys->hashes[j] = hash;
+        keys->hits[j] = hits;
+    }
+    for( i = 0; i < keys->count; i++ ) {
+        keys->hits[i] >>= 1;
+    }
+    keys->lookups = 0;
+}
+
+/*
+================
+IniKeysFind
+
+  Найти первый параметр с ключом key. Хеши сравниваются по четыре за раз
+(SSE2), совпавшие проверяются сравнением указателей на ключи. Функция
+возвращает номер параметра в массиве или -1
+================
+*/
+static ptrdiff_t IniKeysFind( const inikeys_t* keys, const inistring_t* key ) {
+    ptrdiff_t i;
+#ifdef INI_SSE2
+    __m128i hash;
+    unsigned mask;
+    ptrdiff_t j;
+#endif
+    
+    i = 0;
+#ifdef INI_SSE2
+    hash = _mm_set1_epi32( (int)key->hash );
+    for( ; i + 4 <= keys->count; i += 4 ) {
+        // Every equal hash sets four mask bits, lower keys go first
+        mask = (unsigned)_mm_movemask_epi8( _mm_cmpeq_epi32( hash, 
+            _mm_loadu_si128( (const __m128i*)(keys->hashes + i) ) ) );
+        for( j = i; mask; j++, mask >>= 4 ) {
+            if( (mask & 1) && keys->params[j]->key == key ) {
+                return j;
+            }
+        }
+    }
+#endif
+    for( ; i < keys->count; i++ ) {
+        if( keys->hashes[i] == key->hash && keys->params[i]->key == key ) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+================
+IniSectMphFree
+
+  Удалить таблицу IniFreeze секции, поиск снова идёт по массиву ключей
+================
+*/
+static void IniSectMphFree( ini_t* ini, inisect_t* sect ) {
+    if( sect->mph ) {
+        IniMphFree( ini, sect->filename, &sect->mph );
+        if( !sect->keys ) {
+            IniKeysBuild( ini, sect );
+        }
+    }
+}
+
+static void IniMphFreeAll( ini_t* ini ) {
+    inidescr_t* d;
+    inisect_t* s;
+    
+    if( !ini->numMph ) {
+        return;
+    }
+    IniMphFree( ini, NULL, &ini->sectMph );
+    for( d = ini->filenames; d; d = d->next ) {
+        for( s = d->gsect; s; s = s->fnext ) {
+            IniSectMphFree( ini, s );
+        }
+    }
+}
+
+/*
+================
+IniAppendSect_s
+================
+*/
+static void IniAppendSect_s( inidescr_t* descr, inisect_t* sect ) {
+    ini_t* ini;
+    
+    iniassert( descr );
+    iniassert( sect );
+    iniassert( descr->ini );
+    //iniassert( !sect->filename );
+    
+    if( sect->filename ) {
+        return;
+    }
+    
+    ini = descr->ini;
+    sect->prev = ini->lastSect;
+    if( ini->firstSect ) {
+        ini->lastSect->next = sect;
+        ini->lastSect = sect;
+    } else {
+        ini->firstSect = sect;
+        ini->lastSect = sect;
+    }
+    // The file list always starts with the global section
+    sect->fprev = descr->lastSect;
+    descr->lastSect->fnext = sect;
+    descr->lastSect = sect;
+    sect->filename = descr;
+    IniSectTableAdd( ini, sect );
+    IniSectIdAlloc( ini, sect );
+    IniIndexFree( ini, NULL, &ini->sectIndex );
+    IniMphFree( ini, NULL, &ini->sectMph );
+}
+
+/*
+================
+IniUnlinkSect_s
+
+  Исключить секцию из общего списка и из списка секций файла
+================
+*/
+static void IniUnlinkSect_s( inisect_t* sect ) {
+    ini_t* ini;
+    inidescr_t* descr;
+    
+    iniassert( sect );
+    iniassert( sect->fprev );
+    
+    descr = sect->filename;
+    ini = descr->ini;
+    
+    // Merged duplicates have no key, they are never in the table
+    if( sect->key ) {
+        IniSectTableRemove( ini, sect );
+    }
+    if( sect->prev ) {
+        sect->prev->next = sect->next;
+    } else {
+        ini->firstSect = sect->next;
+    }
+    if( sect->next ) {
+        sect->next->prev = sect->prev;
+    } else {
+        ini->lastSect = sect->prev;
+    }
+    
+    sect->fprev->fnext = sect->fnext;
+    if( sect->fnext ) {
+        sect->fnext->fprev = sect->fprev;
+    } else {
+        descr->lastSect = sect->fprev;
+    }
+    
+    sect->next = NULL;
+    sect->prev = NULL;
+    sect->fnext = NULL;
+    sect->fprev = NULL;
+    IniIndexFree( ini, NULL, &ini->sectIndex );
+    IniMphFree( ini, NULL, &ini->sectMph );
+}
+
+/*
+================
+IniAppendParam_s
+================
+*/
+static void IniAppendParam_s( inisect_t* sect, iniparam_t* param ) {
+    iniassert( sect );
+    iniassert( param );
+    iniassert( !(sect->firstParam) == !(sect->lastParam) );
+    
+    param->sect = sect;
+    param->prev = sect->lastParam;
+    if( sect->firstParam ) {
+        sect->lastParam->next = param;
+        sect->lastParam = param;
+    } else {
+        sect->firstParam = param;
+        sect->lastParam = param;
+    }
+    // Lookup structures are only built for sections in a file
+    if( sect->filename ) {
+        IniKeyIndexAdd( sect->filename->ini, param );
+        IniKeysAdd( sect->filename->ini, sect, param );
+        if( param->key ) {
+            IniBloomAddKey( sect->filename->ini, sect, param->key );
+        }
+        if( sect->index ) {
+            IniIndexFree( sect->filename->ini, sect->filename, &sect->index );
+        }
+        IniSectMphFree( sect->filename->ini, sect );
+    }
+    IniInvalidateSect( sect );
+}
+
+/*
+================
+IniUnlinkParam_s
+================
+*/
+static void IniUnlinkParam_s( iniparam_t* param ) {
+    inisect_t* sect;
+    
+    iniassert( param );
+    iniassert( param->sect );
+    
+    sect = param->sect;
+    if( param->prev ) {
+        param->prev->next = param->next;
+    } else {
+        sect->firstParam = param->next;
+    }
+    if( param->next ) {
+        param->next->prev = param->prev;
+    } else {
+        sect->lastParam = param->prev;
+    }
+    param->next = NULL;
+    param->prev = NULL;
+    if( sect->keys ) {
+        IniKeysRemove( sect->keys, param );
+    }
+    if( sect->index ) {
+        IniIndexFree( sect->filename->ini, sect->filename, &sect->index );
+    }
+    IniSectMphFree( sect->filename->ini, sect );
+    IniInvalidateSect( sect );
+}
+
+/*
+================
+IniAppendInh_s
+
+  Добавить элемент в конец списка наследованных секций или наследников
+================
+*/
+static void IniAppendInh_s( iniinh_t** first, iniinh_t** last, iniinh_t* inh ) {
+    iniassert( inh );
+    iniassert( !(*first) == !(*last) );
+    
+    inh->next = NULL;
+    inh->prev = *last;
+    if( *first ) {
+        (*last)->next = inh;
+    } else {
+        *first = inh;
+    }
+    *last = inh;
+}
+
+/*
+================
+IniUnlinkInh_s
+
+  Исключить элемент из списка наследованных секций или наследников
+================
+*/
+static void IniUnlinkInh_s( iniinh_t** first, iniinh_t** last, iniinh_t* inh ) {
+    iniassert( inh );
+    
+    if( inh->prev ) {
+        inh->prev->next = inh->next;
+    } else {
+        *first = inh->next;
+    }
+    if( inh->next ) {
+        inh->next->prev = inh->prev;
+    } else {
+        *last = inh->prev;
+    }
+    inh->next = NULL;
+    inh->prev = NULL;
+}
+
+/*
+================
+IniExcludeLink
+
+  Удалить связь наследования: элемент inh из списка наследованных секций
+наследника и парный ему элемент из списка наследников родителя
+================
+*/
+static void IniExcludeLink( iniinh_t* inh ) {
+    ini_t* ini;
+    iniinh_t* heir;
+    inisect_t* sect;
+    inisect_t* parent;
+    
+    iniassert( inh );
+    iniassert( inh->twin && inh->twin->twin == inh );
+    
+    heir = inh->twin;
+    sect = inh->sect;
+    parent = heir->sect;
+    ini = sect->filename->ini;
+    
+    IniClosureUnlink( sect, parent );
+    IniUnlinkInh_s( &sect->inherit, &sect->inheritLast, inh );
+    IniUnlinkInh_s( &parent->heirs, &parent->heirsLast, heir );
+    IniInvalidateSect( sect );
+    
+    IniMfree( ini, parent->filename, INI_MTAG_HEIR, heir, sizeof(iniinh_t) );
+    IniMfree( ini, sect->filename, INI_MTAG_INHERIT, inh, sizeof(iniinh_t) );
+}
+
+/*
+================
+IniFindOnlyInSect
+================
+*/
+static iniparam_t* IniFindOnlyInSect( inisect_t* sect, const inistring_t* key ) {
+    iniparam_t* p;
+    inikeys_t* keys;
+    ptrdiff_t i;
+    
+    iniassert( sect );
+    iniassert( key );
+    
+    if( sect->mph ) {
+        p = (iniparam_t*)sect->mph->items[IniMphSlot( sect->mph, 
+            key->hash, IniHash2( key->string, key->length ) )];
+        return p->key == key ? p : NULL;
+    }
+    if( sect->keys ) {
+        keys = sect->keys;
+        i = IniKeysFind( keys, key );
+        p = i >= 0 ? keys->params[i] : NULL;
+        if( sect->filename->ini->flags & INI_FLAG_ADAPTIVE_LOOKUP ) {
+            if( p ) {
+                keys->hits[i]++;
+            }
+            if( ++keys->lookups >= keys->count * INI_KEYS_REORDER_PERIOD ) {
+                IniKeysReorder( keys );
+            }
+        }
+        return p;
+    }
+    
+    // Keys are interned, equal keys are the same string
+    p = sect->firstParam;
+    while( p ) {
+        if( p->key == key ) {
+            return p;
+        }
+        p = p->next;
+    }
+    return NULL;
+}
+
+/*
+================
+IniFindInInherit
+================
+*/
+static iniparam_t* IniFindInInherit( inisect_t* sect, const inistring_t* key, ptrdiff_t* walked ) {
+    iniinh_t* inh;
+    iniparam_t* p;
+    
+    iniassert( sect );
+    
+    inh = sect->inherit;
+    while( inh ) {
+        (*walked)++;
+        // The filters of the inherited section reject the whole branch or
+        // only its own parameters
+        if( inh->inhSect->bloomAll && inh->inhSect->bloomAll != IniBloomBusy && 
+            !IniBloomHas( inh->inhSect->bloomAll, 
+            inh->inhSect->filename->ini->bloomBits, key ) ) 
+        {
+            inh = inh->next;
+            continue;
+        }
+        if( !inh->inhSect->bloomOwn || IniBloomHas( inh->inhSect->bloomOwn, 
+            inh->inhSect->filename->ini->bloomBits, key ) ) 
+        {
+            p = IniFindOnlyInSect( inh->inhSect, key );
+            if( p ) {
+                return p;
+            }
+        }
+        p = IniFindInInherit( inh->inhSect, key, walked );
+        if( p ) {
+            return p;
+        }
+        inh = inh->next;
+    }
+    
+    return NULL;
+}
+
+/*
+================
+IniFindParamWalk
+
+  Найти параметр с учётом наследования, в walked прибавляется количество
+просмотренных предков
+================
+*/
+static iniparam_t* IniFindParamWalk( inisect_t* sect, const inistring_t* key, ptrdiff_t* walked ) {
+    ini_t* ini;
+    iniparam_t* p;
+    
+    if( sect->effective ) {
+        return IniEffectiveFind( sect->effective, key );
+    }
+    ini = sect->filename->ini;
+    if( ini->bloomBits && IniBloomBuild( ini, sect ) == 0 ) {
+        ini->bloom.checks++;
+        if( !IniBloomHas( sect->bloomAll, ini->bloomBits, key ) ) {
+            ini->bloom.negatives++;
+            return NULL;
+        }
+    }
+    p = IniFindOnlyInSect( sect, key );
+    if( !p ) {
+        p = IniFindInInherit( sect, key, walked );
+    }
+    if( !p && sect->bloomAll ) {
+        ini->bloom.falsePositives++;
+    }
+    return p;
+}
+
+/*
+================
+IniFindParamAtom
+================
+*/
+static iniparam_t* IniFindParamAtom( inisect_t* sect, const inistring_t* key ) {
+    ptrdiff_t walked;
+    
+    walked = 0;
+    return IniFindParamWalk( sect, key, &walked );
+}
+
+/*
+================
+IniProfTableCreate
+================
+*/
+static iniproftable_t* IniProfTableCreate( ini_t* ini, ptrdiff_t size ) {
+    iniproftable_t* table;
+    
+    table = (iniproftable_t*)ini->inimalloc( sizeof(iniproftable_t) + 
+        size * sizeof(iniprofentry_t*) );
+    table->retired = NULL;
+    table->size = size;
+    table->count = 0;
+    memset( table->items, 0, size * sizeof(iniprofentry_t*) );
+    return table;
+}
+
+/*
+================
+IniProfThread
+
+  Счётчики текущего потока. Поток помнит счётчики нескольких последних ini;
+ini и поколение профиля сверяются до обращения к счётчикам, поэтому
+счётчики удалённого ini или сброшенного профиля никогда не читаются
+================
+*/
+static iniprofthread_t* IniProfThread( ini_t* ini ) {
+    iniprofslot_t* slot;
+    iniprofthread_t* rec;
+    int i;
+    
+    for( i = 0; i < INI_PROF_SLOTS; i++ ) {
+        slot = iniProfSlots + i;
+        if( slot->ini == ini && slot->id == ini->profId ) {
+            return slot->rec;
+        }
+    }
+    
+    rec = (iniprofthread_t*)ini->inimalloc( sizeof(iniprofthread_t) );
+    rec->table = IniProfTableCreate( ini, INI_PROF_MIN_TABLE );
+    do {
+        rec->next = (iniprofthread_t*)INI_ATOMIC_ACQUIRE( &ini->profThreads );
+    } while( !INI_ATOMIC_CAS( &ini->profThreads, rec->next, rec ) );
+    
+    slot = iniProfSlots + iniProfNextSlot++ % INI_PROF_SLOTS;
+    slot->ini = ini;
+    slot->id = ini->profId;
+    slot->rec = rec;
+    return rec;
+}
+
+/*
+================
+IniProfEntry
+================
+*/
+static iniprofentry_t* IniProfEntry( ini_t* ini, iniprofthread_t* rec, int kind, const char* name, ptrdiff_t length, unsigned hash ) {
+    iniproftable_t* table;
+    iniproftable_t* ntable;
+    iniprofentry_t* e;
+    ptrdiff_t i;
+    ptrdiff_t j;
+    
+    table = rec->table;
+    hash += (unsigned)kind * 0x9E3779B9u;
+    for( i = hash & (table->size - 1); (e = table->items[i]) != NULL; 
+        i = (i + 1) & (table->size - 1) ) 
+    {
+        if( e->kind == kind && e->length == length && 
+            !memcmp( e->name, name, length ) ) 
+        {
+            return e;
+        }
+    }
+    
+    if( (table->count + 1) * 2 > table->size ) {
+        // Other threads may still read the old table, it is retired
+        ntable = IniProfTableCreate( ini, table->size * 2 );
+        for( j = 0; j < table->size; j++ ) {
+            e = table->items[j];
+            if( !e ) {
+                continue;
+            }
+            i = (IniHash( e->name, e->length ) + (unsigned)e->kind * 0x9E3779B9u) & 
+                (ntable->size - 1);
+            while( ntable->items[i] ) {
+                i = (i + 1) & (ntable->size - 1);
+            }
+            ntable->items[i] = e;
+        }
+        ntable->count = table->count;
+        ntable->retired = table;
+        INI_ATOMIC_RELEASE( &rec->table, ntable );
+        table = ntable;
+        for( i = hash & (table->size - 1); table->items[i]; 
+            i = (i + 1) & (table->size - 1) );
+    }
+    
+    e = (iniprofentry_t*)ini->inimalloc( sizeof(iniprofentry_t) + length + 1 );
+    memset( e, 0, sizeof(iniprofentry_t) );
+    e->kind = kind;
+    e->name = (char*)(e + 1);
+    e->length = length;
+    memcpy( e + 1, name, length );
+    ((char*)(e + 1))[length] = 0;
+    // The entry is filled before other threads can see it
+    INI_ATOMIC_RELEASE( &table->items[i], e );
+    INI_ATOMIC_STORE( &table->count, table->count + 1 );
+    return e;
+}
+
+/*
+================
+IniProfCount
+================
+*/
+static void IniProfCount( ini_t* ini, int kind, const char* name, ptrdiff_t length, unsigned hash, size_t start, int result, ptrdiff_t depth ) {
+    iniprofentry_t* e;
+    size_t ns;
+    int b;
+    
+    ns = IniProfNow() - start;
+    e = IniProfEntry( ini, IniProfThread( ini ), kind, name, length, hash );
+    
+    // Only this thread writes the counters, IniGetProfile reads them
+    // from other threads
+    INI_ATOMIC_STORE( &e->calls, e->calls + 1 );
+    if( result == INI_PROF_HIT ) {
+        INI_ATOMIC_STORE( &e->hits, e->hits + 1 );
+    } else if( result == INI_PROF_INHERITED ) {
+        INI_ATOMIC_STORE( &e->inheritedHits, e->inheritedHits + 1 );
+    } else {
+        INI_ATOMIC_STORE( &e->misses, e->misses + 1 );
+    }
+    INI_ATOMIC_STORE( &e->depth, e->depth + depth );
+    if( depth > e->maxDepth ) {
+        INI_ATOMIC_STORE( &e->maxDepth, depth );
+    }
+    for( b = 0; b < INI_PROF_BUCKETS - 1 && (ns >> (b + 1)); b++ );
+    INI_ATOMIC_STORE( &e->latency[b], e->latency[b] + 1 );
+}
+
+/*
+================
+IniProfFindSect
+================
+*/
+static inisect_t* IniProfFindSect( ini_t* ini, const char* name, ptrdiff_t length, unsigned hash ) {
+    inistring_t* atom;
+    inisect_t* s;
+    size_t start;
+    
+    start = IniProfNow();
+    atom = IniAtomFind( ini, name, length, hash );
+    s = atom ? IniFindSectAtom( ini, atom ) : NULL;
+    IniProfCount( ini, INI_PROF_SECT, name, length, hash, start, 
+        s ? INI_PROF_HIT : INI_PROF_MISS, 0 );
+    return s;
+}
+
+/*
+================
+IniProfFindParam
+================
+*/
+static iniparam_t* IniProfFindParam( inisect_t* sect, const char* name, ptrdiff_t length, unsigned hash ) {
+    ini_t* ini;
+    inistring_t* atom;
+    iniparam_t* p;
+    ptrdiff_t walked;
+    size_t start;
+    int result;
+    
+    ini = sect->filename->ini;
+    start = IniProfNow();
+    walked = 0;
+    atom = IniAtomFind( ini, name, length, hash );
+    p = atom ? IniFindParamWalk( sect, atom, &walked ) : NULL;
+    if( !p ) {
+        result = INI_PROF_MISS;
+    } else if( p->sect == sect ) {
+        result = INI_PROF_HIT;
+    } else {
+        result = INI_PROF_INHERITED;
+    }
+    IniProfCount( ini, INI_PROF_PARAM, name, length, hash, start, result, walked );
+    return p;
+}
+
+/*
+================
+IniProfReadStart
+
+  Начало вызова IniRead* (0 без профиля)
+================
+*/
+static size_t IniProfReadStart( iniparam_t* param ) {
+    if( param->sect && param->sect->filename && 
+        (param->sect->filename->ini->flags & INI_FLAG_PROFILE) ) 
+    {
+        return IniProfNow();
+    }
+    return 0;
+}
+
+/*
+================
+IniProfRead
+
+  Учесть вызов IniRead* и вернуть его результат
+================
+*/
+static int IniProfRead( iniparam_t* param, size_t start, int result ) {
+    ini_t* ini;
+    
+    if( !param->sect || !param->sect->filename ) {
+        return result;
+    }
+    ini = param->sect->filename->ini;
+    if( ini->flags & INI_FLAG_PROFILE ) {
+        if( param->key ) {
+            IniProfCount( ini, INI_PROF_READ, param->key->string, 
+                param->key->length, param->key->hash, start, 
+                result ? INI_PROF_MISS : INI_PROF_HIT, 0 );
+        } else {
+            IniProfCount( ini, INI_PROF_READ, "", 0, 0, start, 
+                result ? INI_PROF_MISS : INI_PROF_HIT, 0 );
+        }
+    }
+    return result;
+}
+
+/*
+================
+IniProfFree
+================
+*/
+static void IniProfFree( ini_t* ini ) {
+    iniprofthread_t* rec;
+    iniproftable_t* table;
+    iniproftable_t* retired;
+    ptrdiff_t i;
+    
+    while( ini->profThreads ) {
+        rec = ini->profThreads;
+        ini->profThreads = rec->next;
+        for( i = 0; i < rec->table->size; i++ ) {
+            if( rec->table->items[i] ) {
+                ini->inifree( rec->table->items[i] );
+            }
+        }
+        for( table = rec->table; table; table = retired ) {
+            retired = table->retired;
+            ini->inifree( table );
+        }
+        ini->inifree( rec );
+    }
+}
+
+/*
+================
+IniProfCompareName
+================
+*/
+static int IniProfCompareName( const void* a, const void* b ) {
+    const iniprofentry_t* e1 = *(const iniprofentry_t* const*)a;
+    const iniprofentry_t* e2 = *(const iniprofentry_t* const*)b;
+    ptrdiff_t n;
+    int r;
+    
+    if( e1->kind != e2->kind ) {
+        return e1->kind < e2->kind ? -1 : 1;
+    }
+    n = e1->length < e2->length ? e1->length : e2->length;
+    r = memcmp( e1->name, e2->name, n );
+    if( r ) {
+        return r;
+    }
+    return e1->length < e2->length ? -1 : (e1->length > e2->length);
+}
+
+/*
+================
+IniProfCompareCalls
+================
+*/
+static int IniProfCompareCalls( const void* a, const void* b ) {
+    const iniprofentry_t* e1 = (const iniprofentry_t*)a;
+    const iniprofentry_t* e2 = (const iniprofentry_t*)b;
+    
+    if( e1->calls != e2->calls ) {
+        return e1->calls > e2->calls ? -1 : 1;
+    }
+    return IniProfCompareName( &e1, &e2 );
+}
+
+/*
+================
+IniProfPercentile
+
+  Верхняя граница корзины, в которую попадает доля part вызовов
+================
+*/
+static double IniProfPercentile( const iniprofentry_t* e, double part ) {
+    ptrdiff_t sum;
+    int b;
+    
+    sum = 0;
+    for( b = 0; b < INI_PROF_BUCKETS - 1; b++ ) {
+        sum += e->latency[b];
+        if( (double)sum >= part * (double)e->calls ) {
+            break;
+        }
+    }
+    return (double)((size_t)2 << b);
+}
+
+/*
+================
+IniFiledescrFind
+================
+*/
+static inidescr_t* IniFiledescrFind( ini_t* ini, const char* filename, ptrdiff_t len ) {
+    inidescr_t* it;
+    const char* s1;
+    const char* s2;
+    
+    iniassert( ini );
+    iniassert( filename );
+    
+    if( len < 0 ) {
+        len = strlen( filename );
+    }
+    
+    it = ini->filenames;
+    while( it ) {
+        if( it->filename->length == len ) {
+            s1 = filename;
+            s2 = it->filename->string;
+            while( *s1 ) {
+                if( !(((*s1 == '\\' || *s1 == '/') && 
+                    (*s2 == '\\' || *s2 == '/')) || 
+                    (tolower((unsigned char)*s1) == tolower((unsigned char)*s2))) ) {
+                    break;
+                }
+                s1++;
+                s2++;
+            }
+            if( *s1 == 0 ) {
+                return it;
+            }
+        }
+        it = it->next;
+    }
+    
+    return NULL;
+}
+
+/*
+================
+IniDiagPut
+
+  Дописать строку str длинны len в buf, текст обрезается по размеру буфера
+================
+*/
+static void IniDiagPut( char* buf, ptrdiff_t size, ptrdiff_t* pos, const char* str, ptrdiff_t len ) {
+    ptrdiff_t n;
+    
+    n = size - 1 - *pos;
+    if( n > len ) {
+        n = len;
+    }
+    if( n > 0 ) {
+        memcpy( buf + *pos, str, n );
+    }
+    *pos += len;
+}
+
+/*
+================
+IniDiag
+
+  Добавить диагностику в список ошибок. Аргументы копируются, если argLen
+меньше 0, то длинна arg считается по завершающему 0. Текст пишется в буфер
+ошибок только если он задан и ещё не заполнен
+================
+*/
+static inidiag_t* IniDiag( ini_t* ini, int code, inidescr_t* descr, int line, const char* arg, ptrdiff_t argLen, const char* arg2 ) {
+    inidiag_t* diag;
+    ptrdiff_t arg2Len;
+    ptrdiff_t size;
+    ptrdiff_t left;
+    ptrdiff_t length;
+    char* mem;
+    
+    iniassert( ini );
+    iniassert( code > 0 && code < INI_DIAG_COUNT );
+    
+    if( arg && argLen < 0 ) {
+        argLen = strlen( arg );
+    }
+    arg2Len = arg2 ? strlen( arg2 ) : 0;
+    size = sizeof(inidiag_t) + (arg ? argLen + 1 : 0) + 
+        (arg2 ? arg2Len + 1 : 0);
+    
+    diag = (inidiag_t*)IniMalloc( ini, NULL, INI_MTAG_DIAG, size );
+    mem = (char*)(diag + 1);
+    diag->next = NULL;
+    diag->code = code;
+    diag->severity = inidiaginfo[code].severity;
+    diag->descr = descr;
+    diag->line = line;
+    diag->column = 0;
+    diag->begin = 0;
+    diag->end = 0;
+    diag->arg = NULL;
+    diag->arg2 = NULL;
+    if( arg ) {
+        memcpy( mem, arg, argLen );
+        mem[argLen] = 0;
+        diag->arg = mem;
+        mem += argLen + 1;
+    }
+    if( arg2 ) {
+        memcpy( mem, arg2, arg2Len + 1 );
+        diag->arg2 = mem;
+    }
+    
+    if( ini->lastDiag ) {
+        ini->lastDiag->next = diag;
+    } else {
+        ini->firstDiag = diag;
+    }
+    ini->lastDiag = diag;
+    if( diag->severity == INI_DIAG_ERROR ) {
+        ini->numOfErrors++;
+    } else {
+        ini->numOfWarnings++;
+    }
+    
+    // The text is formatted once into the rest of the buffer. Text of the
+    // diagnostics which do not fit is dropped, the buffer is marked with
+    // "..." once
+    if( ini->errbuf && (ini->flags & 0x1) == 0 ) {
+        left = ini->errbufSize - ini->bufFill;
+        length = IniFormatDiag( diag, ini->errbuf + ini->bufFill, left );
+        if( length < left ) {
+            ini->bufFill += length;
+        } else {
+            if( left > 4 ) {
+                strcpy( ini->errbuf + ini->bufFill, "...\n" );
+                ini->bufFill += 4;
+            } else {
+                ini->errbuf[ini->bufFill] = 0;
+            }
+            ini->flags |= 0x1;
+        }
+    }
+    return diag;
+}
+
+/*
+================
+IniDiagSpan
+
+  Задать участок строки lineBuf, к которому относится диагностика
+================
+*/
+static void IniDiagSpan( inidiag_t* diag, const char* lineBuf, const char* begin, ptrdiff_t length ) {
+    iniassert( diag );
+    iniassert( begin >= lineBuf );
+    
+    diag->begin = begin - lineBuf;
+    diag->end = diag->begin + length;
+    diag->column = (int)diag->begin + 1;
+}
+
+/*
+================
+IniSectIsInheriteded
+
+Возвращает 1 если inh есть в списке наследованных секций иначе возвращает 0
+================
+*/
+static int IniSectIsInheriteded( inisect_t* sect, iniinh_t* inh ) {
+    iniinh_t* it;
+    it = sect->inherit;
+    while( it ) {
+        if( it == inh ) {
+            return 1;
+        }
+        it = it->next;
+    }
+    return 0;
+}
+
+
+/*
+================
+IniScanToken
+================
+*/
+#define INI_IDENTIFICATOR   0x1f00  // identificator
+#define INI_EQUAL           '='     // string
+#define INI_SECT_OPEN       '['     // identificator
+#define INI_SECT_CLOSE      ']'     //
+#define INI_COMMA           ','     // identificator
+#define INI_COMMENT         ';'     // comment
+#define INI_INHERIT         ':'     // identificator
+#define INI_PREPROCESSOR    '#'     // string
+#define INI_INCLUDE_PATH    '\"'    // "string"
+
+#define f   (s->forward)
+#define b   (s->begin)
+#define l   (s->length)
+#define tk  (s->token)
+
+static int IniIsSpace( int ch ) {
+    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\v' || 
+        ch == '\f' || ch == '\r';
+}
+
+static void IniSkipSpaces( char** p ) {
+    while( IniIsSpace(**p) ) {
+        (*p)++;
+    }
+}
+
+static int IniIsIdSymbol( int ch ) {
+    return ch == '_' || ch == '$' || ch == '-' || ch == '.' || 
+        ch == ':' || ch == '\\' || ch == '#' || ch == '(' || ch == ')'
+        || ch == ',' || ch == '?' || ch == '@';
+}
+
+static int IniIsIdSymbol2( int ch ) {
+    return ch == '_' || ch == '$' || ch == '-' || ch == '.' || 
+        ch == ':' || ch == '\\' || ch == '#' || ch == '(' || ch == ')'
+        || ch == '?' || ch == '@';
+}
+
+static int IniScanIdentificator( iniscan_t* s ) {
+    IniSkipSpaces( &f );
+    b = f;
+    while( isalnum((unsigned char)*f) || IniIsIdSymbol(*f) ) {
+        f++;
+    }
+    l = f - b;
+    return l ? 0 : -1;
+}
+
+static int IniScanIdentificator2( iniscan_t* s ) {
+    IniSkipSpaces( &f );
+    b = f;
+    while( isalnum((unsigned char)*f) || IniIsIdSymbol2(*f) ) {
+        f++;
+    }
+    l = f - b;
+    return l ? 0 : -1;
+}
+
+static int IniScanValue( iniscan_t* s ) {
+    IniSkipSpaces( &f );
+    b = f;
+    while( *f && !(*f == ';' || *f == '/' || *f == '\n') ) {
+        if( !IniIsSpace(*f) ) {
+            l = f - b + 1;
+        }
+        f++;
+    }
+    return 0;
+}
+
+static int IniScanComment( iniscan_t* s ) {
+    b = f;
+    l = 0;
+    while( *f && *f != '\n' ) {
+        if( !IniIsSpace(*f) ) {
+            l = f - b + 1;
+        }
+        f++;
+    }
+    return 0;
+}
+
+static int IniScanIncludePath( iniscan_t* s ) {
+    char ch = *f;
+    f++;
+    b = f;
+    while( *f && *f != ch ) {
+        f++;
+    }
+    l = f - b;
+    if( *f && *f == ch ) {
+        f++;
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+static int IniFindKeyword( const char* word, ptrdiff_t len ) {
+    int i;
+    for( i = 0; inikeywords[i].word; i++ ) {
+        if( len == inikeywords[i].length && 
+            !strncmp( inikeywords[i].word, word, len ) ) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int IniScanToken( iniscan_t* s ) {
+    s->count++;
+    l = 0;
+
+    for(;;) {
+        b = f;
+        switch( *f ) {
+            case 0: tk = 0; l = 0; return 0;
+            case ' ': case '\t': case '\n': case '\v': case '\f':
+            case '\r': f++; break;
+            case '=':
+                f++;
+                IniScanValue( s );
+                return tk = INI_EQUAL;
+            case '[':
+                f++;
+                if( IniScanIdentificator( s ) ) {
+                    return tk = -1;
+                }
+                return tk = INI_SECT_OPEN;
+            case ']':
+                f++;
+                l = 1;
+                return tk = INI_SECT_CLOSE;
+            case ',':
+                f++;
+                if( IniScanIdentificator2( s ) ) {
+                    return tk = -1;
+                }
+                return tk = INI_COMMA;
+            case ';': case '/':
+                f++;
+                s->comments++;
+                IniScanComment( s );
+                return tk = INI_COMMENT;
+            case ':':
+                f++;
+                if( IniScanIdentificator2( s ) ) {
+                    return tk = -1;
+                }
+                return tk = INI_INHERIT;
+            case '#':
+                f++;
+                if( IniScanIdentificator( s ) ) {
+                    return tk = -1;
+                }
+                return tk = INI_PREPROCESSOR;
+            case '\'': case '"':
+                if( IniScanIncludePath( s ) ) {
+                    return tk = -1;
+                }
+                return tk = INI_INCLUDE_PATH;
+            default:
+                if( IniScanIdentificator( s ) ) {
+                    return tk = -1;
+                }
+                return tk = INI_IDENTIFICATOR;
+        }
+    }
+}
+
+/*
+================
+IniPathLength
+
+Вернуть длинну пути к файлу (вместе с последним разделителем).
+
+src: "path\to\file\filename.ext"
+return: length of "path\to\file\"
+================
+*/
+static ptrdiff_t IniPathLength( const char* src ) {
+    ptrdiff_t ret = 0;
+    ptrdiff_t i = 0;
+    for( ; src[i]; i++ ) {
+        if( src[i] == '\\' || src[i] == '/' ) {
+            ret = i + 1;
+        }
+    }
+    return ret;
+}
+
+/*
+================
+IniParserAlloc
+
+  Выделить память под буфер парсера размером size, старое содержимое
+буфера (oldSize байт) переносится в новую память.
+================
+*/
+static void* IniParserAlloc( ini_t* ini, void* old, ptrdiff_t oldSize, ptrdiff_t size ) {
+    void* mem;
+    
+    iniassert( ini );
+    iniassert( size > oldSize );
+    
+    mem = IniMalloc( ini, NULL, INI_MTAG_PARSER, size );
+    if( old ) {
+        memcpy( mem, old, oldSize );
+        IniMfree( ini, NULL, INI_MTAG_PARSER, old, oldSize );
+    }
+    return mem;
+}
+
+/*
+================
+IniParserGets
+
+  Прочитать строку из файла в буфер парсера. Строка читается целиком,
+буфер увеличивается если строка в него не помещается. Функция возвращает
+NULL если достигнут конец файла
+================
+*/
+static char* IniParserGets( iniparser_t* p, iniframe_t* fr ) {
+    FILE* file;
+    const char* src;
+    const char* end;
+    ptrdiff_t len;
+    
+    iniassert( p );
+    iniassert( fr );
+    iniassert( fr->file || fr->mem );
+    
+    // The line from memory is copied too, the scanner changes it in place
+    if( fr->mem ) {
+        if( fr->memPos >= fr->memSize ) {
+            return NULL;
+        }
+        src = fr->mem + fr->memPos;
+        end = (const char*)memchr( src, '\n', fr->memSize - fr->memPos );
+        len = end ? end - src + 1 : fr->memSize - fr->memPos;
+        if( len + 1 > p->bufSize ) {
+            IniMfree( p->ini, NULL, INI_MTAG_PARSER, p->buf, p->bufSize );
+            while( len + 1 > p->bufSize ) {
+                p->bufSize *= 2;
+            }
+            p->buf = (char*)IniMalloc( p->ini, NULL, INI_MTAG_PARSER, 
+                p->bufSize );
+        }
+        memcpy( p->buf, src, len );
+        p->buf[len] = 0;
+        fr->memPos += len;
+        return p->buf;
+    }
+    
+    file = fr->file;
+    len = 0;
+    for(;;) {
+        // fgets writes the terminating zero into the last byte of the
+        // buffer only if the line does not fit
+        p->buf[p->bufSize - 1] = 1;
+        if( fgets( p->buf + len, (int)(p->bufSize - len), file ) == NULL ) {
+            return len ? p->buf : NULL;
+        }
+        if( p->buf[p->bufSize - 1] != 0 || p->buf[p->bufSize - 2] == '\n' ) {
+            return p->buf;
+        }
+        
+        // The line is longer than the buffer, grow the buffer and read
+        // the rest of the line
+        len = p->bufSize - 1;
+        p->buf = (char*)IniParserAlloc( p->ini, p->buf, p->bufSize, 
+            p->bufSize * 2 );
+        p->buf[len] = 0;
+        p->bufSize *= 2;
+    }
+}
+
+/*
+================
+IniParserPush
+
+  Открыть файл filename и положить его на вершину стека открытых файлов.
+Если mem не NULL, то содержимое файла берётся из памяти (size байт), а
+filename задаёт только имя. Функция возвращает -1 если файл открыть не
+удалось
+================
+*/
+static int IniParserPush( iniparser_t* p, const char* filename, const char* mem, ptrdiff_t size ) {
+    iniframe_t* fr;
+    FILE* file;
+    size_t start;
+    
+    iniassert( p );
+    iniassert( filename );
+    
+    // Open current file
+    start = IniLoadClock( p->ini );
+    file = NULL;
+    if( !mem && (file = fopen( filename, "r" )) == NULL ) {
+        IniDiag( p->ini, INI_DIAG_OPEN_FILE, NULL, 0, filename, -1, NULL );
+        return -1;
+    }
+    
+    // Grow stack of the opened files
+    if( p->depth == p->maxDepth ) {
+        p->frames = (iniframe_t*)IniParserAlloc( p->ini, p->frames,
+            p->maxDepth * sizeof(iniframe_t),
+            (p->maxDepth * 2 + 4) * sizeof(iniframe_t)
+        );
+        p->maxDepth = p->maxDepth * 2 + 4;
+    }
+    
+    // Keep a limited number of the files opened, the oldest one is
+    // suspended and will be reopened when parsing returns to it
+    if( p->depth >= INI_PARSER_OPEN_FILES ) {
+        fr = p->frames + p->depth - INI_PARSER_OPEN_FILES;
+        if( fr->file ) {
+            fr->offset = ftell( fr->file );
+            fclose( fr->file );
+            fr->file = NULL;
+        }
+    }
+    
+    // Append current filename to filedescr
+    fr = p->frames + p->depth++;
+    fr->file = file;
+    fr->offset = 0;
+    fr->mem = mem;
+    fr->memSize = size;
+    fr->memPos = 0;
+    fr->descr = IniAppendDescr( p->ini, filename );
+    fr->sect = fr->descr->gsect;
+    fr->sectKey = NULL;
+    fr->line = 0;
+    fr->descr->load.depth = p->depth - 1;
+    IniLoadTime( p->ini, &fr->descr->load.ioTime, start );
+    return 0;
+}
+
+/*
+================
+IniParserPop
+
+  Закрыть файл на вершине стека открытых файлов.
+Функция возвращает -1 если при чтении файла произошла ошибка
+================
+*/
+static int IniParserPop( iniparser_t* p ) {
+    iniframe_t* fr;
+    size_t start;
+    long bytes;
+    int ret = 0;
+    
+    iniassert( p );
+    iniassert( p->depth > 0 );
+    
+    fr = p->frames + --p->depth;
+    if( fr->mem ) {
+        fr->descr->load.bytes += fr->memPos;
+        return 0;
+    }
+    bytes = ftell( fr->file );
+    if( bytes > 0 ) {
+        fr->descr->load.bytes += bytes;
+    }
+    // Check if the file is read correctly
+    if( !feof(fr->file) && ferror(fr->file) ) {
+        IniDiag( p->ini, INI_DIAG_READ_FILE, fr->descr, 0, 
+            fr->descr->filename->string, -1, NULL );
+        ret = -1;
+    }
+    start = IniLoadClock( p->ini );
+    fclose( fr->file );
+    IniLoadTime( p->ini, &fr->descr->load.ioTime, start );
+    return ret;
+}
+
+/*
+================
+IniValidateSect
+
+  Разобрать заголовок секции в режиме проверки (IniValidate). Секции не
+создаются, вместо них названия объявленных секций (интернированные строки)
+хранятся в множестве p->sects. Сканер стоит на ']'
+================
+*/
+static int IniValidateSect( iniparser_t* p, iniframe_t* fr, const char* key, ptrdiff_t keylen ) {
+    ini_t* ini;
+    iniscan_t* s;
+    inistring_t* atom;
+    int ret;
+    
+    iniassert( p );
+    iniassert( fr );
+    
+    ini = p->ini;
+    s = &p->scan;
+    ret = 0;
+    
+    // Repeated sections are reported in both modes of IniLoad, the set
+    // finds them without the section table
+    atom = IniAtomFind( ini, key, keylen, IniHash( key, keylen ) );
+    if( atom && IniPtrSetHas( &p->sects, atom ) ) {
+        IniDiagSpan( IniDiag( ini, INI_DIAG_SECT_DEFINED, fr->descr, 
+            fr->line, atom->string, atom->length, NULL 
+        ), p->buf, key, keylen );
+    } else {
+        // The set holds one reference to the name
+        atom = IniAtomCreate( ini, key, keylen );
+        IniPtrSetAdd( &p->sects, atom );
+    }
+    fr->sectKey = atom;
+    
+    IniScanToken( s );
+    // Only sections defined above can be inherited, the same as in
+    // IniSectInherit
+    while( tk == INI_COMMA || tk == INI_INHERIT ) {
+        atom = l ? IniAtomFind( ini, b, l, IniHash( b, l ) ) : NULL;
+        if( !atom || !IniPtrSetHas( &p->sects, atom ) || 
+            atom == fr->sectKey ) {
+            IniDiagSpan( IniDiag( ini, INI_DIAG_INHERIT, fr->descr, fr->line,
+                b, l, NULL ), p->buf, b, l );
+            ret = -1;
+        }
+        IniScanToken( s );
+    }
+    return ret;
+}
+
+/*
+================
+IniParseLine
+
+  Разобрать одну строку из буфера парсера. Если в строке встречена директива
+#include, то путь к включаемому файлу записывается в p->path, а сам файл
+будет открыт после разбора строки.
+================
+*/
+static int IniParseLine( iniparser_t* p, iniframe_t* fr ) {
+    ini_t* ini;             // Pointer to ini
+    iniparam_t* param;      // Pointer to parameter
+    inidescr_t* descr;      // Pointer to description
+    iniscan_t* s;           // Scanner pointer
+    inisect_t* sect;        // Current section
+    inistring_t* atom;      // Interned parameter key
+    iniparam_t* found;      // Parameter with the same key
+    inidescr_t* included;   // Already included file
+    const char* filename;   // Current file name
+    char* key;              // Key pointer
+    char* val;              // Value pointer
+    ptrdiff_t keylen;       // Key length
+    ptrdiff_t vallen;       // Value length
+    ptrdiff_t pathlen;      // Path to file length
+    int line;               // Current line in the file
+    size_t start;           // Start of the timing
+    int ret;                // Return code
+    char ch;                //
+    
+    ini = p->ini;
+    s = &p->scan;
+    param = NULL;
+    descr = fr->descr;
+    sect = fr->sect;
+    filename = descr->filename->string;
+    line = fr->line;
+    ret = 0;
+    f = p->buf; //-V507
+
+    switch( IniScanToken( s ) ) {
+        case INI_IDENTIFICATOR:
+            // Save pointer to key and key length
+            key = b;
+            keylen = l;
+            
+            IniScanToken( s );
+            // Save pointer to value and value length (if token is value)
+            if( tk == INI_EQUAL ) {
+                val = b;
+                vallen = l;
+                IniScanToken( s );
+            } else {
+                val = NULL;
+                vallen = 0;
+            }
+            
+            // Check section. Section cannot be is global
+            if( (ini->flags & INI_FLAG_VALIDATE) ? fr->sectKey == NULL :
+                sect == descr->gsect ) {
+                IniDiagSpan( IniDiag( ini, INI_DIAG_SECT_EXPECTED, descr, line,
+                    NULL, 0, NULL ), p->buf, key, keylen );
+                return -1;
+            }
+            
+            // The first parameter with the same key is kept
+            descr->load.params++;
+            // The validation does not keep parameters
+            if( ini->flags & INI_FLAG_VALIDATE ) {
+                break;
+            }
+            atom = IniAtomCreate( ini, key, keylen );
+            found = NULL;
+            if( ini->flags & INI_FLAG_CHECK_FOR_PARAM ) {
+                start = IniLoadClock( ini );
+                found = IniFindOnlyInSect( sect, atom );
+                IniLoadTime( ini, &descr->load.dupTime, start );
+            }
+            if( found ) {
+                IniDiagSpan( IniDiag( ini, INI_DIAG_PARAM_DEFINED, descr, line,
+                    atom->string, atom->length, sect->key->string 
+                ), p->buf, key, keylen );
+                IniAtomRelease( ini, atom );
+                if( ini->flags & INI_FLAG_PARSE_COMMENTS && tk == INI_COMMENT ) {
+                    IniScanToken( s );
+                }
+                break;
+            }
+            
+            // Append parametr to section, the comment (if token is comment)
+            // is placed to the same memory
+            if( ini->flags & INI_FLAG_PARSE_COMMENTS && tk == INI_COMMENT ) {
+                param = IniParamCreate( ini, sect->filename, atom,
+                    val, vallen, b, l
+                );
+                // Scan next token
+                IniScanToken( s );
+            } else {
+                param = IniParamCreate( ini, sect->filename, atom,
+                    val, vallen, NULL, 0
+                );
+            }
+            IniAppendParam_s( sect, param );
+            // Parameters of the duplicates are checked when the sections
+            // are merged
+            if( p->lines && ini->numDupSects && sect != descr->gsect && 
+                IniFindSectAtom( ini, sect->key ) != sect ) 
+            {
+                IniParamLinesAdd( p->lines, param, line );
+            }
+            
+            break;
+            
+        // Parse next sequence:
+        // [section]: inherit1, inherit2, ... , inherit_n ; comment
+        case INI_SECT_OPEN:
+            key = b;
+            keylen = l;
+            descr->load.sects++;
+            
+            IniScanToken( s );
+            // Expect close section symbol ']'
+            if( tk != INI_SECT_CLOSE ) {
+                IniDiagSpan( IniDiag( ini, INI_DIAG_SECT_CLOSE, descr, line,
+                    NULL, 0, NULL ), p->buf, b, l );
+                return -1;
+            }
+            if( ini->flags & INI_FLAG_VALIDATE ) {
+                ret = IniValidateSect( p, fr, key, keylen );
+                break;
+            }
+            
+            // Create new section and append section to filedescr
+            // Without the check duplicates are merged after the parsing
+            sect = IniSectCreate( ini, descr,
+                IniAtomCreate( ini, key, keylen ),
+                NULL, ini->flags & INI_FLAG_CHECK_FOR_SECT
+            );
+            // The found section is already in some file
+            if( sect->filename ) {
+                IniDiagSpan( IniDiag( ini, INI_DIAG_SECT_DEFINED, descr, line,
+                    sect->key->string, sect->key->length, NULL 
+                ), p->buf, key, keylen );
+            } else {
+                sect->line = line;
+            }
+            IniAppendSect_s( descr, sect );
+            fr->sect = sect;
+            
+            IniScanToken( s );
+            // Check for inherit and parse 'inherit' sequences
+            while( tk == INI_COMMA || tk == INI_INHERIT ) {
+                // Terminate the name in place, the scanner has already
+                // passed over it
+                ch = b[l];
+                b[l] = 0;
+                // Inherit for current section
+                if( IniSectInherit( sect, b ) ) {
+                    IniDiagSpan( IniDiag( ini, INI_DIAG_INHERIT, descr, line,
+                        b, l, NULL ), p->buf, b, l );
+                    ret = -1;
+                }
+                b[l] = ch;
+                // Scan next token
+                IniScanToken( s );
+            }
+            
+            // Append comment to current sectoin (if token is comment)
+            if( !!(ini->flags & INI_FLAG_PARSE_COMMENTS) && tk == INI_COMMENT ) {
+                if( !sect->comment ) {
+                    sect->comment = IniStringCreate( ini, sect->filename, b, l );
+                }
+                // Scan next token
+                IniScanToken( s );
+            }
+            
+            break;
+        
+        // Parse next sequence:
+        // #preproc "path\filename.ext" ; comment
+        case INI_PREPROCESSOR:
+            switch( IniFindKeyword( b, l ) ) {
+                
+                // Parse next sequence:
+                // #include "path\filename.ext" ; comment
+                case 0:
+                    IniScanToken( s );
+                    if( tk == INI_INCLUDE_PATH && l > 0 ) {
+                        descr->load.includes++;
+                        
+                        // Make path to the included file relative to the
+                        // current file
+                        pathlen = IniPathLength( filename );
+                        if( pathlen + l + 1 > p->pathSize ) {
+                            p->path = (char*)IniParserAlloc( ini, p->path,
+                                p->pathSize, pathlen + l + 1 + 256 );
+                            p->pathSize = pathlen + l + 1 + 256;
+                        }
+                        strncpy( p->path, filename, pathlen );
+                        strncpy( p->path + pathlen, b, l );
+                        p->path[pathlen + l] = 0;
+                        
+                        // Check the included file for already include
+                        start = IniLoadClock( ini );
+                        included = IniFiledescrFind( ini, p->path, -1 );
+                        IniLoadTime( ini, &descr->load.descrTime, start );
+                        if( included ) {
+                            IniDiagSpan( IniDiag( ini, INI_DIAG_FILE_INCLUDED,
+                                descr, line, p->path, pathlen + l, NULL 
+                            ), p->buf, b, l );
+                            return 0;
+                        } else {
+                            // Append parametr to section
+                            if( !(ini->flags & INI_FLAG_VALIDATE) ) {
+                                param = IniAppendIncludeToSect( sect, 
+                                    p->path + pathlen
+                                );
+                            }
+                            // Parsing of the nested file starts after
+                            // this line
+                            p->include = 1;
+                        }
+                    } else {
+                        IniDiagSpan( IniDiag( ini, INI_DIAG_INCLUDE_NAME, 
+                            descr, line, NULL, 0, NULL ), p->buf, b, l );
+                        return -1;
+                    }
+                    break;
+                    
+                // Parse next sequence:
+                // #print "to print" ; comment
+                case 1:
+                    IniScanToken( s );
+                    if( tk == INI_INCLUDE_PATH ) {
+                        if( ini->flags & INI_FLAG_VALIDATE ) {
+                            break;
+                        }
+                        // Create new parameter
+                        param = IniParamCreate( ini, sect->filename,
+                            IniAtomCreate( ini, "#print", 6 ),
+                            b, l, NULL, 0
+                        );
+                        // Append to section
+                        IniAppendParam_s( sect, param );
+                        // And print data to stdout
+                        fprintf( stdout, "%.*s\n", (int)l, b );
+                    } else {
+                        IniDiagSpan( IniDiag( ini, INI_DIAG_PRINT_VALUE, 
+                            descr, line, NULL, 0, NULL ), p->buf, b, l );
+                        return -1;
+                    }
+                    break;
+                    
+                // Uncnown #keyword
+                default:
+                    IniDiagSpan( IniDiag( ini, INI_DIAG_DIRECTIVE, descr, line,
+                        b, l, NULL ), p->buf, b, l );
+                    return -1;
+            }
+            IniScanToken( s );
+            
+            // Append comment to current parametr
+            if( !!(ini->flags & INI_FLAG_PARSE_COMMENTS) && tk == INI_COMMENT ) {
+                if( !param->comment ) {
+                    param->comment = IniStringCreate( ini, sect->filename, b, l );
+                }
+                IniScanToken( s );
+            }
+            break;
+            
+        // Parse next sequence:
+        // ; comment
+        case INI_COMMENT:
+            if( !!(ini->flags & INI_FLAG_PARSE_COMMENTS) ) {
+                // Create comment
+                param = IniParamCreate( ini, sect->filename, NULL, 
+                    NULL, 0, b, l );
+                if( sect != NULL ) {
+                    // Append comment to current section
+                    IniAppendParam_s( sect, param );
+                } else {
+                    // Append comment to global section
+                    IniAppendParam_s( descr->gsect, param );
+                }
+            }
+            // Scan next token and break from case
+            IniScanToken( s );
+            break;
+    }
+    
+    // Check for next empty token
+    if( !(tk == 0 || (tk == INI_COMMENT && !(ini->flags & INI_FLAG_PARSE_COMMENTS))) ) { 
+        IniDiagSpan( IniDiag( ini, INI_DIAG_TOKEN, descr, line, b, l, NULL ), 
+            p->buf, b, l );
+        ret = -1;
+    }
+    
+    return ret;
+}
+
+/*
+================
+IniParse
+
+  Разобрать файл filename и все включённые в него файлы. Вложенные файлы
+разбираются без рекурсии: открытые файлы хранятся в стеке парсера, а
+буфер строки общий для всех уровней вложенности. Если mem не NULL, то
+содержимое самого файла filename берётся из памяти
+================
+*/
+static int IniParse( ini_t* ini, const char* filename, const char* mem, ptrdiff_t size, iniparamlines_t* lines ) {
+    iniparser_t parser;     // Parser state
+    iniparser_t* p;         // Parser pointer
+    iniframe_t* fr;         // Current file
+    inidescr_t* descr;      // Descriptor of the current file
+    inisect_t* sect;        // Copy of the section after an include
+    char* line;             // Read line
+    size_t start;           // Start of the timing
+    ptrdiff_t i;            // Index in the section names
+    int ret;                // Return code
+    
+    iniassert( ini );
+    iniassert( filename );
+    
+    p = &parser;
+    p->ini = ini;
+    p->frames = NULL;
+    p->depth = 0;
+    p->maxDepth = 0;
+    p->bufSize = 4096 * 2;
+    p->buf = (char*)IniParserAlloc( ini, NULL, 0, p->bufSize );
+    p->pathSize = 0;
+    p->path = NULL;
+    p->include = 0;
+    p->scan.count = 0;
+    p->scan.comments = 0;
+    p->sects.items = NULL;
+    p->lines = lines;
+    if( ini->flags & INI_FLAG_VALIDATE ) {
+        IniPtrSetInit( ini, &p->sects );
+    }
+    ret = 0;
+    
+    // Without the file the loop is skipped and only the buffers are freed
+    if( IniParserPush( p, filename, mem, size ) ) {
+        ret = -1;
+    }
+    
+    // Main parsing loop
+    while( p->depth > 0 ) {
+        fr = p->frames + p->depth - 1;
+        descr = fr->descr;
+        start = IniLoadClock( ini );
+        if( fr->file == NULL && fr->mem == NULL ) {
+            // Resume the suspended file
+            fr->file = fopen( fr->descr->filename->string, "r" );
+            if( fr->file == NULL || fseek( fr->file, fr->offset, SEEK_SET ) ) {
+                IniDiag( ini, INI_DIAG_REOPEN_FILE, fr->descr, 0, 
+                    fr->descr->filename->string, -1, NULL );
+                if( fr->file ) {
+                    fclose( fr->file );
+                }
+                p->depth--;
+                ret = -1;
+                continue;
+            }
+        }
+        line = IniParserGets( p, fr );
+        IniLoadTime( ini, &descr->load.ioTime, start );
+        if( line == NULL ) {
+            if( IniParserPop( p ) ) {
+                ret = -1;
+            }
+            // Without the section check the rest of the section after the
+            // included file goes to a new copy of the section. Duplicates
+            // are merged in the order of the list, so the parameters keep
+            // the order of the checked parsing
+            if( p->depth > 0 && !(ini->flags & (INI_FLAG_CHECK_FOR_SECT |
+                INI_FLAG_VALIDATE)) ) {
+                fr = p->frames + p->depth - 1;
+                if( fr->sect != fr->descr->gsect ) {
+                    sect = IniSectCreate( ini, fr->descr, 
+                        IniAtomCreate( ini, fr->sect->key->string, 
+                            fr->sect->key->length ),
+                        NULL, 0
+                    );
+                    fr->sect = sect;
+                    IniAppendSect_s( fr->descr, fr->sect );
+                }
+            }
+            continue;
+        }
+        fr->line++;
+        descr->load.lines++;
+        
+        ini->flags |= INI_FLAG_PARSING_LINE;
+        start = IniLoadClock( ini );
+        if( IniParseLine( p, fr ) ) {
+            ret = -1;
+        }
+        IniLoadTime( ini, &descr->load.parseTime, start );
+        ini->flags &= ~INI_FLAG_PARSING_LINE;
+        // The line end is not a token
+        descr->load.tokens += p->scan.count - (p->scan.token == 0);
+        descr->load.comments += p->scan.comments;
+        p->scan.count = 0;
+        p->scan.comments = 0;
+        
+        // Parsing nested include files
+        if( p->include ) {
+            p->include = 0;
+            if( IniParserPush( p, p->path, NULL, 0 ) ) {
+                ret = -1;
+            }
+        }
+    }
+    
+    IniMfree( ini, NULL, INI_MTAG_PARSER, p->buf, p->bufSize );
+    if( p->frames ) {
+        IniMfree( ini, NULL, INI_MTAG_PARSER, p->frames, 
+            p->maxDepth * sizeof(iniframe_t) );
+    }
+    if( p->path ) {
+        IniMfree( ini, NULL, INI_MTAG_PARSER, p->path, p->pathSize );
+    }
+    if( p->sects.items ) {
+        for( i = 0; i < p->sects.size; i++ ) {
+            if( p->sects.items[i] ) {
+                IniAtomRelease( ini, (inistring_t*)p->sects.items[i] );
+            }
+        }
+        IniPtrSetFree( &p->sects );
+    }
+    return ret;
+}
+
+#undef f
+#undef b
+#undef l
+#undef tk
+
+/*
+================
+IniMergeSect
+
+  Перенести параметры, наследования и комментарий секции s в секцию first с
+тем же названием. Сама секция s после этого пустая и её ключ освобождён.
+Строки повторных параметров берутся из lines
+================
+*/
+static void IniMergeSect( ini_t* ini, inisect_t* first, inisect_t* s, const iniparamlines_t* lines ) {
+    inidescr_t* from;
+    inidescr_t* to;
+    iniparam_t* p;
+    iniparam_t* pnext;
+    iniinh_t* inh;
+    
+    iniassert( first->key == s->key );
+    // Duplicates are never found by name, so nobody inherits them
+    iniassert( !s->heirs );
+    
+    from = s->filename;
+    to = first->filename;
+    
+    // Parameters, with the parameter check the first one is kept
+    for( p = s->firstParam; p; p = pnext ) {
+        pnext = p->next;
+        p->next = NULL;
+        if( (ini->flags & INI_FLAG_CHECK_FOR_PARAM) && p->key && 
+            p->key->string[0] != '#' && IniFindOnlyInSect( first, p->key ) ) 
+        {
+            IniDiag( ini, INI_DIAG_PARAM_DEFINED, from, 
+                IniParamLinesFind( lines, p ), p->key->string, p->key->length, 
+                s->key->string );
+            IniParamFree( ini, from, p );
+            continue;
+        }
+        IniMemMove( from, to, INI_MTAG_PARAM, IniParamSize( p ) );
+        if( p->value && p->value->size ) {
+            IniMemMove( from, to, INI_MTAG_STRING, 
+                sizeof(inistring_t) + p->value->size );
+        }
+        if( p->comment && p->comment->size ) {
+            IniMemMove( from, to, INI_MTAG_STRING, 
+                sizeof(inistring_t) + p->comment->size );
+        }
+        IniAppendParam_s( first, p );
+    }
+    s->firstParam = NULL;
+    s->lastParam = NULL;
+    
+    // Comment is taken only if the first section has none
+    if( s->comment && !first->comment ) {
+        IniMemMove( from, to, INI_MTAG_STRING, 
+            sizeof(inistring_t) + s->comment->size );
+        first->comment = s->comment;
+    } else {
+        IniStringFree( ini, from, s->comment );
+    }
+    s->comment = NULL;
+    
+    // Inherits, the heir records of the parents are pointed to first
+    for( inh = s->inherit; inh; inh = inh->next ) {
+        inh->sect = first;
+        inh->twin->inhSect = first;
+        IniMemMove( from, to, INI_MTAG_INHERIT, sizeof(iniinh_t) );
+    }
+    if( s->inherit ) {
+        s->inherit->prev = first->inheritLast;
+        if( first->inherit ) {
+            first->inheritLast->next = s->inherit;
+        } else {
+            first->inherit = s->inherit;
+        }
+        first->inheritLast = s->inheritLast;
+        IniInvalidateSect( first );
+    }
+    s->inherit = NULL;
+    s->inheritLast = NULL;
+    
+    IniAtomRelease( ini, s->key );
+    s->key = NULL;
+}
+
+/*
+================
+IniMergeSects
+
+  Объединить секции с одинаковыми названиями, добавленные без проверки (см.
+IniSetCheckForSections). Повторные секции сливаются в первую по порядку
+списка секций, результат и диагностики такие же как при разборе с проверкой.
+Копии секции, продолжающие её после #include, заголовка не имеют (line
+равен 0), о них не предупреждается
+================
+*/
+static void IniMergeSects( ini_t* ini, const iniparamlines_t* lines ) {
+    inisect_t* first;
+    inisect_t* s;
+    inisect_t* next;
+    
+    iniassert( ini );
+    
+    if( ini->numDupSects == 0 ) {
+        return;
+    }
+    
+    // Parameters and inherits are moved to other sections
+    IniKeyIndexFree( ini );
+    IniClosureFreeAll( ini );
+    IniBloomFreeAll( ini );
+    IniMphFreeAll( ini );
+    
+    // The section table holds the first section with each name
+    for( s = ini->firstSect; s; s = next ) {
+        next = s->next;
+        first = IniFindSectAtom( ini, s->key );
+        if( first == s ) {
+            continue;
+        }
+        if( s->line > 0 ) {
+            IniDiag( ini, INI_DIAG_SECT_DEFINED, s->filename, s->line, 
+                s->key->string, s->key->length, NULL );
+        }
+        IniMergeSect( ini, first, s, lines );
+        IniUnlinkSect_s( s );
+        IniSectIdFree( ini, s );
+        IniBloomFree( ini, s );
+        IniKeysFree( ini, s->filename, &s->keys );
+        IniMfree( ini, s->filename, INI_MTAG_SECT, s, sizeof(inisect_t) );
+    }
+    ini->numDupSects = 0;
+}
+
+/*
+================
+IniFprintSect
+================
+*/
+static void IniFprintSect( FILE* f, inisect_t* s, int includeignore ) {
+    unsigned flags;         // Флаги для печати
+    int keyalign;           // Выравнивание ключа (выравнивание пробелами)
+    int emptyline;          // Печатать ли пустую строку после конца секции
+    int printcomment;       // Печатать ли комментарии
+    int spaceaftereq;       // Пробел после знака равно
+    int printheirs;         // Печатать наследников перед секцией
+    int printempty;         // Печатать пустые строки, если такие есть
+    int spacebeforeeq;      // Печатать пробел перед знаком
+    iniinh_t* inh;          // Унаследованные секции
+    iniparam_t* p;          // Параметры секции
+    int skip;               // Пропускаемый #include
+
+    iniassert( f );
+    iniassert( s );
+    iniassert( s->filename );
+    iniassert( s->filename->gsect );
+
+    flags = s->filename->ini->flags;
+    keyalign = (flags >> 24) & 0xff;
+    emptyline = flags & INI_FLAG_EMPTY_LINE_AFTER_SECT;
+    printheirs = flags & INI_FLAG_PRINT_HEIRS;
+    printcomment = flags & INI_FLAG_PRINT_COMMENTS;
+    spaceaftereq = flags & INI_FLAG_SPACE_AFTER_EQ;
+    printempty = flags & INI_FLAG_PRINT_EMPTY_LINES;
+    spacebeforeeq = keyalign == 0 && (flags & INI_FLAG_SPACE_BEFORE_EQ);
+
+    // ; sect_heir1, sect_heir2, ...
+    if( printheirs ) {
+        inh = s->heirs;
+        if( inh ) {
+            fprintf( f, "; heirs: " );
+            while( inh ) {
+                fprintf( f, "%s", inh->inhSect->key->string );
+                inh = inh->next;
+                if( inh ) {
+                    fprintf( f, ", " );
+                }
+            }
+            fprintf( f, "\n" );
+        }
+    }
+
+    // [section_name]:inherit1, inherit2, ...; comment
+    if( s != s->filename->gsect ) {
+        if( s->key ) {  // [section_name]
+            fprintf( f, "[%s]", s->key->string );
+        }
+        inh = s->inherit;
+        if( inh ) {     // :inherit1, inherit2, ...
+            fprintf( f, ":" );
+            while( inh ) {
+                fprintf( f, "%s", inh->inhSect->key->string );
+                inh = inh->next;
+                if( inh ) {
+                    fprintf( f, ", " );
+                }
+            }
+        }
+        if( printcomment && s->comment ) {  // ; comment
+            fprintf( f,";%s\n", s->comment->string );
+        } else {
+            fprintf( f, "\n" );
+        }
+    }
+
+    // key = value; comment
+    p = s->firstParam;
+    while( p ) {
+        skip = includeignore && p->key && 
+            !strncmp( p->key->string, "#include", 8 );
+        if( p->key && p->key->string[0] == '#' ) {
+            // #preproc_key "value"; comment
+            if( skip ) {
+                goto goIgnore;
+            }
+            fprintf( f, "%s", p->key->string );
+            if( p->value ) {
+                fprintf( f, " \"%s\"", p->value->string );
+            }
+            goIgnore:
+            if( printcomment && p->comment ) {
+                fprintf( f, ";%s", p->comment->string );
+            }
+        } else {
+            // key = value; comment
+            if( p->key ) {
+                if( p->value || (printcomment && p->comment) ) {
+                    fprintf( f, "%-*s", keyalign, p->key->string );
+                } else {
+                    fprintf( f, "%s", p->key->string );
+                }
+            }
+            if( p->value ) {
+                if( spacebeforeeq && spaceaftereq ) {
+                    fprintf( f, " = %s", p->value->string );
+                } else if( spacebeforeeq ) {
+                    fprintf( f, " =%s", p->value->string );
+                } else if( spaceaftereq ) {
+                    fprintf( f, "= %s", p->value->string );
+                } else {
+                    fprintf( f, "=%s", p->value->string );
+                }
+            }
+            if( p->comment && printcomment ) {
+                fprintf( f, ";%s", p->comment->string );
+            }
+        }
+        // Only a skipped #include without a comment leaves the line empty,
+        // other directives (#print) still need their line break
+        if( (p->comment && printcomment) || (!skip && (p->key || p->value)) ) {
+            fprintf( f, "\n" );
+        } else if( printempty ) {
+            fprintf( f, "\n" );
+        }
+        p = p->next;
+    }
+        
+    // empty line after section
+    if( emptyline ) {
+        fprintf( f, "\n" );
+    }
+}
+
+/*
+================
+IniFprintFiledescr
+================
+*/
+static void IniFprintFiledescr( FILE* f, inidescr_t* d, int includeignore ) {
+    unsigned flags;
+    inisect_t* s;
+    
+    iniassert( f );
+    iniassert( d );
+    iniassert( d->ini );
+    
+    flags = d->ini->flags;
+    // print the file name at the top of the file
+    if( flags & INI_FLAG_PRINT_FNAME_TOP ) {
+        fprintf( f, "; %s\n", d->filename->string );
+    }
+    
+    s = d->gsect;
+    while( s ) {
+        IniFprintSect( f, s, includeignore );
+        s = s->fnext;
+    }
+    
+    // print the file name at the bottom of the file
+    if( flags & INI_FLAG_PRINT_FNAME_BOTTOM ) {
+        fprintf( f, "; %s\n", d->filename->string );
+    }
+}
+
+/*
+================
+IniFprint
+================
+*/
+static void IniFprint( FILE* f, ini_t* ini, int includeignore ) {
+    inisect_t* s;
+    
+    iniassert( f );
+    iniassert( ini );
+    
+    s = ini->firstSect;
+    while( s ) {
+        IniFprintSect( f, s, includeignore );
+        s = s->next;
+    }
+}
+
+/*
+================
+IniFreeSect
+================
+*/
+static void IniFreeSect( inisect_t* s ) {
+    ini_t* ini;
+    inidescr_t* descr;
+    iniparam_t* p;
+    iniparam_t* ptmp;
+    iniinh_t* inh;
+    iniinh_t* inhtmp;
+    iniinh_t* heir;
+    iniinh_t* heirtmp;
+    
+    iniassert( s );
+    iniassert( s->filename );
+    iniassert( s->filename->ini );
+    
+    descr = s->filename;
+    ini = descr->ini;
+    p = s->firstParam;
+    inh = s->inherit;
+    heir = s->heirs;
+    
+    IniEffectiveFree( ini, s );
+    IniIndexFree( ini, descr, &s->index );
+    IniSectIdFree( ini, s );
+    IniBloomFree( ini, s );
+    IniMphFree( ini, descr, &s->mph );
+    IniKeysFree( ini, descr, &s->keys );
+    // free sect key
+    if( s->key ) {
+        IniAtomRelease( ini, s->key );
+    }
+    // free sect comment
+    IniStringFree( ini, descr, s->comment );
+    // free sect parametr
+    while( p ) {
+        ptmp = p;
+        p = p->next;
+        IniParamFree( ini, descr, ptmp );
+    }
+    // free inherit
+    while( inh ) {
+        inhtmp = inh;
+        inh = inh->next;
+        IniMfree( ini, descr, INI_MTAG_INHERIT, inhtmp, sizeof(iniinh_t) );
+    }
+    // free heirs
+    while( heir ) {
+        heirtmp = heir;
+        heir = heir->next;
+        IniMfree( ini, descr, INI_MTAG_HEIR, heirtmp, sizeof(iniinh_t) );
+    }
+    // free section
+    IniMfree( ini, descr, INI_MTAG_SECT, s, sizeof(inisect_t) );
+}
+
+/*
+================
+IniScanBool
+================
+*/
+static int IniScanBool( char* str, char** endptr, unsigned char* b ) {
+    const struct { 
+        const char* val;
+        ptrdiff_t len;
+    } t[] = {
+        {"true", 4},    // 0
+        {"false", 5},   // 1
+        {"on", 2},      // 2
+        {"off", 3},     // 3
+        {NULL, 0}       // 4
+    };
+    
+    int i;
+    int v;
+    IniSkipSpaces( &str );
+    
+    if( isdigit((unsigned char)*str) ) {
+        // If is digit value (decimal)
+        if( sscanf( str, "%d", &v ) != 1 ) {
+            return -1;
+        }
+        while( isdigit((unsigned char)*str) || *str == '-' ) {
+            str++;
+        }
+        if( *str == 0 || IniIsSpace(*str) || *str == ',' ) {
+            if( endptr ) {
+                *endptr = str;
+            }
+            *b = !!v;
+            return 0;
+        }
+    } else {
+        // If value is string
+        for( i = 0; t[i].val; i++ ) {
+            if( !strncmp( str, t[i].val, t[i].len ) ) {
+                str += t[i].len;
+                if( *str == 0 || IniIsSpace(*str) || *str == ',' ) {
+                    if( endptr ) {
+                        *endptr = str;
+                    }
+                    *b = !(i & 1);
+                    return 0;
+                }
+                return -1;
+            }
+        }
+    }
+    
+    return -1;
+}
+
+/*
+================
+IniScanString
+
+  Прочитать строку из src в dst. Строка в кавычках читается до закрывающей
+кавычки с обработкой escape-последовательностей, иначе копируется весь
+остаток src. dst должен вмещать strlen( src ) + 1 байт
+================
+*/
+static int IniScanString( char* src, char** endptr, char* dst ) {
+    char c;
+    
+    IniSkipSpaces( &src );
+    c = *src;
+    if( c == 0 ) {
+        return -1;
+    }
+    // Escape sequences processed and can be string list separate of comma
+    if( c == '\'' || c == '\"' ) {
+        src++;
+        while( *src && *src != c ) {
+            if( *src == '\\' ) {
+                src++;
+                // A backslash at the end of the value is dropped
+                if( *src == 0 ) {
+                    break;
+                }
+                switch( *src++ ) {
+                    case '\'': *dst++ = '\''; break;
+                    case '"': *dst++ = '\"'; break;
+                    case '?': *dst++ = '\?'; break;
+                    case '\\': *dst++ = '\\'; break;
+                    case '0': *dst++ = '\0'; break;
+                    case 'b': *dst++ = '\b'; break;
+                    case 'f': *dst++ = '\f'; break;
+                    case 'n': *dst++ = '\n'; break;
+                    case 'r': *dst++ = '\r'; break;
+                    case 't': *dst++ = '\t'; break;
+                    case 'v': *dst++ = '\v'; break;
+                    default: *dst++ = src[-1]; break;
+                }
+            } else {
+                *dst++ = *src++;
+            }
+        }
+        *dst = 0;
+        if( *src == c ) {
+            src++;
+        }
+    } else {
+        while( *src ) {
+            *dst++ = *src++;
+        }
+        *dst = 0;
+    }
+    if( endptr ) {
+        *endptr = src;
+    }
+    return 0;
+}
+
+
+
+/*
+================
+IniCompactString / IniCompactSectSize / IniCompactSect
+
+  Вспомогательные функции для IniCompact. Скопированные объекты хранят в
+своём первом слове указатель на новую копию (INI_FORWARD), по нему
+переписываются ссылки на секции, описатели и интернированные строки.
+================
+*/
+#define INI_FORWARD(ptr)    (*(void**)(ptr))
+
+static ptrdiff_t IniCompactStringSize( const inistring_t* s ) {
+    return s ? INI_ALIGN(sizeof(inistring_t) + s->length + 1) : 0;
+}
+
+static inistring_t* IniCompactString( char** mem, const inistring_t* s ) {
+    inistring_t* ns;
+    
+    if( !s ) {
+        return NULL;
+    }
+    ns = (inistring_t*)*mem;
+    memcpy( ns, s, sizeof(inistring_t) + s->length + 1 );
+    ns->size = 0;
+    *mem += IniCompactStringSize( s );
+    return ns;
+}
+
+static ptrdiff_t IniCompactSectSize( const inisect_t* s ) {
+    const iniparam_t* p;
+    const iniinh_t* inh;
+    ptrdiff_t size;
+    
+    size = sizeof(inisect_t) + IniCompactStringSize( s->comment );
+    for( p = s->firstParam; p; p = p->next ) {
+        size += sizeof(iniparam_t) + IniCompactStringSize( p->value ) + 
+            IniCompactStringSize( p->comment );
+    }
+    for( inh = s->inherit; inh; inh = inh->next ) {
+        size += sizeof(iniinh_t);
+    }
+    for( inh = s->heirs; inh; inh = inh->next ) {
+        size += sizeof(iniinh_t);
+    }
+    return size;
+}
+
+// Old link records keep the next link to be freed later, the forwarding
+// pointer for the twin links is kept in prev
+#define INI_FORWARD_INH(inh)    ((inh)->prev)
+
+static iniinh_t* IniCompactInh( char** mem, iniinh_t* inh, iniinh_t** last ) {
+    iniinh_t* first;
+    iniinh_t* ninh;
+    
+    first = NULL;
+    *last = NULL;
+    for( ; inh; inh = inh->next ) {
+        // Section and twin pointers are rewritten when all sections are
+        // copied
+        ninh = (iniinh_t*)*mem;
+        *mem += sizeof(iniinh_t);
+        *ninh = *inh;
+        ninh->next = NULL;
+        ninh->prev = *last;
+        if( *last ) {
+            (*last)->next = ninh;
+        } else {
+            first = ninh;
+        }
+        *last = ninh;
+        INI_FORWARD_INH( inh ) = ninh;
+    }
+    return first;
+}
+
+static void IniCompactFreeInh( ini_t* ini, inidescr_t* descr, unsigned tag, iniinh_t* inh ) {
+    iniinh_t* next;
+    
+    for( ; inh; inh = next ) {
+        next = inh->next;
+        IniMfree( ini, descr, tag, inh, sizeof(iniinh_t) );
+    }
+}
+
+static inisect_t* IniCompactSect( ini_t* ini, char** mem, inisect_t* s ) {
+    inidescr_t* descr;
+    inisect_t* ns;
+    iniparam_t* p;
+    iniparam_t* np;
+    iniparam_t* next;
+    ptrdiff_t size;
+    ptrdiff_t i;
+    
+    descr = s->filename;
+    
+    // Section, its parameters and its links follow each other
+    ns = (inisect_t*)*mem;
+    *mem += sizeof(inisect_t);
+    *ns = *s;
+    ns->key = s->key ? (inistring_t*)INI_FORWARD( s->key ) : NULL;
+    ns->comment = IniCompactString( mem, s->comment );
+    IniStringFree( ini, descr, s->comment );
+    
+    ns->firstParam = NULL;
+    ns->lastParam = NULL;
+    p = s->firstParam;
+    while( p ) {
+        np = (iniparam_t*)*mem;
+        *mem += sizeof(iniparam_t);
+        np->next = NULL;
+        np->prev = ns->lastParam;
+        np->sect = ns;
+        np->key = p->key ? (inistring_t*)INI_FORWARD( p->key ) : NULL;
+        np->value = IniCompactString( mem, p->value );
+        np->comment = IniCompactString( mem, p->comment );
+        if( ns->lastParam ) {
+            ns->lastParam->next = np;
+        } else {
+            ns->firstParam = np;
+        }
+        ns->lastParam = np;
+        // Old parameter keeps the new address until the key array is
+        // rewritten
+        p->sect = (inisect_t*)np;
+        p = p->next;
+    }
+    
+    // The key array is kept, its order may differ from the list order
+    if( ns->keys ) {
+        for( i = 0; i < ns->keys->count; i++ ) {
+            ns->keys->params[i] = (iniparam_t*)ns->keys->params[i]->sect;
+        }
+    }
+    
+    p = s->firstParam;
+    while( p ) {
+        next = p->next;
+        size = IniParamSize( p );
+        IniStringFree( ini, descr, p->value );
+        IniStringFree( ini, descr, p->comment );
+        IniMfree( ini, descr, INI_MTAG_PARAM, p, size );
+        p = next;
+    }
+    
+    ns->inherit = IniCompactInh( mem, s->inherit, &ns->inheritLast );
+    ns->heirs = IniCompactInh( mem, s->heirs, &ns->heirsLast );
+    
+    INI_FORWARD( s ) = ns;
+    return ns;
+}
+
+static ptrdiff_t IniCompactDescrSize( const inidescr_t* d ) {
+    const inisect_t* s;
+    ptrdiff_t size;
+    
+    // The file list of the descriptor starts with its global section
+    size = sizeof(inidescr_t) + IniCompactStringSize( d->filename );
+    for( s = d->gsect; s; s = s->fnext ) {
+        size += IniCompactSectSize( s );
+    }
+    return size;
+}
+
+static void IniCompactFixSect( inisect_t* ns ) {
+    iniinh_t* inh;
+    
+    if( ns->fnext ) {
+        ns->fnext = (inisect_t*)INI_FORWARD( ns->fnext );
+    }
+    if( ns->fprev ) {
+        ns->fprev = (inisect_t*)INI_FORWARD( ns->fprev );
+    }
+    if( ns->prev ) {
+        ns->prev = (inisect_t*)INI_FORWARD( ns->prev );
+    }
+    ns->filename = (inidescr_t*)INI_FORWARD( ns->filename );
+    for( inh = ns->inherit; inh; inh = inh->next ) {
+        inh->inhSect = (inisect_t*)INI_FORWARD( inh->inhSect );
+        inh->sect = ns;
+        inh->twin = INI_FORWARD_INH( inh->twin );
+    }
+    for( inh = ns->heirs; inh; inh = inh->next ) {
+        inh->inhSect = (inisect_t*)INI_FORWARD( inh->inhSect );
+        inh->sect = ns;
+        inh->twin = INI_FORWARD_INH( inh->twin );
+    }
+}
+
+
+
+/*
+================================================================
+
+                    definition of functions
+                    
+================================================================
+*/
+
+/*
+================
+IniInit
+================
+*/
+void IniInit( ini_t* ini, fnIniMalloc malloc, fnIniFree free, fnIniMallocTag memtag, char* buf, ptrdiff_t size ) {
+    iniassert( ini );
+    iniassert( malloc );
+    iniassert( free );
+    
+    ini->inimalloc = malloc;
+    ini->inifree = free;
+    ini->inimemtag = memtag;
+    ini->errbuf = buf;
+    ini->errbufSize = size;
+    ini->numOfErrors = 0;
+    ini->numOfWarnings = 0;
+    ini->firstDiag = NULL;
+    ini->lastDiag = NULL;
+    ini->bufFill = 0;
+    ini->flags = INI_FLAG_CHECK_FOR_SECT;
+    ini->firstSect = NULL;
+    ini->lastSect = NULL;
+    ini->filenames = NULL;
+    ini->lastfname = NULL;
+    ini->atoms = NULL;
+    ini->atomsSize = 0;
+    ini->numAtoms = 0;
+    ini->arena = NULL;
+    ini->arenaSize = 0;
+    memset( &ini->mem, 0, sizeof(inimemstats_t) );
+    ini->numEffective = 0;
+    ini->sectIndex = NULL;
+    ini->sectTable = NULL;
+    ini->sectTableSize = 0;
+    ini->sectTableCount = 0;
+    ini->numDupSects = 0;
+    ini->keyIndex = NULL;
+    ini->keyIndexSize = 0;
+    ini->keyIndexCount = 0;
+    ini->sectById = NULL;
+    ini->freeIds = NULL;
+    ini->numIds = 0;
+    ini->numFreeIds = 0;
+    ini->idsSize = 0;
+    ini->numClosures = 0;
+    ini->bloomBits = 0;
+    memset( &ini->bloom, 0, sizeof(inibloomstats_t) );
+    ini->sectMph = NULL;
+    ini->numMph = 0;
+    ini->profThreads = NULL;
+    ini->profId = 0;
+    memset( &ini->load, 0, sizeof(iniloadstats_t) );
+}
+
+/*
+================
+IniFree
+================
+*/
+void IniFree( ini_t* ini ) {
+    inisect_t* s;
+    inisect_t* stmp;
+    inidescr_t* d;
+    inidescr_t* dtmp;
+    
+    iniassert( ini );
+    iniassert( ini->inifree );
+    
+    IniIndexFree( ini, NULL, &ini->sectIndex );
+    IniKeyIndexFree( ini );
+    IniMphFree( ini, NULL, &ini->sectMph );
+    IniProfFree( ini );
+    IniClearErrors( ini );
+    if( ini->sectTable ) {
+        IniMfree( ini, NULL, INI_MTAG_INDEX, ini->sectTable, 
+            ini->sectTableSize * sizeof(inisect_t*) );
+    }
+    
+    s = ini->firstSect;
+    // free sect
     while( s ) {
-        IniFprintSect( f, s, includeignore );
-        s = s->fnext;
+        stmp = s;
+        s = s->next;
+        IniFreeSect(stmp);
+    }
+    
+    d = ini->filenames;
+    // free filenames
+    while( d ) {
+        s = d->gsect;
+        
+        IniFreeSect(s);
+        
+        IniStringFree( ini, d, d->filename );
+        
+        dtmp = d;
+        d = d->next;
+        IniMfree( ini, dtmp, INI_MTAG_DESCR, dtmp, sizeof(inidescr_t) );
+    }
+    
+    // all the interned strings were released with the sections
+    iniassert( ini->numAtoms == 0 );
+    if( ini->atoms ) {
+        ini->inifree( ini->atoms );
+    }
+    if( ini->arena ) {
+        ini->inifree( ini->arena );
+    }
+    if( ini->sectById ) {
+        IniMfree( ini, NULL, INI_MTAG_CLOSURE, ini->sectById, 
+            ini->idsSize * sizeof(inisect_t*) );
+        IniMfree( ini, NULL, INI_MTAG_CLOSURE, ini->freeIds, 
+            ini->idsSize * sizeof(ptrdiff_t) );
+    }
+    
+    memset( ini, 0, sizeof(ini_t) );
+}
+
+/*
+================
+IniClearErrors
+================
+*/
+void IniClearErrors( ini_t* ini ) {
+    inidiag_t* diag;
+    inidiag_t* next;
+    
+    iniassert( ini );
+    
+    if( ini->errbuf ) {
+        ini->errbuf[0] = 0;
+    }
+    for( diag = ini->firstDiag; diag; diag = next ) {
+        next = diag->next;
+        IniMfree( ini, NULL, INI_MTAG_DIAG, diag, sizeof(inidiag_t) + 
+            (diag->arg ? strlen( diag->arg ) + 1 : 0) + 
+            (diag->arg2 ? strlen( diag->arg2 ) + 1 : 0) );
+    }
+    ini->firstDiag = NULL;
+    ini->lastDiag = NULL;
+    ini->numOfErrors = 0;
+    ini->numOfWarnings = 0;
+    ini->flags &= ~0x1;
+    ini->bufFill = 0;
+}
+
+/*
+================
+IniFirstDiag
+================
+*/
+inidiag_t* IniFirstDiag( ini_t* ini ) {
+    iniassert( ini );
+    return ini->firstDiag;
+}
+
+/*
+================
+IniFormatDiag
+================
+*/
+ptrdiff_t IniFormatDiag( const inidiag_t* diag, char* buf, ptrdiff_t size ) {
+    const char* args[2];
+    const char* fmt;
+    const char* str;
+    char num[32];
+    ptrdiff_t pos;
+    int arg;
+    
+    iniassert( diag );
+    iniassert( diag->code > 0 && diag->code < INI_DIAG_COUNT );
+    iniassert( buf || size == 0 );
+    
+    pos = 0;
+    args[0] = diag->arg;
+    args[1] = diag->arg2;
+    arg = 0;
+    
+    str = diag->severity == INI_DIAG_WARNING ? "warning: " : "error: ";
+    IniDiagPut( buf, size, &pos, str, strlen( str ) );
+    
+    // Only '%s' is used in the messages
+    for( fmt = inidiaginfo[diag->code].message; *fmt; fmt++ ) {
+        if( fmt[0] == '%' && fmt[1] == 's' ) {
+            str = arg < 2 && args[arg] ? args[arg] : "";
+            IniDiagPut( buf, size, &pos, str, strlen( str ) );
+            arg++;
+            fmt++;
+        } else {
+            IniDiagPut( buf, size, &pos, fmt, 1 );
+        }
+    }
+    
+    if( diag->line > 0 && diag->descr ) {
+        sprintf( num, " line:%d file:'", diag->line );
+        IniDiagPut( buf, size, &pos, num, strlen( num ) );
+        str = diag->descr->filename->string;
+        IniDiagPut( buf, size, &pos, str, strlen( str ) );
+        IniDiagPut( buf, size, &pos, "'", 1 );
+    }
+    IniDiagPut( buf, size, &pos, "\n", 1 );
+    
+    if( size > 0 ) {
+        buf[pos < size ? pos : size - 1] = 0;
+    }
+    return pos;
+}
+
+/*
+================
+IniSetParseComments
+================
+*/
+void IniSetParseComments( ini_t* ini, unsigned char flag ) {
+    iniassert( ini );
+    INI_SET_BIT(ini->flags, INI_FLAG_PARSE_COMMENTS, flag);
+}
+
+/*
+================
+IniSetKeyAlign
+================
+*/
+void IniSetKeyAlign( ini_t* ini, unsigned char align ) {
+    iniassert( ini );
+    ini->flags = (((unsigned)align) << 24) | (ini->flags & 0xffffff);
+}
+
+/*
+================
+IniSetEmptyLineAfterSection
+================
+*/
+void IniSetEmptyLineAfterSection( ini_t* ini, unsigned char flag ) {
+    iniassert( ini );
+    INI_SET_BIT(ini->flags, INI_FLAG_EMPTY_LINE_AFTER_SECT, flag );
+}
+
+/*
+================
+IniSetSpaceBeforeEqual
+================
+*/
+void IniSetSpaceBeforeEqual( ini_t* ini, unsigned char flag ) {
+    iniassert( ini );
+    INI_SET_BIT(ini->flags, INI_FLAG_SPACE_BEFORE_EQ, flag );
+}
+
+/*
+================
+IniSetSpaceAfterEqual
+================
+*/
+void IniSetSpaceAfterEqual( ini_t* ini, unsigned char flag ) {
+    iniassert( ini );
+    INI_SET_BIT(ini->flags, INI_FLAG_SPACE_AFTER_EQ, flag );
+}
+
+/*
+================
+IniSetPrintComments
+================
+*/
+void IniSetPrintComments( ini_t* ini, unsigned char flag ) {
+    iniassert( ini );
+    INI_SET_BIT(ini->flags, INI_FLAG_PRINT_COMMENTS, flag);
+}
+
+/*
+================
+IniSetPrintEmptyLines
+================
+*/
+void IniSetPrintEmptyLines( ini_t* ini, unsigned char flag ) {
+    iniassert( ini );
+    INI_SET_BIT(ini->flags, INI_FLAG_PRINT_EMPTY_LINES, flag);
+}
+
+/*
+================
+IniSetPrintFilenameInTop
+================
+*/
+void IniSetPrintFilenameInTop( ini_t* ini, unsigned char flag ) {
+    iniassert( ini );
+    INI_SET_BIT(ini->flags, INI_FLAG_PRINT_FNAME_TOP, flag);
+}
+
+/*
+================
+IniSetPrintFilenameInBottom
+================
+*/
+void IniSetPrintFilenameInBottom( ini_t* ini, unsigned char flag ) {
+    iniassert( ini );
+    INI_SET_BIT(ini->flags, INI_FLAG_PRINT_FNAME_BOTTOM, flag);
+}
+
+/*
+================
+IniSetPrintHeirsBeforeSect
+================
+*/
+void IniSetPrintHeirsBeforeSect( ini_t* ini, unsigned char flag ) {
+    iniassert( ini );
+    INI_SET_BIT(ini->flags, INI_FLAG_PRINT_HEIRS, flag);
+}
+
+/*
+================
+IniSetCheckForSections
+================
+*/
+void IniSetCheckForSections( ini_t* ini, unsigned char flag ) {
+    iniassert( ini );
+    INI_SET_BIT(ini->flags, INI_FLAG_CHECK_FOR_SECT, flag);
+}
+
+/*
+================
+IniSetCheckForParameters
+================
+*/
+void IniSetCheckForParameters( ini_t* ini, unsigned char flag ) {
+    iniassert( ini );
+    INI_SET_BIT(ini->flags, INI_FLAG_CHECK_FOR_PARAM, flag);
+}
+
+/*
+================
+IniSetAdaptiveLookup
+================
+*/
+void IniSetAdaptiveLookup( ini_t* ini, unsigned char flag ) {
+    iniassert( ini );
+    INI_SET_BIT(ini->flags, INI_FLAG_ADAPTIVE_LOOKUP, flag);
+}
+
+/*
+================
+IniSetProfiling
+================
+*/
+void IniSetProfiling( ini_t* ini, unsigned char flag ) {
+    iniassert( ini );
+    
+    if( flag && !ini->profId ) {
+        ini->profId = INI_ATOMIC_INC( &iniProfGeneration );
     }
+    INI_SET_BIT(ini->flags, INI_FLAG_PROFILE, flag);
+}
+
+/*
+================
+IniResetProfile
+================
+*/
+void IniResetProfile( ini_t* ini ) {
+    iniassert( ini );
     
-    // print the file name at the bottom of the file
-    if( flags & INI_FLAG_PRINT_FNAME_BOTTOM ) {
-        fprintf( f, "; %s\n", d->filename->string );
+    // The new generation makes the threads forget their old counters
+    IniProfFree( ini );
+    ini->profId = INI_ATOMIC_INC( &iniProfGeneration );
+}
+
+/*
+================
+IniProfLoadEntry
+
+  Прочитать счётчики другого потока. Название и вид записи не меняются после
+публикации, счётчики читаются атомарно
+================
+*/
+static void IniProfLoadEntry( iniprofentry_t* dst, iniprofentry_t* src ) {
+    int b;
+    
+    dst->kind = src->kind;
+    dst->name = src->name;
+    dst->length = src->length;
+    dst->calls = INI_ATOMIC_LOAD( &src->calls );
+    dst->hits = INI_ATOMIC_LOAD( &src->hits );
+    dst->inheritedHits = INI_ATOMIC_LOAD( &src->inheritedHits );
+    dst->misses = INI_ATOMIC_LOAD( &src->misses );
+    dst->depth = INI_ATOMIC_LOAD( &src->depth );
+    dst->maxDepth = INI_ATOMIC_LOAD( &src->maxDepth );
+    for( b = 0; b < INI_PROF_BUCKETS; b++ ) {
+        dst->latency[b] = INI_ATOMIC_LOAD( &src->latency[b] );
     }
 }
 
 /*
 ================
-IniFprint
+IniGetProfile
 ================
 */
-static void IniFprint( FILE* f, ini_t* ini, int includeignore ) {
-    inisect_t* s;
+ptrdiff_t IniGetProfile( ini_t* ini, iniprofentry_t* entries, ptrdiff_t max ) {
+    iniprofthread_t* rec;
+    iniproftable_t* table;
+    iniprofentry_t** all;
+    iniprofentry_t* merged;
+    iniprofentry_t* m;
+    iniprofentry_t* e;
+    iniprofentry_t entry;
+    ptrdiff_t total;
+    ptrdiff_t count;
+    ptrdiff_t i;
+    int b;
+    
+    iniassert( ini );
+    iniassert( entries || !max );
+    
+    // The list and the tables only grow, so the snapshot is consistent.
+    // Tables and entries are published by release stores of their threads
+    total = 0;
+    for( rec = (iniprofthread_t*)INI_ATOMIC_ACQUIRE( &ini->profThreads ); 
+        rec; rec = rec->next ) 
+    {
+        table = (iniproftable_t*)INI_ATOMIC_ACQUIRE( &rec->table );
+        total += INI_ATOMIC_LOAD( &table->count );
+    }
+    if( !total ) {
+        return 0;
+    }
+    all = (iniprofentry_t**)ini->inimalloc( total * sizeof(iniprofentry_t*) );
+    merged = (iniprofentry_t*)ini->inimalloc( total * sizeof(iniprofentry_t) );
+    
+    count = 0;
+    for( rec = (iniprofthread_t*)INI_ATOMIC_ACQUIRE( &ini->profThreads ); 
+        rec; rec = rec->next ) 
+    {
+        table = (iniproftable_t*)INI_ATOMIC_ACQUIRE( &rec->table );
+        for( i = 0; i < table->size && count < total; i++ ) {
+            e = (iniprofentry_t*)INI_ATOMIC_ACQUIRE( &table->items[i] );
+            if( e ) {
+                all[count++] = e;
+            }
+        }
+    }
+    total = count;
+    
+    // Equal keys of different threads follow each other
+    qsort( all, total, sizeof(iniprofentry_t*), IniProfCompareName );
+    count = 0;
+    for( i = 0; i < total; i++ ) {
+        IniProfLoadEntry( &entry, all[i] );
+        if( count && !IniProfCompareName( all + i, &m ) ) {
+            m->calls += entry.calls;
+            m->hits += entry.hits;
+            m->inheritedHits += entry.inheritedHits;
+            m->misses += entry.misses;
+            m->depth += entry.depth;
+            if( entry.maxDepth > m->maxDepth ) {
+                m->maxDepth = entry.maxDepth;
+            }
+            for( b = 0; b < INI_PROF_BUCKETS; b++ ) {
+                m->latency[b] += entry.latency[b];
+            }
+            continue;
+        }
+        m = merged + count++;
+        *m = entry;
+    }
+    
+    qsort( merged, count, sizeof(iniprofentry_t), IniProfCompareCalls );
+    if( max ) {
+        memcpy( entries, merged, (max < count ? max : count) * sizeof(iniprofentry_t) );
+    }
     
+    ini->inifree( merged );
+    ini->inifree( all );
+    return count;
+}
+
+/*
+================
+IniPrintProfile
+================
+*/
+void IniPrintProfile( ini_t* ini, FILE* f, ptrdiff_t n ) {
+    static const char* kinds[] = { "sect", "param", "read" };
+    iniprofentry_t* entries;
+    iniprofentry_t* e;
+    ptrdiff_t count;
+    ptrdiff_t i;
+    
+    iniassert( ini );
     iniassert( f );
+    
+    fprintf( f, "kind\tname\tcalls\thits\tinherited\tmisses\tavgdepth\t\
+maxdepth\tp50ns\tp99ns\n" );
+    if( n <= 0 ) {
+        return;
+    }
+    entries = (iniprofentry_t*)ini->inimalloc( n * sizeof(iniprofentry_t) );
+    count = IniGetProfile( ini, entries, n );
+    for( i = 0; i < count && i < n; i++ ) {
+        e = entries + i;
+        fprintf( f, "%s\t%s\t%ld\t%ld\t%ld\t%ld\t%.2f\t%ld\t%.0f\t%.0f\n", 
+            kinds[e->kind], e->name, (long)e->calls, (long)e->hits, 
+            (long)e->inheritedHits, (long)e->misses, 
+            e->calls ? (double)e->depth / (double)e->calls : 0.0, 
+            (long)e->maxDepth, IniProfPercentile( e, 0.5 ), 
+            IniProfPercentile( e, 0.99 ) );
+    }
+    ini->inifree( entries );
+}
+
+/*
+================
+IniSetBloomFilters
+================
+*/
+void IniSetBloomFilters( ini_t* ini, ptrdiff_t bits ) {
     iniassert( ini );
+    iniassert( bits >= 0 );
     
-    s = ini->firstSect;
-    while( s ) {
-        IniFprintSect( f, s, includeignore );
-        s = s->next;
+    IniBloomFreeAll( ini );
+    if( bits ) {
+        for( ini->bloomBits = INI_WORD_BITS; ini->bloomBits < bits; 
+            ini->bloomBits *= 2 );
+    } else {
+        ini->bloomBits = 0;
+    }
+    memset( &ini->bloom, 0, sizeof(inibloomstats_t) );
+}
+
+/*
+================
+IniExcludeParam
+================
+*/
+void IniExcludeParam( iniparam_t* param ) {
+    inisect_t* sect;
+    
+    iniassert( param );
+    
+    sect = param->sect;
+    IniUnlinkParam_s( param );
+    
+    // free parameter
+    IniParamFree( sect->filename->ini, sect->filename, param );
+}
+
+/*
+================
+IniExcludeInherit
+================
+*/
+void IniExcludeInherit( iniinh_t* inh ) {
+    iniassert( inh );
+    iniassert( inh->sect->inherit );
+    
+    IniExcludeLink( inh );
+}
+
+/*
+================
+IniExcludeHeir
+================
+*/
+void IniExcludeHeir( iniinh_t* inh ) {
+    iniassert( inh );
+    iniassert( inh->sect->heirs );
+    
+    IniExcludeLink( inh->twin );
+}
+
+/*
+================
+IniExcludeSect
+================
+*/
+void IniExcludeSect( inisect_t* sect ) {
+    iniassert( sect );
+    iniassert( sect->filename );
+    iniassert( sect->filename->ini );
+    iniassert( sect->filename->gsect != sect );
+    iniassert( sect->filename->ini->inifree );
+
+    // exclude from ini_t and inidescr_t
+    IniUnlinkSect_s( sect );
+
+    // remove all links, the paired records of other sections go with them
+    while( sect->inherit ) {
+        IniExcludeLink( sect->inherit );
+    }
+    while( sect->heirs ) {
+        IniExcludeLink( sect->heirs->twin );
+    }
+
+    IniFreeSect( sect );
+}
+
+/*
+================
+IniExcludeSects
+================
+*/
+int IniExcludeSects( ini_t* ini, fnIniFilter filter, void* userData ) {
+    inisect_t* s;
+    inisect_t* next;
+    int count;
+    
+    iniassert( ini );
+    iniassert( filter );
+    
+    // Excluding a section never removes other sections, so the next one
+    // stays valid
+    count = 0;
+    for( s = ini->firstSect; s; s = next ) {
+        next = s->next;
+        if( filter( s, userData ) ) {
+            IniExcludeSect( s );
+            count++;
+        }
     }
+    return count;
+}
+
+
+
+/*
+================
+IniAppendDescr
+================
+*/
+inidescr_t* IniAppendDescr( ini_t* ini, const char* filename ) {
+    inidescr_t* d;
+    
+    iniassert( ini );
+    iniassert( filename );
+    iniassert( filename[0] != 0 );
+    
+    d = IniDescrCreate( ini, filename, -1 );
+    IniAppendDescr_s( ini, d );
+    return d;
+}
+
+/*
+================
+IniAppendSect
+================
+*/
+inisect_t* IniAppendSect( inidescr_t* descr, const char* key ) {
+    inisect_t* s;
+    
+    iniassert( descr );
+    iniassert( key );
+    iniassert( key[0] != 0 );
+
+    s = IniSectCreate( descr->ini, descr,
+        IniAtomCreate( descr->ini, key, -1 ),
+        NULL, 1
+    );
+    IniAppendSect_s( descr, s );
+    return s;
+}
+
+/*
+================
+IniAppendInclude
+================
+*/
+iniparam_t* IniAppendInclude( inidescr_t* descr, const char* filename ) {
+    iniassert( descr );
+    iniassert( descr->gsect );
+    iniassert( descr->gsect->filename );
+    iniassert( descr->gsect->filename->ini );
+    iniassert( filename );
+    iniassert( filename[0] != 0 );
+    
+    return IniAppendIncludeToSect( descr->gsect, filename );
+}
+
+/*
+================
+IniAppendIncludeToSect
+================
+*/
+iniparam_t* IniAppendIncludeToSect( inisect_t* sect, const char* filename ) {
+    ini_t* ini;
+    iniparam_t* p;
+    
+    iniassert( sect );
+    iniassert( sect->filename );
+    iniassert( sect->filename->ini );
+    iniassert( filename );
+    iniassert( filename[0] != 0 );
+    
+    ini = sect->filename->ini;
+    p = IniParamCreate(
+        ini,
+        sect->filename,
+        IniAtomCreate( ini, "#include", 8 ),
+        filename, -1,
+        NULL, 0
+    );
+    IniAppendParam_s( sect, p );
+    return p;
+}
+
+/*
+================
+IniAppendParam
+================
+*/
+iniparam_t* IniAppendParam( inisect_t* sect, const char* key, const char* val ) {
+    ini_t* ini;
+    iniparam_t* p;
+    
+    iniassert( sect );
+    iniassert( sect->filename );
+    iniassert( sect->filename->ini );
+    iniassert( key );
+    iniassert( key[0] != 0 );
+    
+    ini = sect->filename->ini;
+    p = IniParamCreate(
+        ini,
+        sect->filename,
+        IniAtomCreate( ini, key, -1 ),
+        val, -1,
+        NULL, 0
+    );
+    IniAppendParam_s( sect, p );
+    return p;
+}
+
+/*
+================
+IniAppendComment
+================
+*/
+iniparam_t* IniAppendComment( inisect_t* sect, const char* comment ) {
+    ini_t* ini;
+    iniparam_t* p;
+    
+    iniassert( sect );
+    iniassert( sect->filename );
+    iniassert( sect->filename->ini );
+    
+    ini = sect->filename->ini;
+    p = IniParamCreate(
+        ini,
+        sect->filename,
+        NULL,
+        NULL, 0,
+        comment, -1
+    );
+    IniAppendParam_s( sect, p );
+    return p;
 }
 
+
 /*
 ================
-IniExcludeFromInherit
-
-  Исключить из списка from->inherit указатель на секцию ptrTo.
-Функция ищет структуру наследования, в которой хранится указатель ptrTo и
-исключает структуру из списка.
-  Фукнция возвращает указатель на исключённую структуру, или NULL если не
-удалось найти структуру.
+IniFindSect
 ================
 */
-static iniinh_t* IniExcludeFromInherit( inisect_t* from, inisect_t* exclude ) {
-    iniinh_t* it;
-    iniinh_t* ret;
-
-    iniassert( from );
-    iniassert( exclude );
-
-    it = from->inherit;
-    ret = NULL;
-    // exclude from inherit
-    if( it->inhSect == exclude ) { // is first
-        ret = it;
-        from->inherit = it->next;
-    } else {
-        while( it->next ) {
-            if( it->next->inhSect == exclude ) {
-                ret = it->next;
-                it->next = ret->next;
-                break;
-            }
-            it = it->next;
-        }
+inisect_t* IniFindSect( ini_t* ini, const char* key ) {
+    inistring_t* atom;
+    ptrdiff_t len;
+    
+    iniassert( ini );
+    iniassert( key );
+    iniassert( key[0] != 0 );
+    
+    len = (ptrdiff_t)strlen( key );
+    if( ini->flags & INI_FLAG_PROFILE ) {
+        return IniProfFindSect( ini, key, len, IniHash( key, len ) );
     }
-    if( it != NULL ) {
-        from->inheritLast = it;
+    atom = IniAtomFind( ini, key, len, IniHash( key, len ) );
+    if( !atom ) {
+        return NULL;
     }
-    
-    return ret;
+    return IniFindSectAtom( ini, atom );
 }
 
 /*
 ================
-IniExcludeFromHeir
-
-  Исключить из списка from->heir указатель на секцию ptrTo.
-Функция ищет структуру наследования, в которой хранится указатель ptrTo и
-исключает структуру из списка.
-  Фукнция возвращает указатель на исключённую структуру, или NULL если не
-удалось найти структуру.
+IniFindParam
 ================
 */
-static iniinh_t* IniExcludeFromHeir( inisect_t* from, inisect_t* exclude ) {
-    iniinh_t* it;
-    iniinh_t* ret;
-
-    iniassert( from );
-    iniassert( exclude );
-
-    it = from->heirs;
-    ret = NULL;
-    // exclude from heirs
-    if( it->inhSect == exclude ) { // is first
-        ret = it;
-        from->heirs = it->next;
-    } else {
-        while( it->next ) {
-            if( it->next->inhSect == exclude ) {
-                ret = it->next;
-                it->next = ret->next;
-                break;
-            }
-            it = it->next;
-        }
+iniparam_t* IniFindParam( inisect_t* sect, const char* key ) {
+    inistring_t* atom;
+    ptrdiff_t len;
+    
+    iniassert( sect );
+    iniassert( sect->filename );
+    iniassert( sect->filename->ini );
+    iniassert( key );
+    iniassert( key[0] != 0 );
+    
+    // The key which is not interned is not used in any section
+    len = (ptrdiff_t)strlen( key );
+    if( sect->filename->ini->flags & INI_FLAG_PROFILE ) {
+        return IniProfFindParam( sect, key, len, IniHash( key, len ) );
     }
-    if( it != NULL ) {
-        from->heirsLast = it;
+    atom = IniAtomFind( sect->filename->ini, key, len, IniHash( key, len ) );
+    if( !atom ) {
+        return NULL;
     }
-    
-    return ret;
+    return IniFindParamAtom( sect, atom );
 }
 
 /*
 ================
-IniFreeSect
+IniFind
 ================
 */
-static void IniFreeSect( inisect_t* s ) {
-    fnIniFree free;
-    iniparam_t* p;
-    iniparam_t* ptmp;
-    iniinh_t* inh;
-    iniinh_t* inhtmp;
-    iniinh_t* heir;
-    iniinh_t* heirtmp;
-    
-    iniassert( s );
-    iniassert( s->filename );
-    iniassert( s->filename->ini );
+iniparam_t* IniFind( ini_t* ini, const char* sect, const char* param ) {
+    inisect_t* found;
     
-    free = s->filename->ini->inifree;
-    p = s->firstParam;
-    inh = s->inherit;
-    heir = s->heirs;
+    iniassert( ini );
+    iniassert( sect );
+    iniassert( sect[0] != 0 );
+    iniassert( param );
+    iniassert( param[0] != 0 );
     
-    // free sect key
-    if( s->key ) {
-        free( s->key );
-    }
-    // free sect comment
-    if( s->comment ) {
-        free( s->comment );
-    }
-    // free sect parametr
-    while( p ) {
-        // free parametr key
-        if( p->key ) {
-            free( p->key );
-        }
-        // free parametr value
-        if( p->value ) {
-            free( p->value );
-        }
-        // free parametr comment
-        if( p->comment ) {
-            free( p->comment );
-        }
-            
-        ptmp = p;
-        p = p->next;
-        free(ptmp);
-    }
-    // free inherit
-    while( inh ) {
-        inhtmp = inh;
-        inh = inh->next;
-        free(inhtmp);
-    }
-    // free heirs
-    while( heir ) {
-        heirtmp = heir;
-        heir = heir->next;
-        free(heirtmp);
+    found = IniFindSect( ini, sect );
+    if( found ) {
+        return IniFindParam( found, param );
     }
-    // free section
-    free(s);
+    return NULL;
 }
 
 /*
 ================
-IniScanBool
+IniKeyMake
 ================
 */
-static int IniScanBool( char* str, char** endptr, unsigned char* b ) {
-    const struct { 
-        const char* val;
-        ptrdiff_t len;
-    } t[] = {
-        {"true", 4},    // 0
-        {"false", 5},   // 1
-        {"on", 2},      // 2
-        {"off", 3},     // 3
-        {NULL, 0}       // 4
-    };
-    
-    int i;
-    int v;
-    IniSkipSpaces( &str );
+inikey_t IniKeyMake( const char* str ) {
+    inikey_t key;
     
-    if( isdigit(*str) ) {
-        // If is digit value (decimal)
-        if( sscanf( str, "%d", &v ) != 1 ) {
-            return -1;
-        }
-        while( isdigit(*str) || *str == '-' ) {
-            str++;
-        }
-        if( *str == 0 || IniIsSpace(*str) || *str == ',' ) {
-            if( endptr ) {
-                *endptr = str;
-            }
-            *b = !!v;
-            return 0;
-        }
-    } else {
-        // If value is string
-        for( i = 0; t[i].val; i++ ) {
-            if( !strncmp( str, t[i].val, t[i].len ) ) {
-                str += t[i].len;
-                if( *str == 0 || IniIsSpace(*str) || *str == ',' ) {
-                    if( endptr ) {
-                        *endptr = str;
-                    }
-                    *b = !(i & 1);
-                    return 0;
-                }
-                return -1;
-            }
-        }
-    }
+    iniassert( str );
+    iniassert( str[0] != 0 );
     
-    return -1;
+    key.string = str;
+    key.length = (ptrdiff_t)strlen( str );
+    key.hash = IniHash( str, key.length );
+    return key;
 }
 
 /*
 ================
-IniScanString
+IniKeyHash
+
+  Хеш ключа. Хеш ключа, объявленного через INI_KEY, считается при первом
+использовании. Ключ может искаться из нескольких потоков сразу, поэтому хеш
+читается и записывается атомарно: все потоки пишут одно и то же значение
 ================
 */
-static int IniScanString( char* src, char** endptr, char* dst ) {
-    char c;
+static unsigned IniKeyHash( inikey_t* key ) {
+    unsigned hash;
     
-    IniSkipSpaces( &src );
-    c = *src;
-    if( c == 0 ) {
-        return -1;
-    }
-    // Escape sequences processed and can be string list separate of comma
-    if( c == '\'' || c == '\"' ) {
-        src++;
-        while( *src && *src != c ) {
-            if( *src == '\\' ) {
-                src++;
-                switch( *src++ ) {
-                    case '\'': *dst++ = '\''; break;
-                    case '"': *dst++ = '\"'; break;
-                    case '?': *dst++ = '\?'; break;
-                    case '\\': *dst++ = '\\'; break;
-                    case '0': *dst++ = '\0'; break;
-                    case 'b': *dst++ = '\b'; break;
-                    case 'f': *dst++ = '\f'; break;
-                    case 'n': *dst++ = '\n'; break;
-                    case 'r': *dst++ = '\r'; break;
-                    case 't': *dst++ = '\t'; break;
-                    case 'v': *dst++ = '\v'; break;
-                    default: *dst++ = *src; break;
-                }
-            } else {
-                *dst = *src;
-            }
-        }
-        if( *src == c ) {
-            src++;
-        }
-    } else {
-        while( *src ) {
-            *dst++ = *src++;
-        }
-        *dst = 0;
-    }
-    if( endptr ) {
-        *endptr = src;
+    hash = INI_ATOMIC_LOAD( &key->hash );
+    if( !hash ) {
+        hash = IniHash( key->string, key->length );
+        INI_ATOMIC_STORE( &key->hash, hash );
     }
-    return 0;
+    return hash;
 }
 
-
-
-/*
-================================================================
-
-                    definition of functions
-                    
-================================================================
-*/
-
 /*
 ================
-IniInit
+IniKeyAtom
+
+  Найти интернированную строку ключа
 ================
 */
-void IniInit( ini_t* ini, fnIniMalloc malloc, fnIniFree free, fnIniMallocTag memtag, char* buf, ptrdiff_t size ) {
-    iniassert( ini );
-    iniassert( malloc );
-    iniassert( free );
+static inistring_t* IniKeyAtom( ini_t* ini, inikey_t* key ) {
+    iniassert( key );
+    iniassert( key->string );
     
-    ini->inimalloc = malloc;
-    ini->inifree = free;
-    ini->inimemtag = memtag;
-    ini->errbuf = buf;
-    ini->errbufSize = size;
-    ini->numOfErrors = 0;
-    ini->bufFill = 0;
-    ini->flags = 0;
-    ini->firstSect = NULL;
-    ini->lastSect = NULL;
-    ini->filenames = NULL;
-    ini->lastfname = NULL;
+    return IniAtomFind( ini, key->string, key->length, IniKeyHash( key ) );
 }
 
 /*
 ================
-IniFree
+IniFindSectK
 ================
 */
-void IniFree( ini_t* ini ) {
-    fnIniFree free;
-    inisect_t* s;
-    inisect_t* stmp;
-    inidescr_t* d;
-    inidescr_t* dtmp;
+inisect_t* IniFindSectK( ini_t* ini, inikey_t* key ) {
+    inistring_t* atom;
     
     iniassert( ini );
-    iniassert( ini->inifree );
     
-    free = ini->inifree;
-    
-    s = ini->firstSect;
-    // free sect
-    while( s ) {
-        stmp = s;
-        s = s->next;
-        IniFreeSect(stmp);
+    if( ini->flags & INI_FLAG_PROFILE ) {
+        return IniProfFindSect( ini, key->string, key->length, IniKeyHash( key ) );
     }
-    
-    d = ini->filenames;
-    // free filenames
-    while( d ) {
-        s = d->gsect;
-        
-        IniFreeSect(s);
-        
-        free( d->filename );
-        
-        dtmp = d;
-        d = d->next;
-        free(dtmp);
+    atom = IniKeyAtom( ini, key );
+    if( !atom ) {
+        return NULL;
     }
-    
-    memset( ini, 0, sizeof(ini_t) );
+    return IniFindSectAtom( ini, atom );
 }
 
 /*
 ================
-IniClearErrors
+IniFindParamK
 ================
 */
-void IniClearErrors( ini_t* ini ) {
-    iniassert( ini );
+iniparam_t* IniFindParamK( inisect_t* sect, inikey_t* key ) {
+    inistring_t* atom;
     
-    if( ini->errbuf ) {
-        ini->errbuf[0] = 0;
+    iniassert( sect );
+    iniassert( sect->filename );
+    iniassert( sect->filename->ini );
+    
+    if( sect->filename->ini->flags & INI_FLAG_PROFILE ) {
+        return IniProfFindParam( sect, key->string, key->length, IniKeyHash( key ) );
     }
-    ini->numOfErrors = 0;
-    ini->flags &= ~0x1;
-    ini->bufFill = 0;
+    atom = IniKeyAtom( sect->filename->ini, key );
+    if( !atom ) {
+        return NULL;
+    }
+    return IniFindParamAtom( sect, atom );
 }
 
 /*
 ================
-IniSetParseComments
+IniFindK
 ================
 */
-void IniSetParseComments( ini_t* ini, unsigned char flag ) {
+iniparam_t* IniFindK( ini_t* ini, inikey_t* sect, inikey_t* param ) {
+    inisect_t* found;
+    
     iniassert( ini );
-    INI_SET_BIT(ini->flags, INI_FLAG_PARSE_COMMENTS, flag);
+    
+    found = IniFindSectK( ini, sect );
+    if( found ) {
+        return IniFindParamK( found, param );
+    }
+    return NULL;
 }
 
 /*
 ================
-IniSetKeyAlign
+IniLinearize
+
+  Записать в order секцию sect и все унаследованные секции в порядке поиска
+IniFindParam (секция, затем унаследованные секции в глубину). Каждая секция
+записывается один раз. Функция возвращает количество секций или -1, если
+они не поместились в max
 ================
 */
-void IniSetKeyAlign( ini_t* ini, unsigned char align ) {
-    iniassert( ini );
-    ini->flags = (((unsigned)align) << 24) | (ini->flags & 0xffffff);
+static int IniLinearize( inisect_t* sect, inisect_t** order, int n, int max ) {
+    iniinh_t* inh;
+    int i;
+    
+    for( i = 0; i < n; i++ ) {
+        if( order[i] == sect ) {
+            return n;
+        }
+    }
+    if( n >= max ) {
+        return -1;
+    }
+    order[n++] = sect;
+    for( inh = sect->inherit; inh && n >= 0; inh = inh->next ) {
+        n = IniLinearize( inh->inhSect, order, n, max );
+    }
+    return n;
 }
 
 /*
 ================
-IniSetEmptyLineAfterSection
+IniFindBatchChunk
+
+  Найти не больше INI_BATCH_SIZE параметров. Запросы к одной секции
+обрабатываются вместе: секция ищется один раз, а параметры секции и
+унаследованных секций просматриваются за один проход по таблице ключей
+запросов
 ================
 */
-void IniSetEmptyLineAfterSection( ini_t* ini, unsigned char flag ) {
-    iniassert( ini );
-    INI_SET_BIT(ini->flags, INI_FLAG_EMPTY_LINE_AFTER_SECT, flag );
+static ptrdiff_t IniFindBatchChunk( ini_t* ini, inikey_t* sects, inikey_t* keys, iniparam_t** out, ptrdiff_t n ) {
+    inistring_t* sectAtoms[INI_BATCH_SIZE];
+    inistring_t* keyAtoms[INI_BATCH_SIZE];
+    inistring_t* slotKeys[INI_BATCH_SIZE * 2];
+    short slotReqs[INI_BATCH_SIZE * 2];
+    short chain[INI_BATCH_SIZE];
+    inisect_t* order[INI_BATCH_DEPTH];
+    inistring_t* atom;
+    inisect_t* sect;
+    iniparam_t* p;
+    ptrdiff_t found;
+    ptrdiff_t pending;
+    ptrdiff_t i;
+    ptrdiff_t j;
+    ptrdiff_t k;
+    ptrdiff_t slot;
+    int depth;
+    
+    for( i = 0; i < n; i++ ) {
+        sectAtoms[i] = IniKeyAtom( ini, sects + i );
+        keyAtoms[i] = IniKeyAtom( ini, keys + i );
+        out[i] = NULL;
+    }
+    
+    found = 0;
+    for( i = 0; i < n; i++ ) {
+        if( (atom = sectAtoms[i]) == NULL ) {
+            continue;
+        }
+        sect = IniFindSectAtom( ini, atom );
+        
+        // Collect the requests to this section, requests with the same key
+        // are chained to one slot
+        memset( slotKeys, 0, sizeof(slotKeys) );
+        pending = 0;
+        for( j = i; j < n; j++ ) {
+            if( sectAtoms[j] != atom ) {
+                continue;
+            }
+            sectAtoms[j] = NULL;
+            if( !sect || !keyAtoms[j] ) {
+                continue;
+            }
+            if( sect->effective ) {
+                if( (out[j] = IniEffectiveFind( sect->effective, keyAtoms[j] )) != NULL ) {
+                    found++;
+                }
+                continue;
+            }
+            slot = keyAtoms[j]->hash & (INI_BATCH_SIZE * 2 - 1);
+            while( slotKeys[slot] && slotKeys[slot] != keyAtoms[j] ) {
+                slot = (slot + 1) & (INI_BATCH_SIZE * 2 - 1);
+            }
+            if( !slotKeys[slot] ) {
+                slotKeys[slot] = keyAtoms[j];
+                slotReqs[slot] = -1;
+                pending++;
+            }
+            chain[j] = slotReqs[slot];
+            slotReqs[slot] = (short)j;
+        }
+        if( !pending ) {
+            continue;
+        }
+        
+        // Keys rejected by the filter are closed before the walk
+        if( ini->bloomBits && IniBloomBuild( ini, sect ) == 0 ) {
+            for( slot = 0; slot < INI_BATCH_SIZE * 2; slot++ ) {
+                if( !slotKeys[slot] ) {
+                    continue;
+                }
+                ini->bloom.checks++;
+                if( !IniBloomHas( sect->bloomAll, ini->bloomBits, slotKeys[slot] ) ) {
+                    ini->bloom.negatives++;
+                    slotReqs[slot] = -1;
+                    pending--;
+                }
+            }
+            if( !pending ) {
+                continue;
+            }
+        }
+        
+        depth = IniLinearize( sect, order, 0, INI_BATCH_DEPTH );
+        if( depth < 0 ) {
+            // Too deep inheritance, every key is searched separately
+            for( slot = 0; slot < INI_BATCH_SIZE * 2; slot++ ) {
+                if( !slotKeys[slot] ) {
+                    continue;
+                }
+                p = IniFindParamAtom( sect, slotKeys[slot] );
+                for( j = slotReqs[slot]; j >= 0; j = chain[j] ) {
+                    out[j] = p;
+                    found += p != NULL;
+                }
+            }
+            continue;
+        }
+        
+        // The first parameter met in the search order wins, the slot is
+        // closed after that
+        for( k = 0; k < depth && pending; k++ ) {
+            if( k + 1 < depth ) {
+                INI_PREFETCH( order[k + 1]->firstParam );
+            }
+            for( p = order[k]->firstParam; p && pending; p = p->next ) {
+                INI_PREFETCH( p->next );
+                if( !p->key ) {
+                    continue;
+                }
+                slot = p->key->hash & (INI_BATCH_SIZE * 2 - 1);
+                while( slotKeys[slot] && slotKeys[slot] != p->key ) {
+                    slot = (slot + 1) & (INI_BATCH_SIZE * 2 - 1);
+                }
+                if( !slotKeys[slot] || slotReqs[slot] < 0 ) {
+                    continue;
+                }
+                for( j = slotReqs[slot]; j >= 0; j = chain[j] ) {
+                    out[j] = p;
+                    found++;
+                }
+                slotReqs[slot] = -1;
+                pending--;
+            }
+        }
+    }
+    return found;
 }
 
 /*
 ================
-IniSetSpaceBeforeEqual
+IniFindBatch
 ================
 */
-void IniSetSpaceBeforeEqual( ini_t* ini, unsigned char flag ) {
+ptrdiff_t IniFindBatch( ini_t* ini, inikey_t* sects, inikey_t* keys, iniparam_t** out, ptrdiff_t n ) {
+    ptrdiff_t found;
+    ptrdiff_t i;
+    
     iniassert( ini );
-    INI_SET_BIT(ini->flags, INI_FLAG_SPACE_BEFORE_EQ, flag );
+    iniassert( n >= 0 );
+    iniassert( !n || (sects && keys && out) );
+    
+    found = 0;
+    for( i = 0; i < n; i += INI_BATCH_SIZE ) {
+        found += IniFindBatchChunk( ini, sects + i, keys + i, out + i, 
+            n - i < INI_BATCH_SIZE ? n - i : INI_BATCH_SIZE );
+    }
+    return found;
 }
 
 /*
 ================
-IniSetSpaceAfterEqual
+IniCollectKeyOwners
 ================
 */
-void IniSetSpaceAfterEqual( ini_t* ini, unsigned char flag ) {
+ptrdiff_t IniCollectKeyOwners( ini_t* ini, const char* key, inisect_t** sects, ptrdiff_t max ) {
+    iniposting_t* e;
+    inistring_t* atom;
+    iniptrset_t owners;
+    ptrdiff_t len;
+    ptrdiff_t count;
+    ptrdiff_t i;
+    
     iniassert( ini );
-    INI_SET_BIT(ini->flags, INI_FLAG_SPACE_AFTER_EQ, flag );
+    iniassert( key );
+    iniassert( max >= 0 );
+    
+    len = (ptrdiff_t)strlen( key );
+    atom = IniAtomFind( ini, key, len, IniHash( key, len ) );
+    if( !atom ) {
+        return 0;
+    }
+    IniKeyIndex( ini );
+    e = IniKeyIndexFind( ini, atom );
+    if( !e->key ) {
+        return 0;
+    }
+    
+    // A section may have several parameters with the same key
+    IniPtrSetInit( ini, &owners );
+    count = 0;
+    for( i = 0; i < e->count; i++ ) {
+        if( IniPtrSetAdd( &owners, e->params[i]->sect ) ) {
+            if( count < max ) {
+                sects[count] = e->params[i]->sect;
+            }
+            count++;
+        }
+    }
+    IniPtrSetFree( &owners );
+    return count;
 }
 
 /*
 ================
-IniSetPrintComments
+IniAffectedOwner
+
+  Первая секция с ключом в порядке поиска IniFindParam
 ================
 */
-void IniSetPrintComments( ini_t* ini, unsigned char flag ) {
-    iniassert( ini );
-    INI_SET_BIT(ini->flags, INI_FLAG_PRINT_COMMENTS, flag);
+static inisect_t* IniAffectedOwner( iniaffected_t* a, inisect_t* sect ) {
+    inisect_t* owner;
+    iniinh_t* inh;
+    
+    if( IniPtrSetHas( &a->owners, sect ) ) {
+        return sect;
+    }
+    // A section seen already has no key on its inheritance paths
+    if( !IniPtrSetAdd( &a->path, sect ) ) {
+        return NULL;
+    }
+    for( inh = sect->inherit; inh; inh = inh->next ) {
+        if( (owner = IniAffectedOwner( a, inh->inhSect )) != NULL ) {
+            return owner;
+        }
+    }
+    return NULL;
 }
 
 /*
 ================
-IniSetPrintEmptyLines
+IniAffectedVisit
 ================
 */
-void IniSetPrintEmptyLines( ini_t* ini, unsigned char flag ) {
-    iniassert( ini );
-    INI_SET_BIT(ini->flags, INI_FLAG_PRINT_EMPTY_LINES, flag);
+static void IniAffectedVisit( iniaffected_t* a, inisect_t* sect ) {
+    iniinh_t* heir;
+    
+    if( !IniPtrSetAdd( &a->heirs, sect ) ) {
+        return;
+    }
+    IniPtrSetClear( &a->path );
+    if( IniAffectedOwner( a, sect ) == a->sect ) {
+        if( a->count < a->max ) {
+            a->sects[a->count] = sect;
+        }
+        a->count++;
+    }
+    // Heirs of a section overriding the key may still reach the section
+    // through other inherits
+    for( heir = sect->heirs; heir; heir = heir->next ) {
+        IniAffectedVisit( a, heir->inhSect );
+    }
 }
 
 /*
 ================
-IniSetPrintFilenameInTop
+IniCollectAffected
 ================
 */
-void IniSetPrintFilenameInTop( ini_t* ini, unsigned char flag ) {
-    iniassert( ini );
-    INI_SET_BIT(ini->flags, INI_FLAG_PRINT_FNAME_TOP, flag);
+ptrdiff_t IniCollectAffected( inisect_t* sect, const char* key, inisect_t** sects, ptrdiff_t max ) {
+    iniaffected_t a;
+    iniposting_t* e;
+    inistring_t* atom;
+    ini_t* ini;
+    ptrdiff_t len;
+    ptrdiff_t i;
+    
+    iniassert( sect );
+    iniassert( sect->filename );
+    iniassert( key );
+    iniassert( max >= 0 );
+    
+    ini = sect->filename->ini;
+    a.sect = sect;
+    a.sects = sects;
+    a.max = max;
+    a.count = 0;
+    IniPtrSetInit( ini, &a.owners );
+    IniPtrSetInit( ini, &a.heirs );
+    IniPtrSetInit( ini, &a.path );
+    
+    // The section counts as an owner even if the key is not defined yet
+    IniPtrSetAdd( &a.owners, sect );
+    len = (ptrdiff_t)strlen( key );
+    atom = IniAtomFind( ini, key, len, IniHash( key, len ) );
+    if( atom ) {
+        IniKeyIndex( ini );
+        e = IniKeyIndexFind( ini, atom );
+        for( i = 0; e->key && i < e->count; i++ ) {
+            IniPtrSetAdd( &a.owners, e->params[i]->sect );
+        }
+    }
+    
+    IniAffectedVisit( &a, sect );
+    
+    IniPtrSetFree( &a.path );
+    IniPtrSetFree( &a.heirs );
+    IniPtrSetFree( &a.owners );
+    return a.count;
 }
 
 /*
 ================
-IniSetPrintFilenameInBottom
+IniCollectClosure
 ================
 */
-void IniSetPrintFilenameInBottom( ini_t* ini, unsigned char flag ) {
-    iniassert( ini );
-    INI_SET_BIT(ini->flags, INI_FLAG_PRINT_FNAME_BOTTOM, flag);
+static ptrdiff_t IniCollectClosure( inisect_t* sect, inisect_t** sects, ptrdiff_t max, int up ) {
+    ini_t* ini;
+    size_t* row;
+    size_t word;
+    ptrdiff_t count;
+    ptrdiff_t words;
+    ptrdiff_t i;
+    ptrdiff_t id;
+    
+    iniassert( sect );
+    iniassert( sect->filename );
+    iniassert( sect->id >= 0 );
+    iniassert( max >= 0 );
+    
+    ini = sect->filename->ini;
+    row = IniClosureGet( ini, sect, up );
+    words = IniClosureWords( ini );
+    count = 0;
+    for( i = 0; i < words; i++ ) {
+        for( word = row[i], id = i * INI_WORD_BITS; word; word >>= 1, id++ ) {
+            if( !(word & 1) ) {
+                continue;
+            }
+            if( count < max ) {
+                sects[count] = ini->sectById[id];
+            }
+            count++;
+        }
+    }
+    return count;
 }
 
 /*
 ================
-IniSetPrintHeirsBeforeSect
+IniCollectAncestors
 ================
 */
-void IniSetPrintHeirsBeforeSect( ini_t* ini, unsigned char flag ) {
-    iniassert( ini );
-    INI_SET_BIT(ini->flags, INI_FLAG_PRINT_HEIRS, flag);
+ptrdiff_t IniCollectAncestors( inisect_t* sect, inisect_t** sects, ptrdiff_t max ) {
+    return IniCollectClosure( sect, sects, max, 1 );
 }
 
 /*
 ================
-IniSetCheckForSections
+IniCollectDescendants
 ================
 */
-void IniSetCheckForSections( ini_t* ini, unsigned char flag ) {
-    iniassert( ini );
-    INI_SET_BIT(ini->flags, INI_FLAG_CHECK_FOR_SECT, flag);
+ptrdiff_t IniCollectDescendants( inisect_t* sect, inisect_t** sects, ptrdiff_t max ) {
+    return IniCollectClosure( sect, sects, max, 0 );
 }
 
 /*
 ================
-IniSetCheckForParameters
+IniIsAncestor
 ================
 */
-void IniSetCheckForParameters( ini_t* ini, unsigned char flag ) {
-    iniassert( ini );
-    INI_SET_BIT(ini->flags, INI_FLAG_CHECK_FOR_PARAM, flag);
+int IniIsAncestor( inisect_t* sect, inisect_t* ancestor ) {
+    iniassert( sect );
+    iniassert( sect->filename );
+    iniassert( ancestor );
+    
+    if( sect->id < 0 || ancestor->id < 0 ) {
+        return 0;
+    }
+    return INI_CLOSURE_HAS( IniClosureGet( sect->filename->ini, sect, 1 ), 
+        ancestor->id ) != 0;
 }
 
 /*
 ================
-IniExcludeParam
+IniFreeze
 ================
 */
-void IniExcludeParam( iniparam_t* param ) {
-    iniparam_t* it;
-    inisect_t* sect;
-    fnIniFree free;
-    int paramIsFirst;
-    int paramIsLast;
+int IniFreeze( ini_t* ini ) {
+    inisect_t* s;
+    iniparam_t* p;
+    void** items;
+    ptrdiff_t size;
+    ptrdiff_t maxParams;
+    ptrdiff_t count;
+    int ret;
     
-    iniassert( param );
+    iniassert( ini );
     
-    sect = param->sect;
-    free = sect->filename->ini->inifree;
-    it = sect->firstParam;
-    paramIsFirst = param == sect->firstParam;
-    paramIsLast = param == sect->lastParam;
-    
-    // if only parametr in section
-    if( paramIsFirst && paramIsLast ) {
-        sect->firstParam = NULL;
-        sect->lastParam = NULL;
-    } else if( paramIsFirst ) { // parametr is first
-        sect->firstParam = param->next;
-        if( sect->firstParam == NULL ) {
-            sect->lastParam = NULL;
-        }
-    } else if( paramIsLast ) { // parametr is last
-        while( it->next != param ) {
-            it = it->next;
+    IniMphFreeAll( ini );
+    
+    // One buffer fits the items of any table
+    size = 0;
+    maxParams = 0;
+    for( s = ini->firstSect; s; s = s->next ) {
+        size++;
+        for( count = 0, p = s->firstParam; p; p = p->next ) {
+            count++;
         }
-        it->next = NULL;
-        sect->lastParam = it;
-    } else { // parametr in middle
-        while( it->next != param ) {
-            it = it->next;
+        if( maxParams < count ) {
+            maxParams = count;
         }
-        it->next = param->next;
     }
-    
-    // free parameter
-    if( param->key ) {
-        free( param->key );
+    if( size < maxParams ) {
+        size = maxParams;
     }
-    if( param->value ) {
-        free( param->value );
+    if( !size ) {
+        return 0;
+    }
+    items = (void**)IniMalloc( ini, NULL, INI_MTAG_MPH, size * sizeof(void*) );
+    
+    ret = 0;
+    count = IniMphCollect( ini, ini->firstSect, offsetof(inisect_t, next), 
+        offsetof(inisect_t, key), items );
+    ini->sectMph = IniMphBuild( ini, NULL, items, count, offsetof(inisect_t, key) );
+    if( !ini->sectMph ) {
+        ret = -1;
     }
-    if( param->comment ) {
-        free( param->comment );
+    for( s = ini->firstSect; s; s = s->next ) {
+        count = IniMphCollect( ini, s->firstParam, offsetof(iniparam_t, next), 
+            offsetof(iniparam_t, key), items );
+        if( count < INI_MPH_MIN_PARAMS ) {
+            continue;
+        }
+        s->mph = IniMphBuild( ini, s->filename, items, count, 
+            offsetof(iniparam_t, key) );
+        if( !s->mph ) {
+            ret = -1;
+            continue;
+        }
+        // The table takes over the lookups of large sections
+        IniKeysFree( ini, s->filename, &s->keys );
     }
-    free( param );
+    
+    IniMfree( ini, NULL, INI_MTAG_MPH, items, size * sizeof(void*) );
+    return ret;
 }
 
 /*
 ================
-IniExcludeInherit
+IniUnfreeze
 ================
 */
-void IniExcludeInherit( iniinh_t* inh ) {
-    iniinh_t* heir;
-    iniinh_t* it;
-    inisect_t* curSect;
-    fnIniFree free;
-
-    iniassert( inh );
-
-#ifndef ININO_DEBUG
-    // check for inherit
-    it = inh->sect->inherit;
-    while( it && it != inh ) {
-        it = it->next;
-    }
-    iniassert( it );
-    iniassert( inh->inhSect->heirs );
-#endif
-
-    curSect = inh->sect;
-    free = curSect->filename->ini->inifree;
-    it = inh->inhSect->heirs;
-    // exclude from heir
-    if( it->inhSect == curSect ) { // is first
-        it->inhSect->heirs = it->next;
-        heir = it;
-    } else {
-        while( it->next && (it->next->inhSect != curSect) ) {
-            it = it->next;
-        }
-        iniassert( it->next );
-        heir = it->next;
-        it->next = heir->next;
-    }
-    if( it->next == NULL ) {
-        curSect->inheritLast = it;
-    }
+void IniUnfreeze( ini_t* ini ) {
+    iniassert( ini );
     
-    // exclude from inherited
-    it = curSect->inherit;
-    if( it == inh ) { // is first
-        curSect->inherit = it->next;
-    } else {
-        while( it->next != inh ) {
-            it = it->next;
-        }
-        iniassert( it );
-        it->next = inh->next;
-    }
-    if( it->next == NULL ) {
-        curSect->heirsLast = it;
-    }
-
-    // free elements
-    free(heir);
-    free(inh);
+    IniMphFreeAll( ini );
 }
 
 /*
 ================
-IniExcludeHeir
+IniSectInherit
 ================
 */
-void IniExcludeHeir( iniinh_t* inh ) {
+int IniSectInherit( inisect_t* sect, const char* name ) {
+    ini_t* ini;
+    inisect_t* found;
+    iniinh_t* created;
+    
+    iniassert( sect );
+    iniassert( sect->filename );
+    iniassert( sect->filename->ini );
+    iniassert( name );
+    iniassert( name[0] != 0 );
     
+    ini = sect->filename->ini;
+    found = IniFindSect( ini, name );
+    
+    // Compare keys, the section may be a not yet merged duplicate
+    if( !found || sect->key == found->key ) {
+        return -1;
+    }
+    // Add to inherit
+    created = IniInheritCreate( ini, sect->filename, found );
+    created->sect = sect;
+    IniAppendInh_s( &sect->inherit, &sect->inheritLast, created );
+    // Add to heirs
+    created->twin = IniHeirCreate( ini, found->filename, sect );
+    created->twin->sect = found;
+    created->twin->twin = created;
+    IniAppendInh_s( &found->heirs, &found->heirsLast, created->twin );
+    IniClosureLink( sect, found );
+    IniBloomInvalidate( ini, sect );
+    IniInvalidateSect( sect );
+    return 0;
 }
 
 /*
 ================
-IniExcludeSect
+IniMaterializeSect
 ================
 */
-void IniExcludeSect( inisect_t* sect ) {
-    ini_t* ini;
-    inidescr_t* descr;
-    inisect_t* it;
-    iniinh_t* inh;
-    iniinh_t* heir;
-    iniinh_t* forFree;
-    fnIniFree free;
-    int sectIsFirst;
-    int sectIsLast;
-
+void IniMaterializeSect( inisect_t* sect ) {
     iniassert( sect );
     iniassert( sect->filename );
     iniassert( sect->filename->ini );
-    iniassert( sect->filename->gsect != sect );
-    iniassert( sect->filename->ini->inifree );
-
-    descr = sect->filename;
-    ini = descr->ini;
-    free = ini->inifree;
-
-    // exclude from ini_t
-    it = ini->firstSect;
-    sectIsFirst = ini->firstSect == sect;
-    sectIsLast = ini->lastSect == sect;
-    if( sectIsFirst && sectIsLast ) {
-        ini->firstSect = NULL;
-        ini->lastSect = NULL;
-    } else if( sectIsFirst ) {
-        ini->firstSect = it->next;
-    } else {
-        while( it->next != sect ) {
-            it = it->next;
-        }
-        it->next = sect->next;
-    }
+    
+    IniMaterialize( sect->filename->ini, sect );
+}
 
-    // exclude from inidescr_t
-    it = descr->gsect->fnext;
-    sectIsFirst = descr->gsect->fnext == sect;
-    sectIsLast = descr->lastSect == sect;
-    if( sectIsFirst && sectIsLast ) {
-        descr->gsect->fnext = NULL;
-        descr->lastSect = NULL;
-    } else if( sectIsFirst ) {
-        descr->gsect->fnext = it->fnext;
-    } else {
-        while( it->fnext != sect ) {
-            it = it->fnext;
-        }
-        it->fnext = sect->fnext;
+/*
+================
+IniMaterializeAll
+================
+*/
+void IniMaterializeAll( ini_t* ini ) {
+    inisect_t* s;
+    
+    iniassert( ini );
+    
+    for( s = ini->firstSect; s; s = s->next ) {
+        IniMaterialize( ini, s );
     }
+}
 
-    // remove from heirs (other sections)
-    inh = sect->inherit;
-    while( inh ) {
-        forFree = IniExcludeFromHeir( inh->inhSect, sect );
-        // free inherit
-        iniassert( forFree );
-        free( forFree );
-        // next
-        inh = inh->next;
+/*
+================
+IniDematerializeAll
+================
+*/
+void IniDematerializeAll( ini_t* ini ) {
+    inidescr_t* d;
+    inisect_t* s;
+    
+    iniassert( ini );
+    
+    if( !ini->numEffective ) {
+        return;
     }
-
-    // remove from inherit (other sections)
-    heir = sect->heirs;
-    while( heir ) {
-        forFree = IniExcludeFromInherit( heir->inhSect, sect );
-        // free inherit
-        iniassert( forFree );
-        free( forFree );
-        // next
-        heir = heir->next;
+    for( d = ini->filenames; d; d = d->next ) {
+        for( s = d->gsect; s; s = s->fnext ) {
+            IniEffectiveFree( ini, s );
+        }
     }
-
-    IniFreeSect( sect );
 }
 
-
-
 /*
 ================
-IniAppendDescr
+IniLoadFrom
+
+  Общая часть IniLoad и IniLoadMem
 ================
 */
-inidescr_t* IniAppendDescr( ini_t* ini, const char* filename ) {
-    inidescr_t* d;
+static int IniLoadFrom( ini_t* ini, const char* filename, const char* mem, ptrdiff_t size ) {
+    iniparamlines_t lines;
+    size_t start;
+    int ret;
     
     iniassert( ini );
     iniassert( filename );
     iniassert( filename[0] != 0 );
     
-    d = IniDescrCreate( ini, filename, -1 );
-    IniAppendDescr_s( ini, d );
-    return d;
+    IniClearErrors( ini );
+    if( ini->flags & INI_FLAG_CHECK_FOR_SECT ) {
+        ret = IniParse( ini, filename, mem, size, NULL );
+    } else {
+        // Lines of the repeated parameters are only needed with the check
+        lines.ini = ini;
+        lines.items = NULL;
+        lines.size = 0;
+        lines.count = 0;
+        ret = IniParse( ini, filename, mem, size, 
+            ini->flags & INI_FLAG_CHECK_FOR_PARAM ? &lines : NULL );
+        start = IniLoadClock( ini );
+        IniMergeSects( ini, &lines );
+        IniLoadTime( ini, &ini->load.dupTime, start );
+        IniParamLinesFree( &lines );
+    }
+    IniKeysTrimAll( ini );
+    return ret;
 }
 
 /*
 ================
-IniAppendSect
+IniLoad
 ================
 */
-inisect_t* IniAppendSect( inidescr_t* descr, const char* key ) {
-    inisect_t* s;
-    
-    iniassert( descr );
-    iniassert( key );
-    iniassert( key[0] != 0 );
-
-    s = IniSectCreate( descr->ini, 
-        IniStringCreate( descr->ini, key, -1 ),
-        NULL
-    );
-    IniAppendSect_s( descr, s );
-    return s;
+int IniLoad( ini_t* ini, const char* filename ) {
+    return IniLoadFrom( ini, filename, NULL, 0 );
 }
 
 /*
 ================
-IniAppendInclude
+IniLoadMem
 ================
 */
-iniparam_t* IniAppendInclude( inidescr_t* descr, const char* filename ) {
-    iniassert( descr );
-    iniassert( descr->gsect );
-    iniassert( descr->gsect->filename );
-    iniassert( descr->gsect->filename->ini );
-    iniassert( filename );
-    iniassert( filename[0] != 0 );
+int IniLoadMem( ini_t* ini, const char* filename, const char* data, ptrdiff_t size ) {
+    iniassert( data || size == 0 );
+    iniassert( size >= 0 );
     
-    return IniAppendIncludeToSect( descr->gsect, filename );
+    // Empty contents still need a non NULL pointer
+    return IniLoadFrom( ini, filename, data ? data : "", size );
 }
 
 /*
 ================
-IniAppendIncludeToSect
+IniValidateFile
+
+  Проверить файл filename под номером index в пакете, диагностики передаются
+в options->diag под замком lock (если он задан). Функция возвращает
+количество ошибок
 ================
 */
-iniparam_t* IniAppendIncludeToSect( inisect_t* sect, const char* filename ) {
-    ini_t* ini;
-    iniparam_t* p;
+static int IniValidateFile( const char* filename, ptrdiff_t index, const inivalidate_t* options, INI_LOCK_T* lock ) {
+    ini_t ini;
+    inidiag_t* diag;
+    int errors;
     
-    iniassert( sect );
-    iniassert( sect->filename );
-    iniassert( sect->filename->ini );
     iniassert( filename );
     iniassert( filename[0] != 0 );
+    iniassert( options );
     
-    ini = sect->filename->ini;
-    p = IniParamCreate(
-        ini,
-        IniStringCreate( ini, "#include", 8 ),
-        IniStringCreate( ini, filename, -1 ),
-        NULL
-    );
-    IniAppendParam_s( sect, p );
-    return p;
+    IniInit( &ini, options->inimalloc ? options->inimalloc : malloc,
+        options->inifree ? options->inifree : free, NULL, NULL, 0 );
+    ini.flags = INI_FLAG_VALIDATE;
+    IniParse( &ini, filename, NULL, 0, NULL );
+    
+    // File descriptors of the diagnostics are alive until IniFree
+    errors = 0;
+    if( lock && options->diag && ini.firstDiag ) {
+        INI_LOCK( lock );
+    }
+    for( diag = ini.firstDiag; diag; diag = diag->next ) {
+        if( diag->severity == INI_DIAG_ERROR ) {
+            errors++;
+        }
+        if( options->diag ) {
+            options->diag( diag, index, options->userData );
+        }
+    }
+    if( lock && options->diag && ini.firstDiag ) {
+        INI_UNLOCK( lock );
+    }
+    IniFree( &ini );
+    return errors;
 }
 
 /*
 ================
-IniAppendParam
+IniValidateWorker
+
+  Проверять файлы пакета, пока они не закончатся. Номер следующего файла
+берётся атомарно, поэтому потоки не делят файлы заранее
 ================
 */
-iniparam_t* IniAppendParam( inisect_t* sect, const char* key, const char* val ) {
-    ini_t* ini;
-    iniparam_t* p;
+static void IniValidateWorker( inivalidbatch_t* batch ) {
+    ptrdiff_t i;
+    int errors;
     
-    iniassert( sect );
-    iniassert( sect->filename );
-    iniassert( sect->filename->ini );
-    iniassert( key );
-    iniassert( key[0] != 0 );
+    iniassert( batch );
     
-    ini = sect->filename->ini;
-    p = IniParamCreate(
-        ini,
-        IniStringCreate( ini, key, -1 ),
-        IniStringCreate( ini, val, -1 ),
-        NULL
-    );
-    IniAppendParam_s( sect, p );
-    return p;
+    for(;;) {
+        i = (ptrdiff_t)INI_ATOMIC_INC( &batch->next ) - 1;
+        if( i >= batch->count ) {
+            break;
+        }
+        errors = IniValidateFile( batch->filenames[i], i, batch->options, 
+            &batch->lock );
+        if( batch->results ) {
+            batch->results[i] = errors;
+        }
+        if( errors ) {
+            INI_ATOMIC_INC( &batch->failed );
+        }
+    }
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI IniValidateThread( LPVOID batch ) {
+    IniValidateWorker( (inivalidbatch_t*)batch );
+    return 0;
 }
+#else
+static void* IniValidateThread( void* batch ) {
+    IniValidateWorker( (inivalidbatch_t*)batch );
+    return NULL;
+}
+#endif
 
 /*
 ================
-IniAppendComment
+IniNumCpus
 ================
 */
-iniparam_t* IniAppendComment( inisect_t* sect, const char* comment ) {
-    ini_t* ini;
-    iniparam_t* p;
+static int IniNumCpus( void ) {
+#if defined(_WIN32)
+    SYSTEM_INFO info;
     
-    iniassert( sect );
-    iniassert( sect->filename );
-    iniassert( sect->filename->ini );
+    GetSystemInfo( &info );
+    return (int)info.dwNumberOfProcessors;
+#else
+    long n;
     
-    ini = sect->filename->ini;
-    p = IniParamCreate(
-        ini,
-        NULL,
-        NULL,
-        IniStringCreate( ini, comment, -1 )
-    );
-    IniAppendParam_s( sect, p );
-    return p;
+    n = sysconf( _SC_NPROCESSORS_ONLN );
+    return n > 0 ? (int)n : 1;
+#endif
 }
 
+/*
+================
+IniValidate
+================
+*/
+int IniValidate( const char* filename, const inivalidate_t* options ) {
+    inivalidate_t defaults;
+    
+    iniassert( filename );
+    iniassert( filename[0] != 0 );
+    
+    if( !options ) {
+        memset( &defaults, 0, sizeof(inivalidate_t) );
+        options = &defaults;
+    }
+    return IniValidateFile( filename, 0, options, NULL );
+}
 
 /*
 ================
-IniFindSect
+IniValidateBatch
 ================
 */
-inisect_t* IniFindSect( ini_t* ini, const char* key ) {
-    inisect_t* s;
-    ptrdiff_t len;
+ptrdiff_t IniValidateBatch( const char** filenames, ptrdiff_t n, int* results, const inivalidate_t* options ) {
+#if defined(_WIN32)
+    HANDLE* threads;
+#else
+    pthread_t* threads;
+#endif
+    inivalidbatch_t batch;
+    inivalidate_t defaults;
+    fnIniMalloc alloc;
+    fnIniFree dealloc;
+    int numThreads;
+    int started;
+    int i;
     
-    iniassert( ini );
-    iniassert( key );
-    iniassert( key[0] != 0 );
+    iniassert( filenames || n == 0 );
+    iniassert( n >= 0 );
     
-    s = ini->firstSect;
-    len = (ptrdiff_t)strlen( key );
-    while( s ) {
-        if( len == s->key->length && !strncmp(key, s->key->string, len) ) {
-            return s;
+    if( !options ) {
+        memset( &defaults, 0, sizeof(inivalidate_t) );
+        options = &defaults;
+    }
+    batch.filenames = filenames;
+    batch.count = n;
+    batch.results = results;
+    batch.options = options;
+    batch.next = 0;
+    batch.failed = 0;
+    INI_LOCK_INIT( &batch.lock );
+    
+    alloc = options->inimalloc ? options->inimalloc : malloc;
+    dealloc = options->inifree ? options->inifree : free;
+    
+    numThreads = options->threads > 0 ? options->threads : IniNumCpus();
+    if( (ptrdiff_t)numThreads > n ) {
+        numThreads = (int)n;
+    }
+#if defined(INI_NO_ATOMICS)
+    // Files are taken without atomics, the batch runs in this thread
+    numThreads = 1;
+#endif
+    
+    // The calling thread validates files too. A thread which fails to
+    // start only makes the batch slower
+    started = 0;
+    threads = NULL;
+    if( numThreads > 1 ) {
+#if defined(_WIN32)
+        threads = (HANDLE*)alloc( (numThreads - 1) * sizeof(HANDLE) );
+#else
+        threads = (pthread_t*)alloc( (numThreads - 1) * sizeof(pthread_t) );
+#endif
+    }
+    for( i = 0; threads && i < numThreads - 1; i++ ) {
+#if defined(_WIN32)
+        threads[started] = CreateThread( NULL, 0, IniValidateThread, &batch,
+            0, NULL );
+        if( threads[started] != NULL ) {
+            started++;
         }
-        s = s->next;
+#else
+        if( !pthread_create( threads + started, NULL, IniValidateThread, 
+            &batch ) ) {
+            started++;
+        }
+#endif
     }
-    return NULL;
+    IniValidateWorker( &batch );
+    for( i = 0; i < started; i++ ) {
+#if defined(_WIN32)
+        WaitForSingleObject( threads[i], INFINITE );
+        CloseHandle( threads[i] );
+#else
+        pthread_join( threads[i], NULL );
+#endif
+    }
+    if( threads ) {
+        dealloc( threads );
+    }
+    INI_LOCK_FREE( &batch.lock );
+    return batch.failed;
 }
 
 /*
 ================
-IniFindParam
+IniSaveToFile
 ================
 */
-iniparam_t* IniFindParam( inisect_t* sect, const char* key ) {
-    ptrdiff_t len;
-    iniparam_t* p;
+int IniSaveToFile( ini_t* ini, const char* filename ) {
+    FILE* file;
     
-    iniassert( sect );
-    iniassert( key );
-    iniassert( key[0] != 0 );
+    iniassert( ini );
+    iniassert( filename );
+    iniassert( filename[0] != 0 );
     
-    len = (ptrdiff_t)strlen( key );
-    p = IniFindOnlyInSect( sect, key, len );
-    if( !p ) {
-        p = IniFindInInherit( sect, key, len );
+    IniClearErrors( ini );
+    if( (file = fopen(filename, "w")) == NULL ) {
+        IniDiag( ini, INI_DIAG_SAVE_FILE, NULL, 0, filename, -1, NULL );
+        return -1;
     }
-    return p;
+    
+    IniFprint( file, ini, 1 );
+    
+    fclose(file);
+    
+    return 0;
 }
 
 /*
 ================
-IniFind
+IniSave
 ================
 */
-iniparam_t* IniFind( ini_t* ini, const char* sect, const char* param ) {
-    inisect_t* found;
+int IniSave( ini_t* ini ) {
+    int ret = 0;
+    inidescr_t* d;
+    FILE* file;
+
+    iniassert( ini );
+    d = ini->filenames;
+    IniClearErrors( ini );
+
+    // save files
+    while( d ) {
+        if( (file = fopen(d->filename->string, "w")) == NULL ) {
+            IniDiag( ini, INI_DIAG_SAVE_FILE, d, 0, d->filename->string, -1, NULL );
+            ret = -1;
+        } else {
+            IniFprintFiledescr( file, d, 0 );
+            fclose(file);
+        }
+        d = d->next;
+    }
+    return ret;
+}
+
+/*
+================
+IniCompact
+================
+*/
+void IniCompact( ini_t* ini ) {
+    inidiag_t* diag;
+    inidescr_t* d;
+    inidescr_t* nd;
+    inidescr_t* dnext;
+    inisect_t* s;
+    inisect_t* ns;
+    inisect_t* snext;
+    inistring_t* a;
+    char* oldArena;
+    ptrdiff_t oldArenaSize;
+    int frozen;
+    char* arena;
+    char* mem;
+    char* atomsMem;
+    ptrdiff_t size;
+    ptrdiff_t atomsSize;
+    ptrdiff_t i;
     
     iniassert( ini );
-    iniassert( sect );
-    iniassert( sect[0] != 0 );
-    iniassert( param );
-    iniassert( param[0] != 0 );
     
-    found = IniFindSect( ini, sect );
-    if( found ) {
-        return IniFindParam( found, param );
+    if( !ini->filenames ) {
+        return;
+    }
+    
+    // Parameter tables and indexes point to the old sections and parameters,
+    // frozen tables are built again for the new tree
+    frozen = ini->numMph != 0;
+    IniDematerializeAll( ini );
+    IniIndexFreeAll( ini );
+    IniMphFreeAll( ini );
+    
+    // Calculate the size of the whole tree
+    size = 0;
+    for( d = ini->filenames; d; d = d->next ) {
+        size += IniCompactDescrSize( d );
+    }
+    atomsSize = 0;
+    for( i = 0; i < ini->atomsSize; i++ ) {
+        atomsSize += IniCompactStringSize( ini->atoms[i] );
+    }
+    
+    arena = (char*)IniMalloc( ini, NULL, INI_MTAG_ARENA, size + atomsSize );
+    mem = arena;
+    atomsMem = arena + size;
+    
+    // Interned strings are placed after the tree, the table keeps old
+    // pointers until all the keys are rewritten
+    for( i = 0; i < ini->atomsSize; i++ ) {
+        if( (a = ini->atoms[i]) != NULL ) {
+            INI_FORWARD( a ) = IniCompactString( &atomsMem, a );
+        }
+    }
+    
+    // Copy descriptors with their global sections, then all the sections
+    // in the order of the list
+    for( d = ini->filenames; d; d = nd->next ) {
+        nd = (inidescr_t*)mem;
+        mem += sizeof(inidescr_t);
+        *nd = *d;
+        nd->filename = IniCompactString( &mem, d->filename );
+        IniStringFree( ini, d, d->filename );
+        nd->gsect = IniCompactSect( ini, &mem, d->gsect );
+        INI_FORWARD( d ) = nd;
+    }
+    for( s = ini->firstSect; s; s = ns->next ) {
+        ns = IniCompactSect( ini, &mem, s );
+    }
+    iniassert( mem == arena + size );
+    
+    // Rewrite links to the new copies, old objects are still alive and
+    // keep the forwarding pointers
+    for( d = ini->filenames; d; d = nd->next ) {
+        nd = (inidescr_t*)INI_FORWARD( d );
+        IniCompactFixSect( nd->gsect );
+        if( nd->lastSect ) {
+            nd->lastSect = (inisect_t*)INI_FORWARD( nd->lastSect );
+        }
+    }
+    for( s = ini->firstSect; s; s = ns->next ) {
+        ns = (inisect_t*)INI_FORWARD( s );
+        IniCompactFixSect( ns );
+        ini->sectById[ns->id] = ns;
+    }
+    for( i = 0; i < ini->sectTableSize; i++ ) {
+        if( ini->sectTable[i] ) {
+            ini->sectTable[i] = (inisect_t*)INI_FORWARD( ini->sectTable[i] );
+        }
+    }
+    for( i = 0; i < ini->atomsSize; i++ ) {
+        if( (a = ini->atoms[i]) != NULL ) {
+            ini->atoms[i] = (inistring_t*)INI_FORWARD( a );
+            IniMfree( ini, NULL, INI_MTAG_STRING, a, 
+                sizeof(inistring_t) + a->size );
+        }
+    }
+    for( diag = ini->firstDiag; diag; diag = diag->next ) {
+        if( diag->descr ) {
+            diag->descr = (inidescr_t*)INI_FORWARD( diag->descr );
+        }
+    }
+    s = ini->firstSect;
+    d = ini->filenames;
+    ini->firstSect = s ? (inisect_t*)INI_FORWARD( s ) : NULL;
+    ini->lastSect = s ? (inisect_t*)INI_FORWARD( ini->lastSect ) : NULL;
+    ini->filenames = (inidescr_t*)INI_FORWARD( d );
+    ini->lastfname = (inidescr_t*)INI_FORWARD( ini->lastfname );
+    
+    // Release old memory, the list links are rewritten last because the old
+    // lists are walked through them
+    while( s ) {
+        ns = (inisect_t*)INI_FORWARD( s );
+        snext = ns->next;
+        ns->next = snext ? (inisect_t*)INI_FORWARD( snext ) : NULL;
+        IniCompactFreeInh( ini, s->filename, INI_MTAG_INHERIT, s->inherit );
+        IniCompactFreeInh( ini, s->filename, INI_MTAG_HEIR, s->heirs );
+        IniMfree( ini, s->filename, INI_MTAG_SECT, s, sizeof(inisect_t) );
+        s = snext;
+    }
+    while( d ) {
+        nd = (inidescr_t*)INI_FORWARD( d );
+        dnext = nd->next;
+        nd->next = dnext ? (inidescr_t*)INI_FORWARD( dnext ) : NULL;
+        IniCompactFreeInh( ini, d, INI_MTAG_INHERIT, d->gsect->inherit );
+        IniCompactFreeInh( ini, d, INI_MTAG_HEIR, d->gsect->heirs );
+        IniMfree( ini, d, INI_MTAG_SECT, d->gsect, sizeof(inisect_t) );
+        // Statistics of the old descriptor are complete now
+        nd->mem = d->mem;
+        IniMfree( ini, nd, INI_MTAG_DESCR, d, sizeof(inidescr_t) );
+        d = dnext;
+    }
+    
+    // Each descriptor accounts its part of the new memory
+    for( nd = ini->filenames; nd; nd = nd->next ) {
+        if( nd->mem.tags[INI_MTAG_ARENA].curBytes ) {
+            IniMemCount( &nd->mem, INI_MTAG_ARENA, 
+                -nd->mem.tags[INI_MTAG_ARENA].curBytes );
+        }
+        IniMemCount( &nd->mem, INI_MTAG_ARENA, IniCompactDescrSize( nd ) );
+    }
+    
+    oldArena = ini->arena;
+    oldArenaSize = ini->arenaSize;
+    ini->arena = arena;
+    ini->arenaSize = size + atomsSize;
+    if( oldArena ) {
+        IniMfree( ini, NULL, INI_MTAG_ARENA, oldArena, oldArenaSize );
+    }
+    if( frozen ) {
+        IniFreeze( ini );
     }
-    return NULL;
 }
 
 /*
 ================
-IniSectInherit
+IniGetMemStats
 ================
 */
-int IniSectInherit( inisect_t* sect, const char* name ) {
-    ini_t* ini;
-    inisect_t* found;
-    iniinh_t* created;
-    
-    iniassert( sect );
-    iniassert( sect->filename );
-    iniassert( sect->filename->ini );
-    iniassert( name );
-    iniassert( name[0] != 0 );
-    
-    ini = sect->filename->ini;
-    found = IniFindSect( ini, name );
+void IniGetMemStats( ini_t* ini, inidescr_t* descr, inimemstats_t* stats ) {
+    iniassert( ini );
+    iniassert( stats );
     
-    if( !found || sect == found ) {
-        return -1;
-    }
-    // Add to inherit
-    created = IniInheritCreate( ini, found );
-    created->sect = sect;
-    if( sect->inherit ) {
-        sect->inheritLast->next = created;
-        sect->inheritLast = created; 
-    } else {
-        sect->inherit = created;
-        sect->inheritLast = created;
-    }
-    // Add to heirs
-    created = IniHeirCreate( ini, sect );
-    created->sect = found;
-    if( found->heirs ) {
-        found->heirsLast->next = created;
-        found->heirsLast = created;
-    } else {
-        found->heirs = created;
-        found->heirsLast = created;
-    }
-    return 0;
+    *stats = descr ? descr->mem : ini->mem;
 }
 
 /*
 ================
-IniLoad
+IniSetLoadStats
 ================
 */
-int IniLoad( ini_t* ini, const char* filename ) {
+void IniSetLoadStats( ini_t* ini, unsigned char flag ) {
     iniassert( ini );
-    iniassert( filename );
-    iniassert( filename[0] != 0 );
-    
-    IniClearErrors( ini );
-    return IniRecursiveParse( ini, filename, 0 );
+    INI_SET_BIT(ini->flags, INI_FLAG_LOAD_STATS, flag);
 }
 
 /*
 ================
-IniSaveToFile
+IniLoadStatsAdd
 ================
 */
-int IniSaveToFile( ini_t* ini, const char* filename ) {
-    FILE* file;
-    
-    iniassert( ini );
-    iniassert( filename );
-    iniassert( filename[0] != 0 );
-    
-    IniClearErrors( ini );
-    if( (file = fopen(filename, "w")) == NULL ) {
-        IniPrint( ini, "error: can not open file for saving '%s'\n", filename );
-        return -1;
+static void IniLoadStatsAdd( iniloadstats_t* sum, const iniloadstats_t* s ) {
+    sum->files += s->files;
+    sum->bytes += s->bytes;
+    sum->lines += s->lines;
+    sum->tokens += s->tokens;
+    sum->sects += s->sects;
+    sum->params += s->params;
+    sum->comments += s->comments;
+    sum->includes += s->includes;
+    if( s->depth > sum->depth ) {
+        sum->depth = s->depth;
     }
-    
-    IniFprint( file, ini, 1 );
-    
-    fclose(file);
-    
-    return 0;
+    sum->ioTime += s->ioTime;
+    sum->parseTime += s->parseTime;
+    sum->allocTime += s->allocTime;
+    sum->dupTime += s->dupTime;
+    sum->descrTime += s->descrTime;
 }
 
 /*
 ================
-IniSave
+IniGetLoadStats
 ================
 */
-int IniSave( ini_t* ini ) {
-    int ret = 0;
+void IniGetLoadStats( ini_t* ini, inidescr_t* descr, iniloadstats_t* stats ) {
     inidescr_t* d;
-    FILE* file;
-
+    
     iniassert( ini );
-    d = ini->filenames;
-    IniClearErrors( ini );
-
-    // save files
-    while( d ) {
-        if( (file = fopen(d->filename->string, "w")) == NULL ) {
-            IniPrint( ini, "error: can not open file for saving '%s'\n", d->filename->string );
-            ret = -1;
-        } else {
-            IniFprintFiledescr( file, d, 0 );
-            fclose(file);
+    iniassert( stats );
+    
+    if( descr ) {
+        *stats = descr->load;
+    } else {
+        *stats = ini->load;
+        for( d = ini->filenames; d; d = d->next ) {
+            IniLoadStatsAdd( stats, &d->load );
         }
-        d = d->next;
     }
-    return ret;
+    // Allocations, checks and file search are timed inside the line parsing
+    stats->scanTime = stats->parseTime - stats->allocTime - stats->descrTime;
+    if( descr ) {
+        stats->scanTime -= stats->dupTime;
+    } else {
+        stats->scanTime -= stats->dupTime - ini->load.dupTime;
+    }
+    if( stats->scanTime < 0 ) {
+        stats->scanTime = 0;
+    }
+}
+
+/*
+================
+IniGetBloomStats
+================
+*/
+void IniGetBloomStats( ini_t* ini, inibloomstats_t* stats ) {
+    iniassert( ini );
+    iniassert( stats );
+    
+    *stats = ini->bloom;
 }
 
 /*
@@ -2481,24 +7713,219 @@ void* IniNextHeir( void* h ) {
     return IniNextInherit( h );
 }
 
+/*
+================
+IniIndexNext
+
+  Найти следующий элемент индекса, подходящий под шаблон и фильтр
+================
+*/
+static void* IniIndexNext( inihandler_t* handler, ptrdiff_t keyOffset ) {
+    void* item;
+    
+    while( handler->pos < handler->end ) {
+        item = handler->index->items[handler->pos++];
+        if( handler->pattern && !IniGlobMatch( handler->pattern, 
+                INI_INDEX_KEY( item, keyOffset )->string ) ) 
+        {
+            continue;
+        }
+        if( handler->inifilter && !handler->inifilter( item, handler->userData ) ) {
+            continue;
+        }
+        return item;
+    }
+    return NULL;
+}
+
+/*
+================
+IniGlobPrefix
+
+  Длинна начала шаблона без символов '*' и '?'
+================
+*/
+static ptrdiff_t IniGlobPrefix( const char* pattern ) {
+    ptrdiff_t i;
+    
+    for( i = 0; pattern[i] && pattern[i] != '*' && pattern[i] != '?'; i++ );
+    return i;
+}
+
+/*
+================
+IniFirstSectMatch
+================
+*/
+static void* IniFirstSectMatch( inihandler_t* handler, ini_t* ini, const char* prefix, ptrdiff_t length, const char* pattern, fnIniFilter filter, void* userData ) {
+    iniassert( handler );
+    iniassert( ini );
+    
+    handler->ini = ini;
+    handler->inifilter = filter;
+    handler->userData = userData;
+    handler->descr = NULL;
+    handler->inh = NULL;
+    handler->param = NULL;
+    handler->index = IniSectIndex( ini );
+    handler->pattern = pattern;
+    IniIndexRange( handler->index, offsetof(inisect_t, key), prefix, length, 
+        &handler->pos, &handler->end );
+    
+    return IniNextSectMatch( handler );
+}
+
+/*
+================
+IniFirstSectPrefix
+================
+*/
+void* IniFirstSectPrefix( inihandler_t* handler, ini_t* ini, const char* prefix, fnIniFilter filter, void* userData ) {
+    iniassert( prefix );
+    
+    return IniFirstSectMatch( handler, ini, prefix, strlen( prefix ), NULL, 
+        filter, userData );
+}
+
+/*
+================
+IniFirstSectGlob
+================
+*/
+void* IniFirstSectGlob( inihandler_t* handler, ini_t* ini, const char* pattern, fnIniFilter filter, void* userData ) {
+    iniassert( pattern );
+    
+    return IniFirstSectMatch( handler, ini, pattern, IniGlobPrefix( pattern ), 
+        pattern, filter, userData );
+}
+
+/*
+================
+IniNextSectMatch
+================
+*/
+void* IniNextSectMatch( void* h ) {
+    inihandler_t* handler;
+    
+    iniassert( h );
+    iniassert( ((inihandler_t*)h)->index );
+    
+    handler = (inihandler_t*)h;
+    iniassert( handler->index == handler->ini->sectIndex );
+    handler->sect = (inisect_t*)IniIndexNext( handler, offsetof(inisect_t, key) );
+    
+    if( handler->sect ) {
+        handler->string = handler->sect->key;
+        handler->cstr = handler->string->string;
+        handler->length = handler->string->length;
+    } else {
+        handler->string = NULL;
+        handler->cstr = NULL;
+        handler->length = 0;
+        return NULL;
+    }
+    return h;
+}
+
+/*
+================
+IniFirstParamMatch
+================
+*/
+static void* IniFirstParamMatch( inihandler_t* handler, inisect_t* sect, const char* prefix, ptrdiff_t length, const char* pattern, fnIniFilter filter, void* userData ) {
+    iniassert( handler );
+    iniassert( sect );
+    iniassert( sect->filename );
+    iniassert( sect->filename->ini );
+    
+    handler->ini = sect->filename->ini;
+    handler->inifilter = filter;
+    handler->userData = userData;
+    handler->descr = NULL;
+    handler->inh = NULL;
+    handler->sect = sect;
+    handler->index = IniParamIndex( sect );
+    handler->pattern = pattern;
+    IniIndexRange( handler->index, offsetof(iniparam_t, key), prefix, length, 
+        &handler->pos, &handler->end );
+    
+    return IniNextParamMatch( handler );
+}
+
+/*
+================
+IniFirstParamPrefix
+================
+*/
+void* IniFirstParamPrefix( inihandler_t* handler, inisect_t* sect, const char* prefix, fnIniFilter filter, void* userData ) {
+    iniassert( prefix );
+    
+    return IniFirstParamMatch( handler, sect, prefix, strlen( prefix ), NULL, 
+        filter, userData );
+}
+
+/*
+================
+IniFirstParamGlob
+================
+*/
+void* IniFirstParamGlob( inihandler_t* handler, inisect_t* sect, const char* pattern, fnIniFilter filter, void* userData ) {
+    iniassert( pattern );
+    
+    return IniFirstParamMatch( handler, sect, pattern, IniGlobPrefix( pattern ), 
+        pattern, filter, userData );
+}
+
+/*
+================
+IniNextParamMatch
+================
+*/
+void* IniNextParamMatch( void* h ) {
+    inihandler_t* handler;
+    
+    iniassert( h );
+    iniassert( ((inihandler_t*)h)->index );
+    
+    handler = (inihandler_t*)h;
+    iniassert( handler->index == handler->sect->index );
+    handler->param = (iniparam_t*)IniIndexNext( handler, offsetof(iniparam_t, key) );
+    
+    if( handler->param ) {
+        handler->string = handler->param->key;
+        handler->cstr = handler->string->string;
+        handler->length = handler->string->length;
+    } else {
+        handler->string = NULL;
+        handler->cstr = NULL;
+        handler->length = 0;
+        return NULL;
+    }
+    return h;
+}
+
 /*
 ================
 IniRead4fv
 ================
 */
 int IniRead4fv( iniparam_t* param, float* fv ) {
+    size_t start;
+    
     iniassert( param );
     iniassert( param->value );
     iniassert( fv );
     
+    start = IniProfReadStart( param );
+    
     // Using (2 + 2) instead of the number 4, this is for suppression of
     // warning message of PVS-Studio (message of PVS-Studio:digit 4 is 
     // magic number)
     if( sscanf( param->value->string, "%f,%f,%f,%f", 
         fv, fv + 1, fv + 2, fv + 3 ) != (2 + 2) ) {
-        return -1;
+        return IniProfRead( param, start, -1 );
     }
-    return 0;
+    return IniProfRead( param, start, 0 );
 }
 
 /*
@@ -2507,14 +7934,18 @@ IniRead3fv
 ================
 */
 int IniRead3fv( iniparam_t* param, float* fv ) {
+    size_t start;
+    
     iniassert( param );
     iniassert( param->value );
     iniassert( fv );
     
+    start = IniProfReadStart( param );
+    
     if( sscanf( param->value->string, "%f,%f,%f", fv, fv + 1, fv + 2 ) != 3 ) {
-        return -1;
+        return IniProfRead( param, start, -1 );
     }
-    return 0;
+    return IniProfRead( param, start, 0 );
 }
 
 /*
@@ -2523,14 +7954,18 @@ IniRead2fv
 ================
 */
 int IniRead2fv( iniparam_t* param, float* fv ) {
+    size_t start;
+    
     iniassert( param );
     iniassert( param->value );
     iniassert( fv );
     
+    start = IniProfReadStart( param );
+    
     if( sscanf( param->value->string, "%f,%f", fv, fv + 1 ) != 2 ) {
-        return -1;
+        return IniProfRead( param, start, -1 );
     }
-    return 0;
+    return IniProfRead( param, start, 0 );
 }
 
 /*
@@ -2539,14 +7974,18 @@ IniRead1fv
 ================
 */
 int IniRead1fv( iniparam_t* param, float* fv ) {
+    size_t start;
+    
     iniassert( param );
     iniassert( param->value );
     iniassert( fv );
     
+    start = IniProfReadStart( param );
+    
     if( sscanf( param->value->string, "%f", fv ) != 1 ) {
-        return -1;
+        return IniProfRead( param, start, -1 );
     }
-    return 0;
+    return IniProfRead( param, start, 0 );
 }
 
 /*
@@ -2555,18 +7994,22 @@ IniRead4iv
 ================
 */
 int IniRead4iv( iniparam_t* param, int* iv ) {
+    size_t start;
+    
     iniassert( param );
     iniassert( param->value );
     iniassert( iv );
     
+    start = IniProfReadStart( param );
+    
     // Using (2 + 2) instead of the number 4, this is for suppression of
     // warning message of PVS-Studio (message of PVS-Studio:digit 4 is 
     // magic number)
     if( sscanf( param->value->string, "%d,%d,%d,%d", 
         iv, iv + 1, iv + 2, iv + 3 ) != (2 + 2) ) {
-        return -1;
+        return IniProfRead( param, start, -1 );
     }
-    return 0;
+    return IniProfRead( param, start, 0 );
 }
 
 /*
@@ -2575,14 +8018,18 @@ IniRead3iv
 ================
 */
 int IniRead3iv( iniparam_t* param, int* iv ) {
+    size_t start;
+    
     iniassert( param );
     iniassert( param->value );
     iniassert( iv );
     
+    start = IniProfReadStart( param );
+    
     if( sscanf( param->value->string, "%d,%d,%d", iv, iv + 1, iv + 2 ) != 3 ) {
-        return -1;
+        return IniProfRead( param, start, -1 );
     }
-    return 0;
+    return IniProfRead( param, start, 0 );
 }
 
 /*
@@ -2591,14 +8038,18 @@ IniRead2iv
 ================
 */
 int IniRead2iv( iniparam_t* param, int* iv ) {
+    size_t start;
+    
     iniassert( param );
     iniassert( param->value );
     iniassert( iv );
     
+    start = IniProfReadStart( param );
+    
     if( sscanf( param->value->string, "%d,%d", iv, iv + 1 ) != 2 ) {
-        return -1;
+        return IniProfRead( param, start, -1 );
     }
-    return 0;
+    return IniProfRead( param, start, 0 );
 }
 
 /*
@@ -2607,14 +8058,18 @@ IniRead1iv
 ================
 */
 int IniRead1iv( iniparam_t* param, int* iv ) {
+    size_t start;
+    
     iniassert( param );
     iniassert( param->value );
     iniassert( iv );
     
+    start = IniProfReadStart( param );
+    
     if( sscanf( param->value->string, "%d", iv ) != 1 ) {
-        return -1;
+        return IniProfRead( param, start, -1 );
     }
-    return 0;
+    return IniProfRead( param, start, 0 );
 }
 
 
@@ -2624,11 +8079,16 @@ IniReadBool
 ================
 */
 int IniReadBool( iniparam_t* param, unsigned char* b ) {
+    size_t start;
+    
     iniassert( param );
     iniassert( param->value );
     iniassert( b );
     
-    return IniScanBool( param->value->string, NULL, b );
+    start = IniProfReadStart( param );
+    
+    return IniProfRead( param, start, 
+        IniScanBool( param->value->string, NULL, b ) );
 }
 
 /*
@@ -2639,25 +8099,28 @@ IniReadBoolv
 int IniReadBoolv( iniparam_t* param, unsigned char* b, ptrdiff_t n ) {
     ptrdiff_t i;
     char* s;
+    size_t start;
     
     iniassert( param );
     iniassert( param->value );
     iniassert( b );
     iniassert( n > 0 );
     
+    start = IniProfReadStart( param );
+    
     s = param->value->string;
     for( i = 0; i < n; i++ ) {
         if( IniScanBool( s, &s, b + i ) ) {
-            return -1;
+            return IniProfRead( param, start, -1 );
         }
         IniSkipSpaces( &s );
         if( *s == ',' ) {
             s++;
         } else if( i < n-1 ) {
-            return -1;
+            return IniProfRead( param, start, -1 );
         }
     }
-    return 0;
+    return IniProfRead( param, start, 0 );
 }
 
 /*
@@ -2666,11 +8129,16 @@ IniReadString
 ================
 */
 int IniReadString( iniparam_t* param, char* s ) {
+    size_t start;
+    
     iniassert( param );
     iniassert( param->value );
     iniassert( s );
     
-    return IniScanString( param->value->string, NULL, s );
+    start = IniProfReadStart( param );
+    
+    return IniProfRead( param, start, 
+        IniScanString( param->value->string, NULL, s ) );
 }
 
 /*
@@ -2681,23 +8149,26 @@ IniReadStringv
 int IniReadStringv( iniparam_t* param, char** sv, ptrdiff_t n ) {
     ptrdiff_t i;
     char* s;
+    size_t start;
     
     iniassert( param );
     iniassert( param->value );
     iniassert( sv );
     iniassert( n > 0 );
     
+    start = IniProfReadStart( param );
+    
     s = param->value->string;
     for( i = 0; i < n; i++ ) {
         if( IniScanString( s, &s, sv[i] ) ) {
-            return -1;
+            return IniProfRead( param, start, -1 );
         }
         IniSkipSpaces( &s );
         if( *s == ',' ) {
             s++;
         } else if( i < n-1 ) {
-            return -1;
+            return IniProfRead( param, start, -1 );
         }
     }
-    return 0;
+    return IniProfRead( param, start, 0 );
 }